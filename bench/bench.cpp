@@ -0,0 +1,552 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// jsonb_bench: times encode, decode, to-json and round trip on every sample file.
+// every operation runs a few warm-up iterations first, then at least -n timed ones
+// and until -t seconds went by. each iteration is timed on its own with steady_clock,
+// the report gives median, p99 and MB/s of the input plus the heap allocations
+// per iteration. -o writes the same numbers as json to track them across releases.
+// -s N measures scaling instead: ToBinary, Load and Decode of the text samples with
+// 1, 2, 4 ... threads up to N, or up to the hardware threads with -s 0.
+// -z N measures compression levels 0, 1, 3, 6 and 9 up to N: the encoded size, encode,
+// decode and to-json from a freshly opened view, all in MB/s of the text.
+// .gltf files are also read into and written from the structs of gltf.h with the struct
+// codecs (struct-dec, struct-enc), next to the Value tree's load and to-binary.
+
+#include "gltf.h"
+#include <jsonb/jsonb.h>
+#include <jsonb/emitter.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+    std::atomic<uint64_t> g_alloc_count(0);
+    std::atomic<uint64_t> g_alloc_bytes(0);
+
+    void CountAlloc(size_t size)
+    {
+        g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+        g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+#if defined(__GLIBC__)
+// glibc lets the executable replace malloc, which also counts BufferWriter,
+// Arena and every operator new that ends up in malloc
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+
+    void* malloc(size_t size)
+    {
+        CountAlloc(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        CountAlloc(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size)
+    {
+        CountAlloc(size);
+        return __libc_realloc(p, size);
+    }
+}
+#else
+// elsewhere only operator new is counted
+void* operator new(size_t size)
+{
+    CountAlloc(size);
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+#endif
+
+namespace
+{
+    const size_t MAX_REPETITIONS = 100000;
+
+    struct Options
+    {
+        int warmup = 3;
+        int repetitions = 20;
+        double min_seconds = 0.25;
+        // highest thread count of the scaling run, -1 for the single-threaded ops
+        int max_threads = -1;
+        // highest compression level of the compression run, -1 for the single-threaded ops
+        int max_level = -1;
+        std::string json_path;
+        std::vector<std::string> files;
+    };
+
+    struct Result
+    {
+        std::string file;
+        std::string op;
+        int threads;
+        int level;
+        size_t bytes;
+        // size of the binary the op worked with, set by the compression run
+        size_t encoded_bytes;
+        size_t repetitions;
+        double median_us;
+        double p99_us;
+        double min_us;
+        double mean_us;
+        double mb_per_s;
+        double allocs;
+        double alloc_bytes;
+    };
+
+    // runs op until both the repetition count and the minimum time are reached
+    Result Measure(const Options& options, const std::string& file, const char* name, size_t bytes, const std::function<bool()>& op)
+    {
+        Result result = { file, name, 1, 0, bytes, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < options.warmup; ++i)
+        {
+            if (!op())
+            {
+                printf("%s %s failed\n", file.c_str(), name);
+                return result;
+            }
+        }
+
+        // reserved up front so the timings do not allocate while they are counted
+        std::vector<double> times;
+        times.reserve(MAX_REPETITIONS);
+        uint64_t count_before = g_alloc_count.load();
+        uint64_t bytes_before = g_alloc_bytes.load();
+        auto begin = std::chrono::steady_clock::now();
+        auto limit = std::chrono::duration<double>(options.min_seconds);
+        while (times.size() < MAX_REPETITIONS && ((int) times.size() < options.repetitions ||
+            std::chrono::steady_clock::now() - begin < limit))
+        {
+            auto t = std::chrono::steady_clock::now();
+            op();
+            times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+        }
+        uint64_t count = g_alloc_count.load() - count_before;
+        uint64_t alloc_bytes = g_alloc_bytes.load() - bytes_before;
+
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double t : times)
+        {
+            total += t;
+        }
+        result.repetitions = times.size();
+        result.median_us = times[times.size() / 2];
+        result.p99_us = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+        result.min_us = times[0];
+        result.mean_us = total / times.size();
+        result.mb_per_s = result.median_us > 0 ? bytes / result.median_us : 0;
+        result.allocs = (double) count / times.size();
+        result.alloc_bytes = (double) alloc_bytes / times.size();
+        return result;
+    }
+
+    bool ReadFile(const std::string& path, std::string& data)
+    {
+        jsonb::MappedFile file;
+        if (!file.Open(path))
+        {
+            return false;
+        }
+        data.assign((const char*) file.GetData(), file.GetSize());
+        return true;
+    }
+
+    void BenchFile(const Options& options, const std::string& path, std::vector<Result>& results)
+    {
+        std::string input;
+        if (!ReadFile(path, input))
+        {
+            printf("can not read %s\n", path.c_str());
+            return;
+        }
+
+        std::filesystem::path file_path(path);
+        std::string name = file_path.filename().string();
+        // the .jsonb samples are already encoded, in the v1 layout
+        bool binary = file_path.extension() == ".jsonb";
+
+        jsonb::Document encoder;
+        std::string encoded;
+        if (binary)
+        {
+            encoded = input;
+        }
+        else
+        {
+            if (!encoder.Encode(input))
+            {
+                printf("can not encode %s\n", path.c_str());
+                return;
+            }
+            encoded.assign((const char*) encoder.GetBinary(), encoder.GetBinarySize());
+        }
+
+        jsonb::Document decoder;
+        decoder.SetReuseArena(true);
+        jsonb::JsonEmitter emitter;
+        jsonb::BufferWriter text;
+        jsonb::View view(encoded.data(), encoded.size());
+
+        if (!binary)
+        {
+            results.push_back(Measure(options, name, "encode", input.size(), [&]() {
+                return encoder.Encode(input);
+            }));
+        }
+        results.push_back(Measure(options, name, "decode", encoded.size(), [&]() {
+            return decoder.Decode(encoded.data(), encoded.size()).IsOk();
+        }));
+        results.push_back(Measure(options, name, "to-json", encoded.size(), [&]() {
+            text.Clear();
+            return emitter.Emit(view, text);
+        }));
+        if (!binary)
+        {
+            results.push_back(Measure(options, name, "round-trip", input.size(), [&]() {
+                text.Clear();
+                return encoder.Encode(input) &&
+                    emitter.Emit(jsonb::View(encoder.GetBinary(), encoder.GetBinarySize()), text);
+            }));
+        }
+
+        // the same model read and written through a Value tree and through the struct codecs
+        if (file_path.extension() == ".gltf")
+        {
+            gltf::Gltf model;
+            if (!jsonb::DecodeStruct(view, model))
+            {
+                printf("can not read %s as glTF\n", path.c_str());
+                return;
+            }
+            // the struct decoder does not validate either
+            jsonb::Document tree;
+            tree.SetValidation(false);
+            results.push_back(Measure(options, name, "load", encoded.size(), [&]() {
+                return tree.Load(view).IsOk();
+            }));
+            results.push_back(Measure(options, name, "to-binary", encoded.size(), [&]() {
+                tree.ToBinary();
+                return true;
+            }));
+            results.push_back(Measure(options, name, "struct-dec", encoded.size(), [&]() {
+                gltf::Gltf decoded;
+                return jsonb::DecodeStruct(view, decoded);
+            }));
+            jsonb::BufferWriter writer;
+            results.push_back(Measure(options, name, "struct-enc", encoded.size(), [&]() {
+                writer.Clear();
+                jsonb::EncodeStruct(model, writer);
+                return true;
+            }));
+        }
+    }
+
+    void ScaleFile(const Options& options, const std::string& path, std::vector<Result>& results)
+    {
+        std::filesystem::path file_path(path);
+        std::string name = file_path.filename().string();
+        std::string input;
+        jsonb::Document source;
+        // the .jsonb samples are v1, which has no offset tables to split by
+        if (file_path.extension() == ".jsonb" || !ReadFile(path, input) || !source.Encode(input))
+        {
+            return;
+        }
+        std::string encoded((const char*) source.GetBinary(), source.GetBinarySize());
+
+        int max_threads = options.max_threads > 0 ? options.max_threads : (int) std::max(1u, std::thread::hardware_concurrency());
+        for (int threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            jsonb::Document doc;
+            doc.SetThreadCount(threads);
+            doc.SetReuseArena(true);
+            doc.Load(input);
+            results.push_back(Measure(options, name, "to-binary", input.size(), [&]() {
+                doc.ToBinary();
+                return true;
+            }));
+            results.back().threads = threads;
+
+            jsonb::Document loader;
+            loader.SetThreadCount(threads);
+            results.push_back(Measure(options, name, "load", encoded.size(), [&]() {
+                return loader.Load(encoded.data(), encoded.size()).IsOk();
+            }));
+            results.back().threads = threads;
+
+            results.push_back(Measure(options, name, "decode", encoded.size(), [&]() {
+                return doc.Decode(encoded.data(), encoded.size()).IsOk();
+            }));
+            results.back().threads = threads;
+
+            if (threads == max_threads)
+            {
+                break;
+            }
+        }
+    }
+
+    void CompressFile(const Options& options, const std::string& path, std::vector<Result>& results)
+    {
+        std::filesystem::path file_path(path);
+        std::string name = file_path.filename().string();
+        std::string input;
+        // only v2 buffers have blocks
+        if (file_path.extension() == ".jsonb" || !ReadFile(path, input))
+        {
+            return;
+        }
+
+        const int levels[] = { 0, 1, 3, 6, 9 };
+        for (int level : levels)
+        {
+            if (level > options.max_level)
+            {
+                break;
+            }
+
+            jsonb::Document encoder;
+            encoder.SetCompressionLevel(level);
+            if (!encoder.Encode(input))
+            {
+                printf("can not encode %s\n", path.c_str());
+                return;
+            }
+            std::string encoded((const char*) encoder.GetBinary(), encoder.GetBinarySize());
+
+            jsonb::Document decoder;
+            decoder.SetReuseArena(true);
+            jsonb::JsonEmitter emitter;
+            jsonb::BufferWriter text;
+            size_t first = results.size();
+            results.push_back(Measure(options, name, "encode", input.size(), [&]() {
+                return encoder.Encode(input);
+            }));
+            results.push_back(Measure(options, name, "decode", input.size(), [&]() {
+                return decoder.Decode(encoded.data(), encoded.size()).IsOk();
+            }));
+            // a new view decompresses every block again
+            results.push_back(Measure(options, name, "to-json", input.size(), [&]() {
+                text.Clear();
+                return emitter.Emit(jsonb::View(encoded.data(), encoded.size()), text);
+            }));
+            for (size_t i = first; i < results.size(); ++i)
+            {
+                results[i].level = level;
+                results[i].encoded_bytes = encoded.size();
+            }
+        }
+    }
+
+    bool WriteJson(const Options& options, const std::vector<Result>& results)
+    {
+        jsonb::Document doc;
+        jsonb::Value& root = doc.GetRoot();
+        jsonb::Value& meta = root["meta"];
+        char date[32];
+        time_t now = time(nullptr);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+        meta["date"] = date;
+#if defined(__clang__)
+        meta["compiler"] = "clang " __clang_version__;
+#elif defined(__GNUC__)
+        meta["compiler"] = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        meta["compiler"] = "msvc " + std::to_string(_MSC_VER);
+#endif
+#if defined(NDEBUG)
+        meta["optimized"] = true;
+#else
+        meta["optimized"] = false;
+#endif
+        meta["warmup"] = options.warmup;
+        meta["repetitions"] = options.repetitions;
+        meta["min_seconds"] = options.min_seconds;
+        meta["hardware_threads"] = std::thread::hardware_concurrency();
+
+        jsonb::Value& list = root["results"];
+        list = jsonb::Value(jsonb::Kind::Array);
+        for (const Result& r : results)
+        {
+            jsonb::Value v(jsonb::Kind::Object);
+            v["file"] = r.file;
+            v["op"] = r.op;
+            v["threads"] = r.threads;
+            v["level"] = r.level;
+            v["encoded_bytes"] = r.encoded_bytes;
+            v["bytes"] = r.bytes;
+            v["repetitions"] = r.repetitions;
+            v["median_us"] = r.median_us;
+            v["p99_us"] = r.p99_us;
+            v["min_us"] = r.min_us;
+            v["mean_us"] = r.mean_us;
+            v["mb_per_s"] = r.mb_per_s;
+            v["allocs"] = r.allocs;
+            v["alloc_bytes"] = r.alloc_bytes;
+            list.Append(std::move(v));
+        }
+
+        std::ofstream os(options.json_path, std::ios::binary | std::ios::out);
+        if (!os)
+        {
+            return false;
+        }
+        os << doc.ToJson() << "\n";
+        return (bool) os;
+    }
+
+    void Usage()
+    {
+        printf("Usage:\n");
+        printf("\tjsonb_bench [-w warmup] [-n repetitions] [-t min_seconds] [-s max_threads] [-z max_level] [-o results.json] [files...]\n");
+        printf("\twithout files every .json, .gltf and .jsonb file in %s is measured\n", JSONB_TEST_DIR);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-w" && has_value)
+        {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "-n" && has_value)
+        {
+            options.repetitions = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-t" && has_value)
+        {
+            options.min_seconds = atof(argv[++i]);
+        }
+        else if (arg == "-s" && has_value)
+        {
+            options.max_threads = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "-z" && has_value)
+        {
+            options.max_level = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "-o" && has_value)
+        {
+            options.json_path = argv[++i];
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            options.files.push_back(arg);
+        }
+    }
+
+    if (options.files.empty())
+    {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(JSONB_TEST_DIR, error))
+        {
+            std::string ext = entry.path().extension().string();
+            if (ext == ".json" || ext == ".gltf" || ext == ".jsonb")
+            {
+                options.files.push_back(entry.path().string());
+            }
+        }
+        // directory order differs between machines, the report should not
+        std::sort(options.files.begin(), options.files.end());
+    }
+
+    std::vector<Result> results;
+    bool compression = options.max_level >= 0;
+    if (compression)
+    {
+        printf("%-22s %-10s %5s %10s %8s %10s %10s %9s %9s\n", "file", "op", "level", "size", "reps", "median us", "p99 us", "MB/s", "allocs");
+    }
+    else
+    {
+        printf("%-22s %-10s %7s %8s %10s %10s %9s %9s %12s\n", "file", "op", "threads", "reps", "median us", "p99 us", "MB/s", "allocs", "alloc bytes");
+    }
+    for (const std::string& file : options.files)
+    {
+        size_t first = results.size();
+        if (compression)
+        {
+            CompressFile(options, file, results);
+            for (size_t i = first; i < results.size(); ++i)
+            {
+                const Result& r = results[i];
+                printf("%-22s %-10s %5d %10zu %8zu %10.1f %10.1f %9.1f %9.1f\n", r.file.c_str(), r.op.c_str(), r.level,
+                    r.encoded_bytes, r.repetitions, r.median_us, r.p99_us, r.mb_per_s, r.allocs);
+            }
+            continue;
+        }
+        if (options.max_threads >= 0)
+        {
+            ScaleFile(options, file, results);
+        }
+        else
+        {
+            BenchFile(options, file, results);
+        }
+        for (size_t i = first; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            printf("%-22s %-10s %7d %8zu %10.1f %10.1f %9.1f %9.1f %12.0f\n", r.file.c_str(), r.op.c_str(), r.threads,
+                r.repetitions, r.median_us, r.p99_us, r.mb_per_s, r.allocs, r.alloc_bytes);
+        }
+    }
+
+    if (!options.json_path.empty() && !WriteJson(options, results))
+    {
+        printf("can not write %s\n", options.json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/codec.h>
+#include <stdint.h>
+#include <array>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// the part of glTF 2.0 the samples in test/ use, for the struct codec benchmark.
+// indices that may be missing are optional, extensions and extras are skipped
+namespace gltf
+{
+    struct Asset
+    {
+        std::string version;
+        std::optional<std::string> generator;
+    };
+    JSONB_FIELDS(Asset, version, generator)
+
+    struct Scene
+    {
+        std::optional<std::string> name;
+        std::vector<uint32_t> nodes;
+    };
+    JSONB_FIELDS(Scene, name, nodes)
+
+    struct Node
+    {
+        std::optional<std::string> name;
+        std::optional<uint32_t> mesh;
+        std::optional<uint32_t> skin;
+        std::optional<uint32_t> camera;
+        std::optional<std::vector<uint32_t>> children;
+        std::optional<std::array<float, 4>> rotation;
+        std::optional<std::array<float, 3>> scale;
+        std::optional<std::array<float, 3>> translation;
+        std::optional<std::array<float, 16>> matrix;
+    };
+    JSONB_FIELDS(Node, name, mesh, skin, camera, children, rotation, scale, translation, matrix)
+
+    struct Primitive
+    {
+        std::map<std::string, uint32_t> attributes;
+        std::optional<uint32_t> indices;
+        std::optional<uint32_t> material;
+        std::optional<uint32_t> mode;
+    };
+    JSONB_FIELDS(Primitive, attributes, indices, material, mode)
+
+    struct Mesh
+    {
+        std::optional<std::string> name;
+        std::vector<Primitive> primitives;
+    };
+    JSONB_FIELDS(Mesh, name, primitives)
+
+    struct ChannelTarget
+    {
+        std::optional<uint32_t> node;
+        std::string path;
+    };
+    JSONB_FIELDS(ChannelTarget, node, path)
+
+    struct Channel
+    {
+        uint32_t sampler = 0;
+        ChannelTarget target;
+    };
+    JSONB_FIELDS(Channel, sampler, target)
+
+    struct AnimationSampler
+    {
+        uint32_t input = 0;
+        uint32_t output = 0;
+        std::optional<std::string> interpolation;
+    };
+    JSONB_FIELDS(AnimationSampler, input, output, interpolation)
+
+    struct Animation
+    {
+        std::optional<std::string> name;
+        std::vector<Channel> channels;
+        std::vector<AnimationSampler> samplers;
+    };
+    JSONB_FIELDS(Animation, name, channels, samplers)
+
+    struct Skin
+    {
+        std::optional<uint32_t> inverseBindMatrices;
+        std::optional<uint32_t> skeleton;
+        std::vector<uint32_t> joints;
+    };
+    JSONB_FIELDS(Skin, inverseBindMatrices, skeleton, joints)
+
+    struct Accessor
+    {
+        std::optional<uint32_t> bufferView;
+        std::optional<uint64_t> byteOffset;
+        uint32_t componentType = 0;
+        std::optional<bool> normalized;
+        uint32_t count = 0;
+        std::string type;
+        std::optional<std::vector<double>> max;
+        std::optional<std::vector<double>> min;
+    };
+    JSONB_FIELDS(Accessor, bufferView, byteOffset, componentType, normalized, count, type, max, min)
+
+    struct BufferView
+    {
+        uint32_t buffer = 0;
+        std::optional<uint64_t> byteOffset;
+        uint64_t byteLength = 0;
+        std::optional<uint32_t> byteStride;
+        std::optional<uint32_t> target;
+    };
+    JSONB_FIELDS(BufferView, buffer, byteOffset, byteLength, byteStride, target)
+
+    struct Buffer
+    {
+        std::optional<std::string> uri;
+        uint64_t byteLength = 0;
+    };
+    JSONB_FIELDS(Buffer, uri, byteLength)
+
+    struct TextureInfo
+    {
+        uint32_t index = 0;
+        std::optional<uint32_t> texCoord;
+        std::optional<float> scale;
+        std::optional<float> strength;
+    };
+    JSONB_FIELDS(TextureInfo, index, texCoord, scale, strength)
+
+    struct PbrMetallicRoughness
+    {
+        std::optional<std::array<float, 4>> baseColorFactor;
+        std::optional<TextureInfo> baseColorTexture;
+        std::optional<float> metallicFactor;
+        std::optional<float> roughnessFactor;
+        std::optional<TextureInfo> metallicRoughnessTexture;
+    };
+    JSONB_FIELDS(PbrMetallicRoughness, baseColorFactor, baseColorTexture, metallicFactor, roughnessFactor, metallicRoughnessTexture)
+
+    struct Material
+    {
+        std::optional<std::string> name;
+        std::optional<PbrMetallicRoughness> pbrMetallicRoughness;
+        std::optional<TextureInfo> normalTexture;
+        std::optional<TextureInfo> occlusionTexture;
+        std::optional<TextureInfo> emissiveTexture;
+        std::optional<std::array<float, 3>> emissiveFactor;
+        std::optional<std::string> alphaMode;
+        std::optional<bool> doubleSided;
+    };
+    JSONB_FIELDS(Material, name, pbrMetallicRoughness, normalTexture, occlusionTexture, emissiveTexture, emissiveFactor, alphaMode, doubleSided)
+
+    struct Sampler
+    {
+        std::optional<uint32_t> magFilter;
+        std::optional<uint32_t> minFilter;
+        std::optional<uint32_t> wrapS;
+        std::optional<uint32_t> wrapT;
+    };
+    JSONB_FIELDS(Sampler, magFilter, minFilter, wrapS, wrapT)
+
+    struct Texture
+    {
+        std::optional<std::string> name;
+        std::optional<uint32_t> sampler;
+        std::optional<uint32_t> source;
+    };
+    JSONB_FIELDS(Texture, name, sampler, source)
+
+    struct Image
+    {
+        std::optional<std::string> uri;
+        std::optional<std::string> mimeType;
+        std::optional<uint32_t> bufferView;
+    };
+    JSONB_FIELDS(Image, uri, mimeType, bufferView)
+
+    struct Gltf
+    {
+        Asset asset;
+        std::optional<uint32_t> scene;
+        std::vector<Scene> scenes;
+        std::vector<Node> nodes;
+        std::vector<Mesh> meshes;
+        std::vector<Animation> animations;
+        std::vector<Skin> skins;
+        std::vector<Accessor> accessors;
+        std::vector<BufferView> bufferViews;
+        std::vector<Buffer> buffers;
+        std::vector<Material> materials;
+        std::vector<Sampler> samplers;
+        std::vector<Texture> textures;
+        std::vector<Image> images;
+    };
+    JSONB_FIELDS(Gltf, asset, scene, scenes, nodes, meshes, animations, skins, accessors, bufferViews, buffers, materials, samplers, textures, images)
+}
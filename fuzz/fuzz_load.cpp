@@ -0,0 +1,139 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+// jsonb_fuzz: libFuzzer target for untrusted buffers. every input goes through the
+// Validator, the Document loaders, the lazy decoder, the JsonEmitter, the Patcher,
+// the struct codec and the Differ.
+// none of them may crash, a buffer the Validator passes has to load and decode,
+// and stay valid after an edit, and a delta has to rebuild its target. seeded with
+// test/*.jsonb, see the README.
+
+#include <jsonb/jsonb.h>
+#include <jsonb/codec.h>
+#include <jsonb/diff.h>
+#include <jsonb/emitter.h>
+#include <jsonb/patch.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    // one field of every kind the codec reads
+    struct Member
+    {
+        std::string name;
+        std::optional<int32_t> id;
+        std::vector<double> values;
+        std::map<std::string, uint16_t> counts;
+        std::vector<bool> flags;
+        std::array<float, 3> position;
+    };
+    JSONB_FIELDS(Member, name, id, values, counts, flags, position)
+
+    struct Root
+    {
+        std::vector<Member> members;
+        std::optional<Member> first;
+        uint64_t size = 0;
+        bool valid = false;
+    };
+    JSONB_FIELDS(Root, members, first, size, valid)
+
+    void Touch(const jsonb::Node& node, size_t& sum)
+    {
+        sum += static_cast<size_t>(node.GetKind());
+        if (node.IsString())
+        {
+            sum += node.AsString().size();
+        }
+        for (size_t i = 0; i < node.Size(); ++i)
+        {
+            if (node.IsObject())
+            {
+                sum += node.GetKey(i).size();
+            }
+            Touch(node[i], sum);
+        }
+    }
+
+    void Check(bool ok)
+    {
+        if (!ok)
+        {
+            abort();
+        }
+    }
+
+    void CheckDelta(const uint8_t* base, size_t base_size, const uint8_t* target, size_t target_size)
+    {
+        jsonb::Differ differ;
+        jsonb::BufferWriter delta;
+        jsonb::BufferWriter rebuilt;
+        differ.Diff(base, base_size, target, target_size, delta);
+        Check(differ.Apply(base, base_size, delta.GetData(), delta.GetSize(), rebuilt).IsOk());
+        Check(rebuilt.GetSize() == target_size && (target_size == 0 || memcmp(rebuilt.GetData(), target, target_size) == 0));
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    jsonb::Validator validator;
+    bool valid = validator.Validate(data, size).IsOk();
+
+    // the loaders validate first, so their result has to agree with the validator's
+    jsonb::Document doc;
+    Check(doc.Load(data, size).IsOk() == valid);
+    Check(doc.Decode(data, size).IsOk() == valid);
+
+    size_t sum = 0;
+    doc.SetLazyDecode(true);
+    if (doc.Decode(data, size))
+    {
+        Touch(doc.GetTree(), sum);
+    }
+
+    // the view based readers are bounds checked and depth limited without validation
+    jsonb::View view(data, size);
+    if (view.IsValid())
+    {
+        jsonb::BufferWriter writer;
+        jsonb::JsonEmitter emitter;
+        Check(emitter.Emit(view, writer) || !valid);
+    }
+
+    // the struct decoder reads without validation, any buffer has to be safe for it
+    Root root;
+    jsonb::DecodeStruct(view, root);
+
+    // the differ walks both buffers without validation
+    CheckDelta(data, size / 2, data, size);
+
+    jsonb::Patcher patcher;
+    if (valid && patcher.Open(data, size))
+    {
+        jsonb::Value value;
+        if (patcher.Get("", value) && value.IsObject() && patcher.Set("/fuzz", jsonb::Value(sum)))
+        {
+            Check(validator.Validate(patcher.GetData(), patcher.GetSize()).IsOk());
+            CheckDelta(data, size, patcher.GetData(), patcher.GetSize());
+            Check(patcher.Remove("/fuzz"));
+            Check(validator.Validate(patcher.GetData(), patcher.GetSize()).IsOk());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace jsonb
+{
+    // bump allocator that hands out memory from a few large chunks.
+    // nothing is freed one by one, Reset() rewinds to the first chunk and keeps
+    // every chunk for the next round, Clear() gives them back to the system
+    class Arena
+    {
+    public:
+        Arena();
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* Allocate(size_t size, size_t align = 8)
+        {
+            uintptr_t p = ((uintptr_t) m_pos + align - 1) & ~(uintptr_t) (align - 1);
+            if (m_pos != nullptr && p + size <= (uintptr_t) m_end)
+            {
+                m_pos = (uint8_t*) (p + size);
+                return (void*) p;
+            }
+            return this->AllocateSlow(size, align);
+        }
+
+        template <class T>
+        T* Allocate(size_t count)
+        {
+            return (T*) this->Allocate(sizeof(T) * count, alignof(T));
+        }
+
+        // makes the next chunk at least size bytes if the kept ones hold less in total
+        void Reserve(size_t size);
+        void Reset();
+        void Clear();
+        size_t GetChunkCount() const { return m_chunks.size(); }
+        size_t GetCapacity() const { return m_capacity; }
+
+    private:
+        void* AllocateSlow(size_t size, size_t align);
+
+    private:
+        struct Chunk
+        {
+            uint8_t* data;
+            size_t size;
+        };
+
+        std::vector<Chunk> m_chunks;
+        size_t m_current;
+        size_t m_capacity;
+        size_t m_next_size;
+        uint8_t* m_pos;
+        uint8_t* m_end;
+    };
+}
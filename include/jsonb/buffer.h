@@ -0,0 +1,172 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace jsonb
+{
+    // growable output buffer, the memory comes from malloc so it can be
+    // handed off to its owner with Release() without another copy
+    class BufferWriter
+    {
+    public:
+        BufferWriter();
+        ~BufferWriter();
+        BufferWriter(BufferWriter&& other);
+        BufferWriter& operator=(BufferWriter&& other);
+        BufferWriter(const BufferWriter&) = delete;
+        BufferWriter& operator=(const BufferWriter&) = delete;
+        void Reserve(size_t capacity);
+        void Clear() { m_size = 0; }
+        // drops everything written after size
+        void Truncate(size_t size)
+        {
+            if (size < m_size)
+            {
+                m_size = size;
+            }
+        }
+        uint8_t* GetData() { return m_data; }
+        const uint8_t* GetData() const { return m_data; }
+        size_t GetSize() const { return m_size; }
+        // gives up ownership of the written bytes, free them with free()
+        void* Release(size_t& size);
+
+        void Write(const void* data, size_t size)
+        {
+            if (m_capacity - m_size < size)
+            {
+                this->Grow(size);
+            }
+            if (size > 0)
+            {
+                memcpy(m_data + m_size, data, size);
+                m_size += size;
+            }
+        }
+
+        template <class T>
+        void Write(const T& t)
+        {
+            if (m_capacity - m_size < sizeof(t))
+            {
+                this->Grow(sizeof(t));
+            }
+            memcpy(m_data + m_size, &t, sizeof(t));
+            m_size += sizeof(t);
+        }
+
+        // leaves room for a value that is patched in later, returns its position
+        size_t Skip(size_t size)
+        {
+            if (m_capacity - m_size < size)
+            {
+                this->Grow(size);
+            }
+            size_t pos = m_size;
+            m_size += size;
+            return pos;
+        }
+
+        template <class T>
+        void Patch(size_t pos, const T& t)
+        {
+            memcpy(m_data + pos, &t, sizeof(t));
+        }
+
+    private:
+        void Grow(size_t size);
+
+    private:
+        uint8_t* m_data;
+        size_t m_size;
+        size_t m_capacity;
+    };
+
+    // bounds-checked reader over a byte range, reading past the end
+    // marks the cursor failed and yields zeros instead of garbage
+    class Cursor
+    {
+    public:
+        Cursor(): m_begin(nullptr), m_pos(nullptr), m_end(nullptr), m_failed(false) { }
+        Cursor(const void* data, size_t size):
+            m_begin((const uint8_t*) data),
+            m_pos((const uint8_t*) data),
+            m_end((const uint8_t*) data + size),
+            m_failed(false)
+        {
+        }
+        const uint8_t* GetBegin() const { return m_begin; }
+        const uint8_t* GetPos() const { return m_pos; }
+        const uint8_t* GetEnd() const { return m_end; }
+        size_t GetOffset() const { return (size_t) (m_pos - m_begin); }
+        size_t GetRemaining() const { return (size_t) (m_end - m_pos); }
+        bool IsFailed() const { return m_failed; }
+        void Fail()
+        {
+            m_failed = true;
+            m_pos = m_end;
+        }
+
+        void Seek(size_t offset)
+        {
+            if (offset > (size_t) (m_end - m_begin))
+            {
+                this->Fail();
+                return;
+            }
+            m_pos = m_begin + offset;
+        }
+
+        template <class T>
+        T Read()
+        {
+            T t;
+            if (this->GetRemaining() < sizeof(t))
+            {
+                this->Fail();
+                return T();
+            }
+            memcpy(&t, m_pos, sizeof(t));
+            m_pos += sizeof(t);
+            return t;
+        }
+
+        // returns the next size bytes and steps over them, nullptr if there are not enough
+        const uint8_t* ReadBytes(size_t size)
+        {
+            if (this->GetRemaining() < size)
+            {
+                this->Fail();
+                return nullptr;
+            }
+            const uint8_t* p = m_pos;
+            m_pos += size;
+            return p;
+        }
+
+    private:
+        const uint8_t* m_begin;
+        const uint8_t* m_pos;
+        const uint8_t* m_end;
+        bool m_failed;
+    };
+}
@@ -0,0 +1,615 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// lists the members of a struct that the codecs read and write, by their names, at
+// namespace scope next to the struct:
+//   struct Buffer { std::string uri; uint32_t byteLength = 0; };
+//   JSONB_FIELDS(Buffer, uri, byteLength)
+// members are bools, numbers, std::string, std::vector, std::array, std::optional,
+// std::map with string keys or structs with fields of their own, up to 32 per struct
+#define JSONB_FIELDS(Type, ...) \
+    inline constexpr auto JsonbFields(const Type*) \
+    { \
+        return std::make_tuple(JSONB_EXPAND(JSONB_FIELDS_CAT(JSONB_FIELDS_, JSONB_FIELDS_COUNT(__VA_ARGS__))(Type, __VA_ARGS__))); \
+    }
+
+#define JSONB_EXPAND(x) x
+#define JSONB_FIELDS_CAT(a, b) JSONB_FIELDS_CAT2(a, b)
+#define JSONB_FIELDS_CAT2(a, b) a##b
+#define JSONB_FIELD(Type, name) ::jsonb::codec::MakeField(#name, &Type::name)
+#define JSONB_FIELDS_1(Type, a) JSONB_FIELD(Type, a)
+#define JSONB_FIELDS_2(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_1(Type, __VA_ARGS__))
+#define JSONB_FIELDS_3(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_2(Type, __VA_ARGS__))
+#define JSONB_FIELDS_4(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_3(Type, __VA_ARGS__))
+#define JSONB_FIELDS_5(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_4(Type, __VA_ARGS__))
+#define JSONB_FIELDS_6(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_5(Type, __VA_ARGS__))
+#define JSONB_FIELDS_7(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_6(Type, __VA_ARGS__))
+#define JSONB_FIELDS_8(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_7(Type, __VA_ARGS__))
+#define JSONB_FIELDS_9(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_8(Type, __VA_ARGS__))
+#define JSONB_FIELDS_10(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_9(Type, __VA_ARGS__))
+#define JSONB_FIELDS_11(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_10(Type, __VA_ARGS__))
+#define JSONB_FIELDS_12(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_11(Type, __VA_ARGS__))
+#define JSONB_FIELDS_13(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_12(Type, __VA_ARGS__))
+#define JSONB_FIELDS_14(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_13(Type, __VA_ARGS__))
+#define JSONB_FIELDS_15(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_14(Type, __VA_ARGS__))
+#define JSONB_FIELDS_16(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_15(Type, __VA_ARGS__))
+#define JSONB_FIELDS_17(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_16(Type, __VA_ARGS__))
+#define JSONB_FIELDS_18(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_17(Type, __VA_ARGS__))
+#define JSONB_FIELDS_19(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_18(Type, __VA_ARGS__))
+#define JSONB_FIELDS_20(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_19(Type, __VA_ARGS__))
+#define JSONB_FIELDS_21(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_20(Type, __VA_ARGS__))
+#define JSONB_FIELDS_22(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_21(Type, __VA_ARGS__))
+#define JSONB_FIELDS_23(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_22(Type, __VA_ARGS__))
+#define JSONB_FIELDS_24(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_23(Type, __VA_ARGS__))
+#define JSONB_FIELDS_25(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_24(Type, __VA_ARGS__))
+#define JSONB_FIELDS_26(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_25(Type, __VA_ARGS__))
+#define JSONB_FIELDS_27(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_26(Type, __VA_ARGS__))
+#define JSONB_FIELDS_28(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_27(Type, __VA_ARGS__))
+#define JSONB_FIELDS_29(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_28(Type, __VA_ARGS__))
+#define JSONB_FIELDS_30(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_29(Type, __VA_ARGS__))
+#define JSONB_FIELDS_31(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_30(Type, __VA_ARGS__))
+#define JSONB_FIELDS_32(Type, a, ...) JSONB_FIELD(Type, a), JSONB_EXPAND(JSONB_FIELDS_31(Type, __VA_ARGS__))
+#define JSONB_FIELDS_NTH(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+#define JSONB_FIELDS_COUNT(...) JSONB_EXPAND(JSONB_FIELDS_NTH(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+namespace jsonb
+{
+    // element types of a typed array, in the order of their tags
+    enum class NumberType : uint8_t
+    {
+        Uint8,
+        Int8,
+        Uint16,
+        Int16,
+        Uint32,
+        Int32,
+        Uint64,
+        Int64,
+        Float,
+        Double,
+    };
+
+    // writes v2 values with the encoder's layout for the struct codecs,
+    // object members have to be added in key order
+    class StructWriter
+    {
+    public:
+        // an open container, the position of its first child and of its offsets
+        struct Scope
+        {
+            size_t body_pos;
+            size_t first_offset;
+        };
+
+        explicit StructWriter(BufferWriter& writer);
+        void WriteHeader();
+        void WriteInt(int64_t i);
+        void WriteUint(uint64_t u);
+        void WriteFloat(float f);
+        // smallest exact form of d, as the encoder stores it
+        void WriteDouble(double d);
+        void WriteBool(bool b);
+        void WriteNull();
+        void WriteString(std::string_view str);
+        // count elements, two or more, aligned from the start of the writer. they are tagged and
+        // packed like the encoder does with the same numbers parsed, a mix of ints past an Int32
+        // and ones that are not stays a tagged array
+        void WriteNumbers(NumberType type, const void* data, size_t count);
+        Scope BeginObject();
+        Scope BeginArray();
+        // starts the next element of an array, or the key of the next member of an object
+        void AddChild(const Scope& scope);
+        void End(const Scope& scope);
+
+    private:
+        BufferWriter& m_writer;
+        std::vector<uint32_t> m_offsets;
+        BufferWriter m_scratch;
+    };
+
+    // reads values for the struct codecs straight from the bytes of a view, v1 or v2,
+    // with a dictionary or blocks. every read is bounds checked and fails for another kind
+    class StructReader
+    {
+    public:
+        // one value: its tag, the bytes after the tag and the end of the bytes holding them,
+        // which are those of the view or of the decompressed block it is in
+        struct Item
+        {
+            const View* view;
+            const uint8_t* payload;
+            const uint8_t* end;
+            uint8_t type;
+        };
+
+        // the children of a container, walked in the order of its offset table
+        struct Children
+        {
+            const View* view;
+            // first child in v2, next child in v1, first element of a typed array
+            const uint8_t* pos;
+            // v2 offset table, nullptr otherwise
+            const uint8_t* table;
+            const uint8_t* end;
+            size_t index;
+            size_t count;
+            int width;
+            // element type and size of a typed array, 0 for other containers
+            uint8_t element_type;
+            int element_size;
+        };
+
+        explicit StructReader(const View& view): m_view(view) { }
+        bool GetRoot(Item& item) const;
+        bool IsNull(const Item& item) const;
+        bool ReadBool(const Item& item, bool& b) const;
+        // an int that fits an int64
+        bool ReadInt(const Item& item, int64_t& i) const;
+        // an int that is not negative
+        bool ReadUint(const Item& item, uint64_t& u) const;
+        // any number
+        bool ReadReal(const Item& item, double& d) const;
+        bool ReadString(const Item& item, std::string_view& str) const;
+        bool OpenObject(const Item& item, Children& children) const;
+        // an array or a typed array
+        bool OpenArray(const Item& item, Children& children) const;
+        // the next of the count children, false if it is malformed
+        bool NextMember(Children& children, std::string_view& key, Item& value) const;
+        bool NextElement(Children& children, Item& value) const;
+        // every element of a typed array
+        bool ReadNumbers(const Children& children, float* out) const;
+        bool ReadNumbers(const Children& children, double* out) const;
+
+    private:
+        bool MakeItem(const View* view, const uint8_t* p, Item& item) const;
+        bool OpenContainer(const Item& item, uint8_t type, Children& children) const;
+
+    private:
+        const View& m_view;
+    };
+
+    namespace codec
+    {
+        // FNV-1a, computed at compile time for the field names and once per key read
+        constexpr uint32_t HashKey(std::string_view key)
+        {
+            uint32_t hash = 2166136261u;
+            for (char c : key)
+            {
+                hash = (hash ^ (uint8_t) c) * 16777619u;
+            }
+            return hash;
+        }
+
+        template <class T, class M>
+        struct Field
+        {
+            std::string_view name;
+            uint32_t hash;
+            M T::* member;
+        };
+
+        template <class T, class M>
+        constexpr Field<T, M> MakeField(std::string_view name, M T::* member)
+        {
+            return { name, HashKey(name), member };
+        }
+
+        // indices of the fields sorted by name, the order a v2 object keeps its members in
+        template <class Fields, size_t... I>
+        constexpr std::array<size_t, sizeof...(I)> SortFields(const Fields& fields, std::index_sequence<I...>)
+        {
+            std::array<std::string_view, sizeof...(I)> names = { std::get<I>(fields).name... };
+            std::array<size_t, sizeof...(I)> order = { I... };
+            for (size_t i = 1; i < order.size(); ++i)
+            {
+                for (size_t j = i; j > 0 && names[order[j]] < names[order[j - 1]]; --j)
+                {
+                    size_t t = order[j];
+                    order[j] = order[j - 1];
+                    order[j - 1] = t;
+                }
+            }
+            return order;
+        }
+
+        template <class T>
+        struct StructInfo
+        {
+            static constexpr auto fields = JsonbFields((const T*) nullptr);
+            static constexpr size_t count = std::tuple_size<std::remove_const_t<decltype(fields)>>::value;
+            static constexpr std::array<size_t, count> order = SortFields(fields, std::make_index_sequence<count>());
+        };
+
+        template <class T, class = void>
+        struct HasFields: std::false_type { };
+        template <class T>
+        struct HasFields<T, std::void_t<decltype(JsonbFields((const T*) nullptr))>>: std::true_type { };
+
+        template <class T>
+        struct IsOptional: std::false_type { };
+        template <class T>
+        struct IsOptional<std::optional<T>>: std::true_type { };
+
+        template <class T>
+        struct IsVector: std::false_type { };
+        template <class T, class A>
+        struct IsVector<std::vector<T, A>>: std::true_type { };
+
+        // std::vector<bool> has no bools to point at, it is read one element at a time
+        template <class T>
+        struct IsBoolVector: std::false_type { };
+        template <class A>
+        struct IsBoolVector<std::vector<bool, A>>: std::true_type { };
+
+        template <class T>
+        struct IsArray: std::false_type { };
+        template <class T, size_t N>
+        struct IsArray<std::array<T, N>>: std::true_type { };
+
+        template <class T>
+        struct IsMap: std::false_type { };
+        template <class T, class C, class A>
+        struct IsMap<std::map<std::string, T, C, A>>: std::true_type { };
+
+        // numbers that are written as a typed array, bools and chars are not
+        template <class T>
+        constexpr bool IsPacked()
+        {
+            return (std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value) ||
+                std::is_same<T, float>::value || std::is_same<T, double>::value;
+        }
+
+        template <class T>
+        constexpr NumberType NumberTypeOf()
+        {
+            if (std::is_same<T, float>::value)
+            {
+                return NumberType::Float;
+            }
+            if (std::is_same<T, double>::value)
+            {
+                return NumberType::Double;
+            }
+            int log_size = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+            return (NumberType) (log_size * 2 + (std::is_signed<T>::value ? 1 : 0));
+        }
+
+        template <class T>
+        void EncodeValue(StructWriter& writer, const T& value);
+        template <class T>
+        bool DecodeValue(const StructReader& reader, const StructReader::Item& item, T& out);
+
+        template <class T, class M>
+        void EncodeMember(StructWriter& writer, const StructWriter::Scope& scope, const Field<T, M>& field, const T& value)
+        {
+            const M& member = value.*field.member;
+            if constexpr (IsOptional<M>::value)
+            {
+                // an empty optional leaves its member out
+                if (!member)
+                {
+                    return;
+                }
+            }
+            writer.AddChild(scope);
+            writer.WriteString(field.name);
+            EncodeValue(writer, member);
+        }
+
+        // the members are written in key order, which is known at compile time
+        template <class T, size_t... I>
+        void EncodeFields(StructWriter& writer, const T& value, std::index_sequence<I...>)
+        {
+            StructWriter::Scope scope = writer.BeginObject();
+            (EncodeMember(writer, scope, std::get<StructInfo<T>::order[I]>(StructInfo<T>::fields), value), ...);
+            writer.End(scope);
+        }
+
+        template <class T>
+        void EncodeValue(StructWriter& writer, const T& value)
+        {
+            if constexpr (std::is_same<T, bool>::value)
+            {
+                writer.WriteBool(value);
+            }
+            else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value)
+            {
+                writer.WriteInt(value);
+            }
+            else if constexpr (std::is_integral<T>::value)
+            {
+                writer.WriteUint(value);
+            }
+            else if constexpr (std::is_same<T, float>::value)
+            {
+                writer.WriteFloat(value);
+            }
+            else if constexpr (std::is_floating_point<T>::value)
+            {
+                writer.WriteDouble(value);
+            }
+            else if constexpr (std::is_convertible<const T&, std::string_view>::value)
+            {
+                writer.WriteString(value);
+            }
+            else if constexpr (IsOptional<T>::value)
+            {
+                if (value)
+                {
+                    EncodeValue(writer, *value);
+                }
+                else
+                {
+                    writer.WriteNull();
+                }
+            }
+            else if constexpr (IsMap<T>::value)
+            {
+                // std::map iterates in key order already
+                StructWriter::Scope scope = writer.BeginObject();
+                for (const auto& member : value)
+                {
+                    writer.AddChild(scope);
+                    writer.WriteString(member.first);
+                    EncodeValue(writer, member.second);
+                }
+                writer.End(scope);
+            }
+            else if constexpr (IsVector<T>::value || IsArray<T>::value)
+            {
+                typedef typename T::value_type Element;
+                if constexpr (IsPacked<Element>())
+                {
+                    if (value.size() >= 2)
+                    {
+                        writer.WriteNumbers(NumberTypeOf<Element>(), value.data(), value.size());
+                        return;
+                    }
+                }
+                StructWriter::Scope scope = writer.BeginArray();
+                for (const Element& element : value)
+                {
+                    writer.AddChild(scope);
+                    EncodeValue(writer, element);
+                }
+                writer.End(scope);
+            }
+            else
+            {
+                static_assert(HasFields<T>::value, "no JSONB_FIELDS for this type");
+                EncodeFields(writer, value, std::make_index_sequence<StructInfo<T>::count>());
+            }
+        }
+
+        template <class T>
+        bool DecodeInt(const StructReader& reader, const StructReader::Item& item, T& out)
+        {
+            if constexpr (std::is_unsigned<T>::value)
+            {
+                uint64_t u;
+                if (!reader.ReadUint(item, u) || u > (uint64_t) std::numeric_limits<T>::max())
+                {
+                    return false;
+                }
+                out = (T) u;
+            }
+            else
+            {
+                int64_t i;
+                if (!reader.ReadInt(item, i) || i < (int64_t) std::numeric_limits<T>::min() || i > (int64_t) std::numeric_limits<T>::max())
+                {
+                    return false;
+                }
+                out = (T) i;
+            }
+            return true;
+        }
+
+        template <class E>
+        bool DecodeElements(const StructReader& reader, StructReader::Children& children, E* out)
+        {
+            if constexpr (std::is_same<E, float>::value || std::is_same<E, double>::value)
+            {
+                // a typed array converts in bulk
+                if (children.element_size > 0)
+                {
+                    return reader.ReadNumbers(children, out);
+                }
+            }
+            StructReader::Item item;
+            for (size_t i = 0; i < children.count; ++i)
+            {
+                if (!reader.NextElement(children, item) || !DecodeValue(reader, item, out[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // each field's hash is a constant, so the lookup unrolls to a chain of integer compares
+        template <class T, size_t... I>
+        bool DecodeMember(const StructReader& reader, std::string_view key, const StructReader::Item& item, T& out, std::index_sequence<I...>)
+        {
+            uint32_t hash = HashKey(key);
+            bool ok = true;
+            ((hash == std::get<I>(StructInfo<T>::fields).hash && key == std::get<I>(StructInfo<T>::fields).name &&
+                (ok = DecodeValue(reader, item, out.*(std::get<I>(StructInfo<T>::fields).member)), true)) || ...);
+            return ok;
+        }
+
+        template <class T>
+        bool DecodeValue(const StructReader& reader, const StructReader::Item& item, T& out)
+        {
+            if constexpr (std::is_same<T, bool>::value)
+            {
+                return reader.ReadBool(item, out);
+            }
+            else if constexpr (std::is_integral<T>::value)
+            {
+                return DecodeInt(reader, item, out);
+            }
+            else if constexpr (std::is_floating_point<T>::value)
+            {
+                double d;
+                if (!reader.ReadReal(item, d))
+                {
+                    return false;
+                }
+                out = (T) d;
+                return true;
+            }
+            else if constexpr (std::is_same<T, std::string>::value)
+            {
+                std::string_view str;
+                if (!reader.ReadString(item, str))
+                {
+                    return false;
+                }
+                out.assign(str);
+                return true;
+            }
+            else if constexpr (IsOptional<T>::value)
+            {
+                if (reader.IsNull(item))
+                {
+                    out.reset();
+                    return true;
+                }
+                if (!out)
+                {
+                    out.emplace();
+                }
+                return DecodeValue(reader, item, *out);
+            }
+            else if constexpr (IsMap<T>::value)
+            {
+                StructReader::Children children;
+                if (!reader.OpenObject(item, children))
+                {
+                    return false;
+                }
+                out.clear();
+                std::string_view key;
+                StructReader::Item value;
+                for (size_t i = 0; i < children.count; ++i)
+                {
+                    if (!reader.NextMember(children, key, value) || !DecodeValue(reader, value, out[std::string(key)]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            else if constexpr (IsBoolVector<T>::value)
+            {
+                StructReader::Children children;
+                if (!reader.OpenArray(item, children))
+                {
+                    return false;
+                }
+                out.assign(children.count, false);
+                StructReader::Item element;
+                for (size_t i = 0; i < children.count; ++i)
+                {
+                    bool b;
+                    if (!reader.NextElement(children, element) || !reader.ReadBool(element, b))
+                    {
+                        return false;
+                    }
+                    out[i] = b;
+                }
+                return true;
+            }
+            else if constexpr (IsVector<T>::value)
+            {
+                StructReader::Children children;
+                if (!reader.OpenArray(item, children))
+                {
+                    return false;
+                }
+                out.resize(children.count);
+                return DecodeElements(reader, children, out.data());
+            }
+            else if constexpr (IsArray<T>::value)
+            {
+                StructReader::Children children;
+                return reader.OpenArray(item, children) && children.count == out.size() && DecodeElements(reader, children, out.data());
+            }
+            else
+            {
+                static_assert(HasFields<T>::value, "no JSONB_FIELDS for this type");
+                StructReader::Children children;
+                if (!reader.OpenObject(item, children))
+                {
+                    return false;
+                }
+                std::string_view key;
+                StructReader::Item value;
+                for (size_t i = 0; i < children.count; ++i)
+                {
+                    if (!reader.NextMember(children, key, value) ||
+                        !DecodeMember(reader, key, value, out, std::make_index_sequence<StructInfo<T>::count>()))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+    }
+
+    // writes value to an empty writer as a v2 buffer, straight from its fields without
+    // building a tree. the output reads back like any other v2 buffer
+    template <class T>
+    void EncodeStruct(const T& value, BufferWriter& writer)
+    {
+        StructWriter struct_writer(writer);
+        struct_writer.WriteHeader();
+        codec::EncodeValue(struct_writer, value);
+    }
+
+    // reads the root of view into the fields of out, false if it or one of its members has
+    // another kind than the field it goes to. members without a field are skipped,
+    // fields without a member keep their values
+    template <class T>
+    bool DecodeStruct(const View& view, T& out)
+    {
+        StructReader reader(view);
+        StructReader::Item root;
+        return reader.GetRoot(root) && codec::DecodeValue(reader, root, out);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/view.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jsonb
+{
+    // rewrites a v2 buffer with every key stored once in a dictionary section and
+    // referenced by index. with strings, repeated string values that get smaller
+    // as references are moved to the dictionary too
+    class DictionaryWriter
+    {
+    public:
+        bool Write(const View& source, bool strings, BufferWriter& writer);
+        // writes the root section of a dictionary shared by many buffers, strings sorted and unique.
+        // they have to outlive the writer's use of them. nothing is written for no strings
+        void WriteShared(const std::vector<std::string>& strings, BufferWriter& writer);
+        // writes the root of source alone, strings of the last WriteShared become references
+        bool WriteRoot(const View& source, BufferWriter& writer);
+
+    private:
+        void WriteSection(BufferWriter& writer);
+        void Collect(const ValueRef& value);
+        void AddString(std::string_view str, bool key);
+        void WriteValue(BufferWriter& writer, const ValueRef& value);
+        void WriteString(BufferWriter& writer, std::string_view str);
+
+    private:
+        struct Entry
+        {
+            uint32_t count;
+            uint32_t index;
+            bool key;
+        };
+
+        std::unordered_map<std::string_view, Entry> m_entries;
+        std::vector<std::string_view> m_strings;
+        std::vector<uint32_t> m_offsets;
+        BufferWriter m_scratch;
+        bool m_values;
+    };
+}
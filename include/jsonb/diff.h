@@ -0,0 +1,106 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/validator.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jsonb
+{
+    // makes and applies binary deltas between two encoded buffers. Diff walks both v2 trees
+    // side by side and turns every subtree whose bytes are the same in the base, found by key
+    // in objects and by index or by hash in arrays, into a copy of those bytes, so a delta
+    // grows with the change and not with the document. a subtree that only moved is copied
+    // as well and Apply aligns its typed arrays again, the offset table of a container whose
+    // children moved is a shifted copy of the base's, and only new values are sent as bytes.
+    // buffers with different dictionaries, v1 buffers and anything that does not walk are
+    // sent whole. Apply rebuilds the target byte for byte and checks it against a hash
+    class Differ
+    {
+    public:
+        Differ();
+        // writes to delta what turns base into target, any two buffers diff
+        void Diff(const void* base, size_t base_size, const void* target, size_t target_size, BufferWriter& delta);
+        // writes to target the buffer a delta was made from base for, fails
+        // for a malformed delta or a base other than the one it was made against
+        Status Apply(const void* base, size_t base_size, const void* delta, size_t delta_size, BufferWriter& target);
+
+    private:
+        // a child of a container and its counterpart in the base
+        struct Child
+        {
+            uint32_t start;
+            uint32_t end;
+            // position in the offset table
+            uint32_t index;
+            // bytes of the key in front of an object member's value
+            uint32_t key;
+            int64_t match;
+            bool same;
+        };
+
+        void DiffValue(const uint8_t* b, const uint8_t* b_end, const uint8_t* t, const uint8_t* t_end, int depth);
+        bool DiffContainer(const uint8_t* b, const uint8_t* b_end, const uint8_t* t, const uint8_t* t_end, int depth);
+        // pairs the elements of two arrays, by index when they have as many, else by hash
+        void MatchElements(const uint8_t* b_body, size_t base_first, size_t b_count, const uint8_t* t_body, size_t target_first, size_t t_count);
+        // writes an offset table from the base's with the entries of children that moved shifted
+        void DiffTable(const uint8_t* b_table, size_t base_first, size_t target_first, size_t count, int width);
+        // true if the base bytes at b, moved where t is and with their typed arrays aligned again, are the ones at t
+        bool IsMoved(const uint8_t* b, const uint8_t* t, size_t size);
+        // copies the common prefix and suffix of two byte ranges, sends the rest
+        void DiffBytes(const uint8_t* b, size_t b_size, const uint8_t* t, size_t t_size);
+        // appends the children of a container to m_children in offset table order, false if they do not add up
+        bool ReadChildren(const uint8_t* body, const uint8_t* table, int width, size_t count, bool object);
+        // the next size bytes of the target are the base bytes at base
+        void Copy(const uint8_t* base, size_t size);
+        // the next count offsets of the target are the ones at base plus shift
+        void Shift(const uint8_t* base, size_t count, int width, int64_t shift);
+        // the next size bytes of the target are sent as they are
+        void Literal(size_t size);
+        void FlushCopy();
+        void WriteLiteral(size_t end);
+        void WriteBaseOffset(size_t offset, size_t size);
+
+    private:
+        const uint8_t* m_base;
+        const uint8_t* m_target;
+        BufferWriter* m_delta;
+        // target bytes up to here are in the delta or in m_literal / m_copy_size
+        size_t m_target_pos;
+        // start of the target bytes to send as they are
+        size_t m_literal;
+        // a copy that is held back to be merged with the next one
+        size_t m_copy_base;
+        size_t m_copy_size;
+        // end of the last base bytes read, the next op's are written relative to it
+        size_t m_last_copy;
+        // children of the containers being walked, base then target, innermost last
+        std::vector<Child> m_children;
+        std::vector<uint32_t> m_sorted;
+        std::unordered_map<std::string_view, uint32_t> m_keys;
+        std::unordered_map<uint64_t, uint32_t> m_hashes;
+        BufferWriter m_scratch;
+        // some copies moved typed arrays, the target has to be aligned again
+        bool m_align;
+    };
+}
@@ -0,0 +1,57 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/view.h>
+#include <stdio.h>
+#include <string>
+
+namespace jsonb
+{
+    // writes JSON text straight from a binary buffer in one walk, no tree is built.
+    // integers and reals are formatted with std::to_chars, reals use the shortest
+    // text that reads back to the same double. floats of v1 buffers, which were
+    // truncated on the way in, use the shortest text of the float instead.
+    class JsonEmitter
+    {
+    public:
+        JsonEmitter();
+        // compact output has no whitespace, pretty output puts one child per line
+        void SetPretty(bool pretty) { m_pretty = pretty; }
+        void SetIndent(const std::string& indent) { m_indent = indent; }
+        // appends the text of the view's root to writer, false if the buffer is malformed
+        bool Emit(const View& view, BufferWriter& writer);
+        // writes the text of the view's root to file through a small fixed buffer
+        bool Emit(const View& view, FILE* file);
+
+    private:
+        bool EmitValue(const ValueRef& value, int depth);
+        void EmitString(std::string_view str);
+        void EmitNewline(int depth);
+        void Flush();
+
+    private:
+        bool m_pretty;
+        bool m_float_text;
+        std::string m_indent;
+        BufferWriter* m_writer;
+        FILE* m_file;
+        BufferWriter m_file_buffer;
+    };
+}
@@ -17,55 +17,214 @@
 
 #pragma once
 
-#include <json/json.h>
-#include <sstream>
+#include <jsonb/arena.h>
+#include <jsonb/buffer.h>
+#include <jsonb/dictionary.h>
+#include <jsonb/mapped_file.h>
+#include <jsonb/node.h>
+#include <jsonb/stats.h>
+#include <jsonb/transcoder.h>
+#include <jsonb/validator.h>
+#include <jsonb/value.h>
+#include <jsonb/view.h>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace jsonb
 {
+    enum class ValueType;
+    class ThreadPool;
+
+    // what ToBinary() and Encode() store in the dictionary section
+    enum class DictionaryMode
+    {
+        None,
+        Keys,
+        KeysAndStrings,
+    };
+
     class Document
     {
     public:
         Document();
         ~Document();
-        bool Load(const std::string& json);
-        bool Load(const void* binary, size_t size);
-        void ToBinary();
+        // parses json text to GetRoot(), through the same single pass encoder as Encode
+        Status Load(std::string_view json);
+        // loads a binary buffer to GetRoot(), checked by a Validator first unless
+        // SetValidation(false). a failed load tells what was wrong and where
+        Status Load(const void* binary, size_t size);
+        // loads the value of an open view, like a record of a StreamReader
+        Status Load(const View& view);
+        // maps a binary file and loads it like Load(binary, size) without reading it into memory first.
+        // the mapping stays open, GetView() reads the file in place until the next LoadFile or MapFile
+        Status LoadFile(const std::string& path);
+        // maps a binary file for GetView() only, nothing is decoded or validated
+        bool MapFile(const std::string& path);
+        // view of the file mapped by the last LoadFile or MapFile
+        const View& GetView() const { return m_view; }
+        // writes GetBinary() to a file through a writable mapping
+        bool SaveFile(const std::string& path) const;
+        // encodes json text straight to GetBinary() without building the tree,
+        // the result is the same as Load(json) followed by ToBinary(). false for text that does not
+        // parse or has a container over 4 GiB encoded
+        bool Encode(std::string_view json);
+        // decodes a binary buffer into a Node tree built in the document's arena, validated
+        // like Load. the buffer is not referenced afterwards. the tree lives until the next Decode
+        Status Decode(const void* binary, size_t size);
+        Status Decode(const View& view);
+        // with lazy decoding the containers of a v2 buffer decode to placeholders that skip
+        // their bytes, their children are decoded on first access and kept. the buffer must
+        // then outlive the tree, and a malformed container reads as empty once it is reached
+        void SetLazyDecode(bool lazy) { m_lazy_decode = lazy; }
+        const Node& GetTree() const { return m_tree; }
+        // buffers from a trusted source, like ones this process wrote, can skip the Validator
+        // pass of Load and Decode. the readers still stay in bounds without it, but nothing
+        // limits how deep they recurse
+        void SetValidation(bool validate) { m_validate = validate; }
+        // keep the arena chunks from one Decode to the next instead of freeing them
+        void SetReuseArena(bool reuse) { m_reuse_arena = reuse; }
+        // keys, and with KeysAndStrings repeated string values, are written once and referenced by index
+        void SetDictionaryMode(DictionaryMode mode) { m_dictionary_mode = mode; }
+        // 1 to 9 compresses big containers as lz4 blocks that are read back one at a time,
+        // higher levels are smaller and slower to write but as fast to read. 0, the default, is off
+        void SetCompressionLevel(int level) { m_compression_level = level; }
+        // threads used by ToBinary, Load and Decode on big v2 containers, their children are
+        // split into tasks and the results are the same as with one thread.
+        // 0 picks one per hardware thread, 1 (the default) runs on the calling thread only
+        void SetThreadCount(int count);
+        int GetThreadCount() const;
+        // every Load, Decode, ToBinary, Encode and ToJson fills stats in until it is set back to
+        // null, the default. that costs a clock read per phase and a walk of the binary at the end
+        void SetStats(Stats* stats) { m_stats = stats; }
+        // called as each phase of an operation ends and with Phase::Done when it is over, failed or not,
+        // with the document's own stats if none are set. null, the default, is off
+        void SetTraceHook(TraceHook hook, void* context)
+        {
+            m_trace_hook = hook;
+            m_trace_context = context;
+        }
+        // value of the last Load, that ToBinary() and ToJson() write
+        const Value& GetRoot() const { return m_root; }
+        Value& GetRoot() { return m_root; }
+        void SetRoot(Value root) { m_root = std::move(root); }
+        // false if a container comes out over the 4 GiB its uint32 size can hold, GetBinary() is then empty
+        bool ToBinary();
+        // GetRoot() as indented json text, the way JsonEmitter writes it, empty if ToBinary would fail
         std::string ToJson();
         const void* GetBinary() const { return m_binary; }
         size_t GetBinarySize() const { return m_binary_size; }
 
     private:
-        void WriteValue(std::ostringstream& os, const Json::Value& value);
-        void WriteObject(std::ostringstream& os, const Json::Value& obj);
-        void WriteArray(std::ostringstream& os, const Json::Value& arr);
-        void WriteInt64(std::ostringstream& os, int64_t i);
-        void WriteUint64(std::ostringstream& os, uint64_t i);
-        void WriteFloat(std::ostringstream& os, float f);
-        void WriteString(std::ostringstream& os, const Json::Value& s);
-        void WriteBool(std::ostringstream& os, bool b);
-        void WriteNull(std::ostringstream& os);
-        template <class T>
-        void Write(std::ostringstream& os, const T& t)
+        friend class Node;
+
+        // scratch of one thread working on the document, the calling thread is worker 0
+        struct Worker
         {
-            os.write((const char*) &t, sizeof(t));
-        }
+            // offset tables of the containers being written, innermost last
+            std::vector<uint32_t> offsets;
+            BufferWriter scratch;
+            // written so far, tells ToBinary whether split chunks moved any of them
+            size_t typed_arrays = 0;
+            // nodes decoded by a pool thread, the calling thread uses m_arena
+            Arena arena;
+        };
+
+        Worker& GetWorker();
+        Arena& GetArena();
+        void WriteValue(BufferWriter& writer, const Value& value, Worker& worker, bool split);
+        void WriteObject(BufferWriter& writer, const Value& obj, Worker& worker, bool split);
+        void WriteArray(BufferWriter& writer, const Value& arr, Worker& worker, bool split);
+        bool WriteChildren(BufferWriter& writer, const Value& container, size_t body_pos, Worker& worker);
+        // first child of each task for the v2 container whose body the cursor is at,
+        // false if it is read on this thread
+        bool SplitChildren(const Cursor& cursor, size_t end_pos, size_t count, std::vector<size_t>& runs) const;
+
+        void SetBinary(BufferWriter& writer, Stats* stats);
+        // stats of one operation, ended with Phase::Done on every way out of it
+        class StatsScope
+        {
+        public:
+            StatsScope(Document& doc, uint64_t input_bytes);
+            ~StatsScope();
+            StatsScope(const StatsScope&) = delete;
+            StatsScope& operator=(const StatsScope&) = delete;
+            // null when there are no stats to fill in
+            Stats* Get() const { return m_stats; }
+            void Succeed(uint64_t output_bytes);
+
+        private:
+            Document& m_doc;
+            Stats* m_stats;
+            bool m_succeeded;
+        };
+
+        Stats* BeginStats(uint64_t input_bytes);
+        void EndPhase(Stats* stats, Phase phase);
+        void EndStats(Stats* stats, bool succeeded);
+        bool OpenBinary(const View& view, Cursor& cursor);
+        // loads a buffer that is validated or known to be well formed
+        Status ReadRoot(const View& view);
+        // what a reader that failed ran into, found by validating the buffer after all
+        Status Diagnose(const View& view);
 
-        void ReadValue(std::istringstream& is, Json::Value& value);
-        void ReadObject(std::istringstream& is, Json::Value& value);
-        void ReadArray(std::istringstream& is, Json::Value& value);
-        void ReadString(std::istringstream& is, std::string& str);
-        int ReadAsInt(std::istringstream& is);
+        void ReadValue(Cursor& cursor, Value& value);
+        void ReadObject(Cursor& cursor, Value& value);
+        void ReadArray(Cursor& cursor, Value& value);
+        void ReadChildren(Cursor& cursor, size_t end_pos, const std::vector<size_t>& runs, bool object, const std::vector<Value*>& slots);
+        void ReadTypedArray(Cursor& cursor, Value& value);
+        const uint8_t* ReadTypedElements(Cursor& cursor, ValueType& type, size_t& count);
+        int ReadContainerCount(Cursor& cursor, size_t& end_pos);
+        std::string_view ReadString(Cursor& cursor, ValueType type);
+        uint32_t ReadStringRef(Cursor& cursor, ValueType type);
+        int ReadAsInt(Cursor& cursor);
+        void DecodeValue(Cursor& cursor, Node& node, Arena& arena);
+        void DecodeObject(Cursor& cursor, Node& node, Arena& arena);
+        void DecodeMember(Cursor& cursor, Node::Member& member, Arena& arena);
+        void DecodeArray(Cursor& cursor, Node& node, Arena& arena);
+        void DecodeChildren(Cursor& cursor, size_t end_pos, const std::vector<size_t>& runs, size_t count, Node* elements, Node::Member* members);
+        void DecodeTypedArray(Cursor& cursor, Node& node, Arena& arena);
+        void DecodePending(Cursor& cursor, Node& node, ValueType type, Arena& arena);
+        void Expand(Node& node);
+        const char* DecodeString(Cursor& cursor, ValueType type, uint32_t& size, Arena& arena);
         template <class T>
-        T Read(std::istringstream& is)
+        T Read(Cursor& cursor)
         {
-            T t;
-            is.read((char*) &t, sizeof(t));
-            return t;
+            return cursor.Read<T>();
         }
 
     private:
-        Json::Value m_root;
+        Value m_root;
         void* m_binary;
         size_t m_binary_size;
+        int m_version;
+        Transcoder m_transcoder;
+        Validator m_validator;
+        bool m_validate;
+        DictionaryMode m_dictionary_mode;
+        DictionaryWriter m_dictionary_writer;
+        int m_compression_level;
+        // buffer being loaded and its dictionary strings copied to the arena
+        View m_source;
+        std::vector<std::string_view> m_strings;
+        Arena m_arena;
+        Node m_tree;
+        bool m_reuse_arena;
+        bool m_lazy_decode;
+        // the buffer of the current tree still has containers to decode
+        bool m_lazy;
+        View m_tree_source;
+        MappedFile m_file;
+        View m_view;
+        // null with one thread, m_workers never shrinks as pool arenas may hold the tree
+        std::unique_ptr<ThreadPool> m_pool;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        Stats* m_stats;
+        // what the trace hook gets without m_stats
+        Stats m_trace_stats;
+        TraceHook m_trace_hook;
+        void* m_trace_context;
+        // clock reading at the start of the current phase
+        uint64_t m_phase_begin;
     };
 }
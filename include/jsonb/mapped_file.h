@@ -0,0 +1,66 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace jsonb
+{
+    // read only or freshly created file mapped into memory, the pages come
+    // from the page cache so a mapped buffer costs no copy and no private memory
+    class MappedFile
+    {
+    public:
+        // how the mapping is going to be read, passed on to the kernel
+        enum class Access
+        {
+            Sequential,
+            Random,
+        };
+
+        MappedFile();
+        ~MappedFile();
+        MappedFile(MappedFile&& other);
+        MappedFile& operator=(MappedFile&& other);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // maps an existing file read only and asks for its pages to be read ahead,
+        // false if it can not be opened or is empty
+        bool Open(const std::string& path, Access access = Access::Sequential);
+        // creates or truncates a file of size bytes and maps it writable
+        bool Create(const std::string& path, size_t size);
+        // unmaps, a created file keeps what was written to it
+        void Close();
+        bool IsOpen() const { return m_data != nullptr; }
+        const uint8_t* GetData() const { return m_data; }
+        uint8_t* GetWritableData() { return m_writable ? m_data : nullptr; }
+        size_t GetSize() const { return m_size; }
+
+    private:
+        uint8_t* m_data;
+        size_t m_size;
+        bool m_writable;
+#ifdef _WIN32
+        void* m_file;
+        void* m_mapping;
+#endif
+    };
+}
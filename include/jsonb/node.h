@@ -0,0 +1,112 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+
+namespace jsonb
+{
+    class Document;
+
+    // value of a decoded tree. nodes, keys and strings all live in the arena of the
+    // Document that decoded them, so a node has no destructor and the whole tree
+    // goes away with the arena. object members are kept sorted by key.
+    // a lazily decoded container knows its kind and size, its children are decoded
+    // on the first access to one of them, which is not thread safe
+    class Node
+    {
+    public:
+        struct Member;
+
+        Node(): m_kind(Kind::Null), m_lazy(false), m_size(0) { m_u = 0; }
+        Kind GetKind() const { return m_kind; }
+        bool IsNull() const { return m_kind == Kind::Null; }
+        bool IsBool() const { return m_kind == Kind::Bool; }
+        bool IsInt() const { return m_kind == Kind::Int || m_kind == Kind::Uint; }
+        bool IsNumber() const { return this->IsInt() || m_kind == Kind::Real; }
+        bool IsString() const { return m_kind == Kind::String; }
+        bool IsArray() const { return m_kind == Kind::Array; }
+        bool IsObject() const { return m_kind == Kind::Object; }
+        bool AsBool() const;
+        int64_t AsInt64() const;
+        uint64_t AsUint64() const;
+        double AsDouble() const;
+        std::string_view AsString() const;
+        // element count of an array or member count of an object, 0 otherwise
+        size_t Size() const { return this->IsArray() || this->IsObject() ? m_size : 0; }
+        // element of an array or value of the index-th member of an object,
+        // a null node if out of range
+        const Node& operator[](size_t index) const;
+        const Node& operator[](std::string_view key) const;
+        // key of the index-th member of an object
+        std::string_view GetKey(size_t index) const;
+        const Node* Find(std::string_view key) const;
+        bool HasMember(std::string_view key) const { return this->Find(key) != nullptr; }
+
+        // true for a lazily decoded container whose children were not needed yet
+        bool IsPending() const { return m_lazy; }
+
+    private:
+        friend class Document;
+        struct Pending;
+
+        void Expand() const
+        {
+            if (m_lazy)
+            {
+                this->ExpandPending();
+            }
+        }
+        void ExpandPending() const;
+
+    private:
+        Kind m_kind;
+        bool m_lazy;
+        uint32_t m_size;
+        union
+        {
+            bool m_bool;
+            int64_t m_int;
+            uint64_t m_u;
+            double m_real;
+            const char* m_string;
+            Node* m_elements;
+            Member* m_members;
+            Pending* m_pending;
+        };
+    };
+
+    // where a lazily decoded container is in its buffer and who decodes it,
+    // end is that of the buffer or of the decompressed block holding it
+    struct Node::Pending
+    {
+        const uint8_t* data;
+        const uint8_t* end;
+        Document* document;
+    };
+
+    struct Node::Member
+    {
+        const char* key;
+        uint32_t key_size;
+        Node value;
+    };
+}
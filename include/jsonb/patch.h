@@ -0,0 +1,106 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/query.h>
+#include <jsonb/validator.h>
+#include <jsonb/value.h>
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string_view>
+#include <vector>
+
+namespace jsonb
+{
+    // edits a v2 buffer at JSON Pointers without decoding it. only the containers on the
+    // pointer's path are written again, with new sizes and offset tables, everything beside
+    // them is copied as bytes, and a scalar replaced by one of the same encoded size is
+    // overwritten in place. objects stay sorted by key, and new keys and strings that are in
+    // the dictionary refer to it. values inside compressed blocks can not be edited
+    class Patcher
+    {
+    public:
+        Patcher();
+        // copies a v2 buffer to edit once a Validator passed it, fails for anything else
+        Status Open(const void* binary, size_t size);
+        const uint8_t* GetData() const { return m_buffer.GetData(); }
+        size_t GetSize() const { return m_buffer.GetSize(); }
+        // view of the edited buffer, the next edit invalidates it
+        View GetView() const { return View(m_buffer.GetData(), m_buffer.GetSize()); }
+        // gives up the edited buffer, free it with free()
+        void* Release(size_t& size) { return m_buffer.Release(size); }
+
+        // copies the value at pointer, false if there is none
+        bool Get(std::string_view pointer, Value& value) const;
+        // replaces the value at pointer. a missing member of an object is added,
+        // and the index one past the end of an array, or "-", appends to it
+        bool Set(std::string_view pointer, const Value& value);
+        // inserts before the element at pointer, "-" appends, and works like Set on objects
+        bool Insert(std::string_view pointer, const Value& value);
+        bool Remove(std::string_view pointer);
+        // applies an RFC 6902 JSON Patch, an array of add, remove, replace, move, copy and
+        // test operations. either every operation applies or the buffer is left unchanged
+        bool ApplyJsonPatch(std::string_view patch);
+        // true if the last edit overwrote a value in place without moving any bytes
+        bool WasInPlace() const { return m_in_place; }
+
+    private:
+        enum class Mode
+        {
+            Set,
+            Insert,
+            Remove,
+        };
+
+        // a container on the pointer's path and where the next segment is in its offset table
+        struct Link
+        {
+            size_t pos;
+            size_t index;
+            bool found;
+        };
+
+        bool Edit(std::string_view pointer, Mode mode, const Value* value);
+        bool Apply(const Value& operation);
+        bool Walk(const View& view);
+        bool WriteInPlace(const View& view, const Value& value);
+        bool WriteEdited(const View& view, size_t level, Mode mode, const Value* value);
+        void WriteValue(BufferWriter& writer, const View& view, const Value& value);
+        void WriteString(BufferWriter& writer, const View& view, std::string_view str);
+
+    private:
+        BufferWriter m_buffer;
+        // the edited buffer is written here and then swapped in
+        BufferWriter m_scratch;
+        // copy of the buffer while a JSON Patch applies
+        BufferWriter m_backup;
+        BufferWriter m_typed_scratch;
+        Validator m_validator;
+        Path m_path;
+        std::vector<Link> m_chain;
+        std::vector<uint32_t> m_offsets;
+        // a typed array being edited, decoded
+        Value m_array;
+        // without typed arrays nothing has to be aligned again after bytes move
+        bool m_typed_arrays;
+        bool m_in_place;
+    };
+}
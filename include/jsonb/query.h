@@ -0,0 +1,92 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/view.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jsonb
+{
+    // a JSON Pointer ("/statuses/0/user", with ~0 for ~ and ~1 for /) where a "*" segment
+    // matches every element of an array or every member of an object. a path is compiled
+    // once and then run over any number of views without allocating: objects are searched
+    // by key in the offset table, arrays are indexed directly, and subtrees off the path
+    // are never read. matches are ValueRefs into the view's buffer
+    class Path
+    {
+    public:
+        static const size_t MAX_STEPS = 64;
+
+        Path();
+        // false for a path that is neither empty nor starts with '/', has a bad escape
+        // or more than MAX_STEPS segments
+        bool Compile(std::string_view path);
+        bool IsValid() const { return m_valid; }
+        size_t GetStepCount() const { return m_steps.size(); }
+        // unescaped segment of a step
+        std::string_view GetKey(size_t step) const { return std::string_view(m_keys).substr(m_steps[step].key_begin, m_steps[step].key_size); }
+        // array index of a step, SIZE_MAX if the segment is not one
+        size_t GetIndex(size_t step) const { return m_steps[step].index; }
+        // first match in document order, invalid if there is none
+        ValueRef Find(const View& view) const;
+        ValueRef Find(const View&& view) const = delete;
+        // appends every match in document order to out, returns how many were added
+        size_t Select(const View& view, std::vector<ValueRef>& out) const;
+        size_t Select(const View&& view, std::vector<ValueRef>& out) const = delete;
+        // calls f(const ValueRef&) for every match in document order until it returns false,
+        // returns how many matches were visited
+        template <class F>
+        size_t ForEach(const View& view, F&& f) const
+        {
+            return this->Run(view, [](void* context, const ValueRef& value) {
+                return (*(F*) context)(value);
+            }, (void*) &f);
+        }
+
+    private:
+        typedef bool (*Visit)(void* context, const ValueRef& value);
+
+        struct Step
+        {
+            // unescaped key in m_keys
+            size_t key_begin;
+            size_t key_size;
+            // element index if the segment is a valid array index, else SIZE_MAX
+            size_t index;
+            bool wildcard;
+        };
+
+        size_t Run(const View& view, Visit visit, void* context) const;
+        bool Walk(const ValueRef& value, size_t step, const size_t* key_indices, Visit visit, void* context, size_t& count) const;
+
+    private:
+        std::string m_keys;
+        std::vector<Step> m_steps;
+        bool m_valid;
+    };
+
+    // compiles path and returns every match, for one-off queries
+    // the matches refer to view, a temporary one is refused
+    std::vector<ValueRef> Query(const View& view, std::string_view path);
+    std::vector<ValueRef> Query(const View&& view, std::string_view path) = delete;
+    // first value at a JSON Pointer (with the same "*" wildcard), invalid if there is none
+    ValueRef QueryFirst(const View& view, std::string_view path);
+    ValueRef QueryFirst(const View&& view, std::string_view path) = delete;
+}
@@ -0,0 +1,42 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+namespace jsonb
+{
+    // pointer and element count, a stand-in for std::span until the build moves to C++20
+    template <class T>
+    class Span
+    {
+    public:
+        Span(): m_data(nullptr), m_size(0) { }
+        Span(T* data, size_t size): m_data(data), m_size(size) { }
+        T* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        T& operator[](size_t index) const { return m_data[index]; }
+        T* begin() const { return m_data; }
+        T* end() const { return m_data + m_size; }
+
+    private:
+        T* m_data;
+        size_t m_size;
+    };
+}
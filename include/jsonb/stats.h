@@ -0,0 +1,97 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace jsonb
+{
+    // stats and trace hooks are compiled in unless JSONB_NO_STATS is defined, the cmake
+    // option JSONB_WITH_STATS=OFF does that. without them a Document never reads the clock
+    // and SetStats and SetTraceHook do nothing
+#ifdef JSONB_NO_STATS
+    constexpr bool STATS_ENABLED = false;
+#else
+    constexpr bool STATS_ENABLED = true;
+#endif
+
+    // step of a Document operation that is timed on its own
+    enum class Phase : uint8_t
+    {
+        // json text to binary, in Load(json) and Encode
+        Parse,
+        // the Validator pass of Load and Decode
+        Validate,
+        // a Value tree to binary, in ToBinary and ToJson
+        Encode,
+        // the dictionary section of ToBinary and Encode
+        Dictionary,
+        // lz4 blocks of ToBinary and Encode
+        Compress,
+        // binary to a Value tree in Load, or to a Node tree in Decode
+        Decode,
+        // binary to json text, in ToJson
+        Emit,
+        // not a phase, the operation is over and the counts are filled in
+        Done,
+    };
+
+    const size_t PHASE_COUNT = (size_t) Phase::Done;
+    // number of type tags, what ValueRef::GetTag() returns is below it
+    const size_t TAG_COUNT = 21;
+
+    const char* GetPhaseName(Phase phase);
+
+    // what one Load, Decode, ToBinary, Encode or ToJson of a Document did
+    struct Stats
+    {
+        // json text or binary that went in and what came out, 0 for a Value tree
+        uint64_t input_bytes = 0;
+        uint64_t output_bytes = 0;
+        // values of the binary that was read or written by type tag, blocks count as
+        // the container in them. the numbers of a typed array are not values of their own
+        uint64_t tags[TAG_COUNT] = { };
+        uint64_t typed_elements = 0;
+        // deepest nesting of containers, 1 for an array of scalars and 0 for a scalar root
+        uint32_t max_depth = 0;
+        // bytes of string values and of object keys, each dictionary entry counts every time
+        // it is referenced
+        uint64_t string_bytes = 0;
+        uint64_t key_bytes = 0;
+        // heap blocks that hold the result, counted from it and not by watching the allocator:
+        // Value strings and containers for Load, arena chunks for Decode, output buffers for the others
+        uint64_t heap_blocks = 0;
+        uint64_t nanoseconds[PHASE_COUNT] = { };
+        // the operation failed, only the bytes in and the phases it got through are filled in
+        bool failed = false;
+
+        uint64_t GetNanoseconds() const;
+    };
+
+    // called at the end of each phase with the stats so far, then with Phase::Done once the
+    // operation is over, with failed set if it did not succeed. it runs on the thread of the
+    // operation and may not use the document
+    typedef void (*TraceHook)(void* context, Phase phase, const Stats& stats);
+
+    // adds the counts of a view to stats: tags, typed_elements, max_depth, string_bytes
+    // and key_bytes. returns how many heap blocks a Value copy of it holds
+    uint64_t CollectStats(const View& view, Stats& stats);
+}
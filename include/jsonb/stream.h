@@ -0,0 +1,134 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/dictionary.h>
+#include <jsonb/transcoder.h>
+#include <jsonb/view.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jsonb
+{
+    // writes a jsonb stream: many records behind one header, with the keys they share
+    // stored once if wanted, and an index at the end to find record N without reading
+    // the ones before it. records are framed by their size, so a stream cut short
+    // before its index can still be read front to back
+    class StreamWriter
+    {
+    public:
+        StreamWriter();
+        // keys that show up more than once in the records given here before Begin() go
+        // in the stream's dictionary, from a first pass over every record or a sample
+        void AddDictionaryKeys(const View& record);
+        // starts a stream kept in out, or written to file through a small buffer
+        void Begin(BufferWriter& out);
+        void Begin(FILE* file);
+        // appends the root of a v1 or v2 buffer as the next record
+        bool Add(const View& record);
+        // appends json text encoded like Document::Encode
+        bool Add(std::string_view json);
+        // writes the index, false if writing the file failed
+        bool End();
+        size_t GetRecordCount() const { return m_index.size(); }
+        size_t GetDictionarySize() const { return m_strings.size(); }
+
+    private:
+        void WriteHeader();
+        void Flush(bool all);
+        size_t GetPosition() const { return m_flushed + m_out->GetSize(); }
+
+    private:
+        std::unordered_map<std::string, uint32_t> m_key_counts;
+        // sorted, the dictionary writer refers to them by index
+        std::vector<std::string> m_strings;
+        DictionaryWriter m_dictionary_writer;
+        Transcoder m_transcoder;
+        BufferWriter m_record;
+        BufferWriter m_buffer;
+        BufferWriter* m_out;
+        FILE* m_file;
+        // bytes of the stream already written to the file
+        size_t m_flushed;
+        std::vector<uint64_t> m_index;
+    };
+
+    // reads a jsonb stream in place, the bytes must outlive the reader and its views.
+    // with the index any record is found in O(1), the iterator walks the frames instead
+    class StreamReader
+    {
+    public:
+        class Iterator;
+
+        StreamReader();
+        StreamReader(const void* data, size_t size);
+        // a stream header was found, records can be iterated
+        bool IsValid() const { return m_records != nullptr; }
+        // the index was found, GetRecord() works
+        bool HasIndex() const { return m_index != nullptr; }
+        size_t GetRecordCount() const { return m_count; }
+        // view of record index, invalid if there is no such record
+        View GetRecord(size_t index) const;
+        View operator[](size_t index) const { return this->GetRecord(index); }
+        // strings shared by every record, each record's View::GetString() sees them too
+        size_t GetStringCount() const { return m_strings.GetStringCount(); }
+        std::string_view GetString(size_t index) const { return m_strings.GetString(index); }
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        View GetRecordAt(const uint8_t* frame) const;
+
+    private:
+        const uint8_t* m_begin;
+        const uint8_t* m_records;
+        // the index when there is one, else the end of the data
+        const uint8_t* m_records_end;
+        const uint8_t* m_index;
+        size_t m_count;
+        // a view holding only the dictionary section
+        View m_strings;
+    };
+
+    // walks the records of a stream in order, a frame that does not fit ends the walk
+    class StreamReader::Iterator
+    {
+    public:
+        Iterator();
+        // position of the record in the stream, records that came before it
+        size_t Index() const { return m_index; }
+        View operator*() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const { return m_frame == other.m_frame; }
+        bool operator!=(const Iterator& other) const { return m_frame != other.m_frame; }
+
+    private:
+        friend class StreamReader;
+        Iterator(const StreamReader* reader, const uint8_t* frame);
+
+    private:
+        const StreamReader* m_reader;
+        const uint8_t* m_frame;
+        size_t m_index;
+    };
+}
@@ -0,0 +1,72 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <string>
+#include <vector>
+
+namespace jsonb
+{
+    // single pass JSON text to jsonb encoder, it never builds a tree:
+    // values are written as they are parsed and container sizes are back-patched
+    // when the container closes. apart from the output it only keeps the open
+    // container stack and the members of the object being closed.
+    // the output is byte-identical to Document::Load(json) + Document::ToBinary(),
+    // it accepts what jsoncpp accepts with its default settings (comments included).
+    class Transcoder
+    {
+    public:
+        Transcoder();
+        // appends the encoding of json, header included, to writer
+        bool Transcode(const char* json, size_t size, BufferWriter& writer);
+        const std::string& GetError() const { return m_error; }
+        size_t GetErrorOffset() const { return m_error_offset; }
+
+    private:
+        struct Frame
+        {
+            size_t body_pos;
+            size_t first_offset;
+            bool object;
+        };
+
+        bool Parse(BufferWriter& writer);
+        bool BeginMember(BufferWriter& writer, const Frame& frame);
+        void EndObject(BufferWriter& writer, const Frame& frame);
+        bool ParseString(BufferWriter& writer);
+        bool ParseNumber(BufferWriter& writer);
+        bool ParseLiteral(const char* literal, size_t size);
+        bool SkipSpace(bool comments = true);
+        bool Fail(const char* message);
+
+    private:
+        const char* m_begin;
+        const char* m_pos;
+        const char* m_end;
+        std::vector<Frame> m_stack;
+        std::vector<uint32_t> m_offsets;
+        std::vector<uint32_t> m_order;
+        std::string m_string;
+        BufferWriter m_scratch;
+        // some object had its members reordered
+        bool m_moved;
+        std::string m_error;
+        size_t m_error_offset;
+    };
+}
@@ -0,0 +1,132 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace jsonb
+{
+    // what a load or validation found wrong first
+    enum class Error : uint8_t
+    {
+        None,
+        // the bytes end inside a value
+        Truncated,
+        // not a v1 or v2 buffer, or a v2 header with unknown flags
+        BadHeader,
+        // a dictionary section whose offsets, order or strings are wrong
+        BadDictionary,
+        // a type tag that does not exist, or is not allowed where it is
+        BadTag,
+        // a container size, count, offset table or typed array layout that does not add up
+        BadLayout,
+        // a bool or decimal payload out of its range
+        BadValue,
+        // an object key that is not a string, or out of key order
+        BadKey,
+        // a dictionary index past the end of the dictionary
+        BadStringRef,
+        BadUtf8,
+        // a compressed block that does not decompress to what its header says
+        BadBlock,
+        // containers nested deeper than the validator's maximum depth
+        TooDeep,
+        // bytes left after the root value
+        TrailingBytes,
+        // json text that does not parse
+        BadJson,
+        // a file that can not be opened or mapped
+        BadFile,
+        // a delta applied to another buffer than the one it was made from
+        BaseMismatch,
+        // a delta that does not rebuild the buffer it was made for
+        BadChecksum,
+    };
+
+    // result of a load, converts to true when it succeeded
+    class Status
+    {
+    public:
+        Status(): m_error(Error::None), m_offset(0) { }
+        Status(Error error, size_t offset): m_error(error), m_offset(offset) { }
+        bool IsOk() const { return m_error == Error::None; }
+        explicit operator bool() const { return this->IsOk(); }
+        Error GetError() const { return m_error; }
+        // byte offset in the input where the error was found, the tag of the
+        // outermost block for an error inside a compressed block
+        size_t GetOffset() const { return m_offset; }
+        const char* GetMessage() const;
+
+    private:
+        Error m_error;
+        size_t m_offset;
+    };
+
+    // checks in one pass that a buffer is safe to read: every size, count, offset and tag,
+    // the dictionary, the key order of v2 objects, the nesting depth and that strings are
+    // UTF-8, with the ASCII runs checked 16 bytes at a time. compressed blocks are
+    // decompressed and checked as well. the readers stay in bounds on any input but recurse
+    // as deep as the buffer nests, a buffer that passes is also read without surprises:
+    // no deep recursion, no counts larger than the bytes behind them and no text that is
+    // not UTF-8
+    class Validator
+    {
+    public:
+        static const int DEFAULT_MAX_DEPTH = 1000;
+
+        Validator();
+        void SetMaxDepth(int depth) { m_max_depth = depth; }
+        // strings are checked to be UTF-8 unless this is turned off
+        void SetCheckUtf8(bool check) { m_check_utf8 = check; }
+        Status Validate(const void* binary, size_t size);
+        // a view that starts at a header is checked whole, a record of a stream only from its root
+        Status Validate(const View& view);
+
+    private:
+        const uint8_t* ValidateValue(const uint8_t* p, const uint8_t* end, int depth);
+        const uint8_t* ValidateContainer(const uint8_t* p, const uint8_t* end, int depth);
+        const uint8_t* ValidateBlock(const uint8_t* p, const uint8_t* end, int depth);
+        const uint8_t* ValidateString(const uint8_t* p, const uint8_t* end, std::string_view& str);
+        // returns the first byte after the section
+        const uint8_t* ValidateDictionary(const uint8_t* section, const uint8_t* end);
+        // records the first error, always returns nullptr
+        const uint8_t* Fail(Error error, const uint8_t* p);
+
+    private:
+        const View* m_view;
+        const uint8_t* m_begin;
+        int m_version;
+        bool m_blocks;
+        int m_max_depth;
+        bool m_check_utf8;
+        // tag of the outermost block being checked, errors inside it are reported there
+        const uint8_t* m_block;
+        size_t m_open_blocks;
+        Status m_status;
+        // starts of the children of the containers being checked, innermost last
+        std::vector<uint32_t> m_starts;
+        std::vector<uint32_t> m_sorted;
+        // decompressed blocks, one per nesting level
+        std::vector<BufferWriter> m_raw;
+    };
+}
@@ -0,0 +1,152 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/view.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+
+namespace jsonb
+{
+    // mutable json value that owns its contents. scalars are stored in place, strings of up to
+    // INLINE_SIZE bytes too, longer ones and containers on the heap. object members are kept
+    // sorted by key in one flat array, the order of the v2 offset tables, so a key is found with
+    // a binary search and an object is written out without sorting it.
+    // copies are deep, moves steal the contents and leave a null value behind
+    class Value
+    {
+    public:
+        static const size_t INLINE_SIZE = 16;
+
+        Value(): m_size(0), m_kind(Kind::Null) { m_uint = 0; }
+        // an empty value of kind: false, 0, "", [] or {}
+        explicit Value(Kind kind);
+        Value(bool b): m_size(0), m_kind(Kind::Bool) { m_uint = 0; m_bool = b; }
+        Value(int i): Value((long long) i) { }
+        Value(long i): Value((long long) i) { }
+        Value(long long i): m_size(0), m_kind(Kind::Int) { m_int = i; }
+        Value(unsigned int u): Value((unsigned long long) u) { }
+        Value(unsigned long u): Value((unsigned long long) u) { }
+        Value(unsigned long long u): m_size(0), m_kind(Kind::Uint) { m_uint = u; }
+        Value(double d): m_size(0), m_kind(Kind::Real) { m_real = d; }
+        Value(const char* str): Value(std::string_view(str)) { }
+        Value(std::string_view str);
+        Value(const std::string& str): Value(std::string_view(str)) { }
+        // a copy of the value ref refers to, null if it is invalid
+        explicit Value(const ValueRef& ref);
+        Value(const Value& other);
+        Value(Value&& other) noexcept;
+        ~Value() { this->Release(); }
+        Value& operator=(const Value& other);
+        Value& operator=(Value&& other) noexcept;
+        void Swap(Value& other) noexcept;
+
+        Kind GetKind() const { return m_kind; }
+        bool IsNull() const { return m_kind == Kind::Null; }
+        bool IsBool() const { return m_kind == Kind::Bool; }
+        bool IsInt() const { return m_kind == Kind::Int || m_kind == Kind::Uint; }
+        bool IsNumber() const { return this->IsInt() || m_kind == Kind::Real; }
+        bool IsString() const { return m_kind == Kind::String; }
+        bool IsArray() const { return m_kind == Kind::Array; }
+        bool IsObject() const { return m_kind == Kind::Object; }
+        bool AsBool() const;
+        int64_t AsInt64() const;
+        uint64_t AsUint64() const;
+        double AsDouble() const;
+        std::string_view AsString() const;
+        // element count of an array or member count of an object, 0 otherwise
+        size_t Size() const { return this->IsArray() || this->IsObject() ? m_size : 0; }
+
+        // element of an array or value of the index-th member of an object,
+        // a null value if out of range
+        const Value& operator[](size_t index) const;
+        // the same, except that null becomes an array and an array grows to hold index.
+        // out of range of an object, or on any other kind, writes to the result are dropped
+        Value& operator[](size_t index);
+        const Value& operator[](std::string_view key) const;
+        // the member's value, added as null if there is none. a value that is not an object becomes one
+        Value& operator[](std::string_view key);
+        // key of the index-th member of an object
+        std::string_view GetKey(size_t index) const;
+        const Value* Find(std::string_view key) const;
+        Value* Find(std::string_view key);
+        bool HasMember(std::string_view key) const { return this->Find(key) != nullptr; }
+
+        // adds an element at the end of an array, a value that is not an array becomes one
+        Value& Append(Value value);
+        // adds an element before index, at most Size(), to an array
+        Value& Insert(size_t index, Value value);
+        // removes the element of an array or the member of an object at index
+        void Erase(size_t index);
+        // removes the member with key, false if there is none
+        bool Remove(std::string_view key);
+        // sets the element count of an array, new elements are null
+        void Resize(size_t size);
+        // makes room for size elements or members without moving them again
+        void Reserve(size_t size);
+        // removes every element or member, the kind stays
+        void Clear();
+
+        // same kind and contents, ints and uints compare by value
+        bool operator==(const Value& other) const;
+        bool operator!=(const Value& other) const { return !(*this == other); }
+
+    private:
+        struct Member;
+
+        Value* GetElements() const { return (Value*) m_items.data; }
+        Member* GetMembers() const { return (Member*) m_items.data; }
+        // position of key in the members, or where it would go
+        size_t LowerBound(std::string_view key) const;
+        // makes room for one more element or member at index, the caller constructs it
+        void* Open(size_t index, size_t item_size);
+        void Grow(size_t capacity, size_t item_size);
+        void Release();
+
+    private:
+        // container storage, capacity is counted in elements or members
+        struct Items
+        {
+            void* data;
+            uint32_t capacity;
+        };
+
+        union
+        {
+            bool m_bool;
+            int64_t m_int;
+            uint64_t m_uint;
+            double m_real;
+            char* m_chars;
+            Items m_items;
+            char m_inline[INLINE_SIZE];
+        };
+        // byte size of a string, element or member count of a container
+        uint32_t m_size;
+        Kind m_kind;
+    };
+
+    struct Value::Member
+    {
+        Value key;
+        Value value;
+    };
+}
@@ -0,0 +1,190 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/span.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string_view>
+
+namespace jsonb
+{
+    // logical kind of an encoded value, independent of the width it was stored with
+    enum class Kind : uint8_t
+    {
+        Null,
+        Bool,
+        Int,
+        Uint,
+        Real,
+        String,
+        Array,
+        Object,
+    };
+
+    class View;
+
+    // read-only reference to one value inside a binary buffer, it never copies and never allocates.
+    // it points at the View it came from for the dictionary and the blocks, so the buffer and that
+    // View object both must outlive it, the readers taking a View refuse a temporary one
+    class ValueRef
+    {
+    public:
+        class Iterator;
+
+        ValueRef();
+        bool IsValid() const { return m_data != nullptr; }
+        // raw type tag as laid out in src/format.h, for elements of a typed array their element type
+        uint8_t GetTag() const { return m_type; }
+        Kind GetKind() const;
+        bool IsNull() const { return this->GetKind() == Kind::Null; }
+        bool IsBool() const { return this->GetKind() == Kind::Bool; }
+        bool IsInt() const;
+        bool IsNumber() const;
+        bool IsString() const { return this->GetKind() == Kind::String; }
+        bool IsArray() const { return this->GetKind() == Kind::Array; }
+        bool IsObject() const { return this->GetKind() == Kind::Object; }
+        bool AsBool() const;
+        int64_t AsInt64() const;
+        uint64_t AsUint64() const;
+        double AsDouble() const;
+        std::string_view AsString() const;
+        // element count of an array or member count of an object, 0 otherwise
+        size_t Size() const;
+        ValueRef operator[](size_t index) const;
+        ValueRef operator[](std::string_view key) const { return this->Find(key); }
+        ValueRef Find(std::string_view key) const;
+        // same as Find(key) with the result of View::FindString(key) looked up once for many calls
+        ValueRef Find(std::string_view key, size_t key_index) const;
+        bool HasMember(std::string_view key) const { return this->Find(key).IsValid(); }
+        Iterator begin() const;
+        Iterator end() const;
+        // true for an array stored packed, its elements are then numbers of one type
+        bool IsTypedArray() const;
+        // elements of a typed array stored as T, empty if they are of another type or
+        // not aligned for T in memory. T is one of the fixed width ints, float or double
+        template <class T>
+        Span<const T> AsSpan() const;
+        // converts up to size elements of a numeric array, in bulk for typed arrays,
+        // returns how many were written
+        size_t CopyTo(double* out, size_t size) const;
+        size_t CopyTo(float* out, size_t size) const;
+        size_t CopyTo(int64_t* out, size_t size) const;
+        // start of the encoded value at its tag, or the bare payload for an element of a typed array
+        const uint8_t* GetData() const { return m_data; }
+        // end of the bytes the value is read from, the view's buffer or the decompressed block holding it
+        const uint8_t* GetEnd() const;
+
+    private:
+        friend class View;
+        ValueRef(const View* view, const uint8_t* data);
+        ValueRef(const View* view, const uint8_t* payload, uint8_t type);
+        const uint8_t* GetPayload() const { return m_packed ? m_data : m_data + 1; }
+        template <class T>
+        size_t CopyNumbers(T* out, size_t size) const;
+
+    private:
+        const View* m_view;
+        const uint8_t* m_data;
+        uint8_t m_type;
+        bool m_packed;
+    };
+
+    // walks the elements of an array or the members of an object,
+    // members of a v2 object come in key order
+    class ValueRef::Iterator
+    {
+    public:
+        Iterator();
+        std::string_view Key() const;
+        size_t Index() const { return m_index; }
+        ValueRef operator*() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+
+    private:
+        friend class ValueRef;
+        Iterator(const View* view, const uint8_t* pos, const uint8_t* table, int width, size_t count, bool object);
+        const uint8_t* GetCurrent() const;
+
+    private:
+        const View* m_view;
+        // v1 walks m_pos child by child, v2 indexes the offset table from m_pos,
+        // typed arrays step m_element_size bytes from m_pos
+        const uint8_t* m_pos;
+        const uint8_t* m_table;
+        int m_width;
+        size_t m_index;
+        size_t m_count;
+        bool m_object;
+        uint8_t m_element_type;
+        int m_element_size;
+    };
+
+    // zero-copy view over a .jsonb buffer owned by the caller,
+    // opening a view is O(1) and values are decoded on access.
+    // v2 buffers index elements in O(1) and keys in O(log n), v1 buffers are scanned.
+    // a compressed block is decompressed the first time a ValueRef to it is made and kept,
+    // shared by every copy of the view, until the last copy goes away
+    class View
+    {
+    public:
+        View();
+        View(const void* binary, size_t size);
+        bool IsValid() const { return m_begin != nullptr; }
+        ValueRef Root() const &;
+        ValueRef Root() const && = delete;
+        const uint8_t* GetBegin() const { return m_begin; }
+        const uint8_t* GetEnd() const { return m_end; }
+        // 1 for the headerless legacy layout, 2 for the offset-indexed layout
+        int GetVersion() const { return m_version; }
+        // number of strings in the dictionary section, 0 if there is none
+        size_t GetStringCount() const { return m_string_count; }
+        // index-th dictionary string, every key that refers to it shares these bytes
+        std::string_view GetString(size_t index) const;
+        // index of str in the dictionary, GetStringCount() if it is not there
+        size_t FindString(std::string_view str) const;
+
+    private:
+        friend class StreamReader;
+        friend class StructReader;
+        // a record of a stream, a headerless root value that uses the strings of another view
+        View(const View& strings, const uint8_t* root, size_t size);
+        // reads a dictionary section, returns the first byte after it or nullptr if it is malformed
+        const uint8_t* ReadDictionary(const uint8_t* section, const uint8_t* end);
+        // view of the decompressed block at data, nullptr if it is malformed. thread safe
+        const View* GetBlock(const uint8_t* data) const;
+
+    private:
+        friend class ValueRef;
+        struct BlockCache;
+
+        const uint8_t* m_begin;
+        const uint8_t* m_end;
+        const uint8_t* m_root;
+        int m_version;
+        const uint8_t* m_string_offsets;
+        const uint8_t* m_string_data;
+        size_t m_string_data_size;
+        size_t m_string_count;
+        // blocks decompressed so far, null for a buffer without blocks
+        std::shared_ptr<BlockCache> m_blocks;
+    };
+}
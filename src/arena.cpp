@@ -0,0 +1,112 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/arena.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+namespace jsonb
+{
+    namespace
+    {
+        const size_t MIN_CHUNK_SIZE = 4096;
+        const size_t MAX_CHUNK_SIZE = 1024 * 1024;
+    }
+
+    Arena::Arena():
+        m_current(0),
+        m_capacity(0),
+        m_next_size(MIN_CHUNK_SIZE),
+        m_pos(nullptr),
+        m_end(nullptr)
+    {
+
+    }
+
+    Arena::~Arena()
+    {
+        this->Clear();
+    }
+
+    void Arena::Reserve(size_t size)
+    {
+        if (m_capacity < size)
+        {
+            m_next_size = std::max(m_next_size, size - m_capacity);
+        }
+    }
+
+    void Arena::Reset()
+    {
+        m_current = 0;
+        if (m_chunks.size() > 0)
+        {
+            m_pos = m_chunks[0].data;
+            m_end = m_pos + m_chunks[0].size;
+        }
+    }
+
+    void Arena::Clear()
+    {
+        for (size_t i = 0; i < m_chunks.size(); ++i)
+        {
+            free(m_chunks[i].data);
+        }
+        m_chunks.clear();
+        m_current = 0;
+        m_capacity = 0;
+        m_next_size = MIN_CHUNK_SIZE;
+        m_pos = nullptr;
+        m_end = nullptr;
+    }
+
+    void* Arena::AllocateSlow(size_t size, size_t align)
+    {
+        // move on to the next kept chunk, the rest of the current one is left unused
+        while (m_pos != nullptr && m_current + 1 < m_chunks.size())
+        {
+            ++m_current;
+            m_pos = m_chunks[m_current].data;
+            m_end = m_pos + m_chunks[m_current].size;
+
+            uintptr_t p = ((uintptr_t) m_pos + align - 1) & ~(uintptr_t) (align - 1);
+            if (p + size <= (uintptr_t) m_end)
+            {
+                m_pos = (uint8_t*) (p + size);
+                return (void*) p;
+            }
+        }
+
+        Chunk chunk;
+        chunk.size = std::max(m_next_size, size + align);
+        chunk.data = (uint8_t*) malloc(chunk.size);
+        if (chunk.data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        m_chunks.push_back(chunk);
+        m_current = m_chunks.size() - 1;
+        m_capacity += chunk.size;
+        m_next_size = std::min(std::max(m_next_size, chunk.size) * 2, MAX_CHUNK_SIZE);
+
+        uintptr_t p = ((uintptr_t) chunk.data + align - 1) & ~(uintptr_t) (align - 1);
+        m_pos = (uint8_t*) (p + size);
+        m_end = chunk.data + chunk.size;
+        return (void*) p;
+    }
+}
@@ -0,0 +1,164 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "block_writer.h"
+#include "encoder.h"
+#include "lz.h"
+
+namespace jsonb
+{
+    bool BlockWriter::Write(const View& source, int level, BufferWriter& writer)
+    {
+        ValueRef root = source.Root();
+        if (source.GetVersion() < 2 || !root.IsValid())
+        {
+            return false;
+        }
+
+        m_level = level;
+        m_end = source.GetEnd();
+        m_block_bytes = 0;
+        m_block_count = 0;
+        m_offsets.clear();
+
+        // the header and the dictionary section stay as they are
+        const uint8_t* begin = source.GetBegin();
+        size_t header_pos = writer.GetSize();
+        writer.Write(begin, root.GetData() - begin);
+        m_root_pos = writer.GetSize();
+        this->WriteValue(writer, root.GetData(), MIN_BLOCK_SIZE);
+        if (m_block_count > 0)
+        {
+            writer.GetData()[header_pos + 5] |= FLAG_BLOCKS;
+        }
+        return true;
+    }
+
+    void BlockWriter::WriteValue(BufferWriter& writer, const uint8_t* p, size_t min_size)
+    {
+        size_t pos = writer.GetSize();
+        ValueType type = (ValueType) *p;
+        switch (type)
+        {
+        case ValueType::Object:
+        case ValueType::Array:
+        {
+            size_t block_bytes = m_block_bytes;
+            uint32_t size;
+            memcpy(&size, p + 1, sizeof(size));
+            const uint8_t* body = p + 1 + CONTAINER_SIZE_BYTES;
+            int width = body[size - 1];
+            size_t count = LoadOffset(body + size - 1 - width, width);
+            const uint8_t* table = body + size - 1 - width - count * width;
+
+            // the children of a container too big for one block get blocks of their own first,
+            // smaller ones than usual, so a reader does not have to decompress all of it for one child
+            size_t child_min_size = 1 + CONTAINER_SIZE_BYTES + size > MAX_BLOCK_SIZE ? SMALL_BLOCK_SIZE : MIN_BLOCK_SIZE;
+
+            // children are written in table order, which is then the order they are laid out in
+            size_t body_pos = encoder::BeginContainer(writer, type);
+            size_t first_offset = m_offsets.size();
+            for (size_t i = 0; i < count; ++i)
+            {
+                m_offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                const uint8_t* child = body + LoadOffset(table + i * width, width);
+                if (type == ValueType::Object)
+                {
+                    const uint8_t* key = child;
+                    if (IsStringRef((ValueType) *key))
+                    {
+                        child = key + 1 + ScalarSize((ValueType) *key);
+                    }
+                    else
+                    {
+                        std::string_view str = encoder::ReadKey(key);
+                        child = (const uint8_t*) str.data() + str.size();
+                    }
+                    writer.Write(key, child - key);
+                }
+                this->WriteValue(writer, child, child_min_size);
+            }
+            encoder::EndContainer(writer, body_pos, m_offsets, first_offset);
+            this->Compress(writer, pos, min_size, m_block_bytes - block_bytes);
+            break;
+        }
+        case ValueType::TypedArray:
+        {
+            // aligned again for where it lands
+            TypedArray a;
+            if (ReadTypedArray(p, m_end, a))
+            {
+                encoder::WriteTypedArray(writer, a.type, a.data, a.count);
+                this->Compress(writer, pos, min_size, 0);
+            }
+            break;
+        }
+        case ValueType::String:
+        {
+            std::string_view str = encoder::ReadKey(p);
+            writer.Write(p, (const uint8_t*) str.data() + str.size() - p);
+            break;
+        }
+        default:
+            writer.Write(p, 1 + ScalarSize(type));
+            break;
+        }
+    }
+
+    void BlockWriter::Compress(BufferWriter& writer, size_t pos, size_t min_size, size_t block_bytes)
+    {
+        // the root stays as it is, opening a buffer never decompresses
+        size_t raw_size = writer.GetSize() - pos;
+        if (pos == m_root_pos || raw_size - block_bytes < min_size)
+        {
+            return;
+        }
+
+        const uint8_t* raw = writer.GetData() + pos;
+        m_compressed.resize(lz::GetBound(raw_size));
+        size_t size = lz::Compress(raw, raw_size, m_compressed.data(), m_level, m_tables);
+        if (BLOCK_HEADER_SIZE + size > raw_size - raw_size / 8 || raw_size > UINT32_MAX)
+        {
+            return;
+        }
+
+        ValueType type = (ValueType) raw[0];
+        uint32_t count = 0;
+        TypedArray a;
+        if (type == ValueType::TypedArray && ReadTypedArray(raw, raw + raw_size, a))
+        {
+            count = (uint32_t) a.count;
+        }
+        else if (type != ValueType::TypedArray)
+        {
+            int width = raw[raw_size - 1];
+            count = LoadOffset(raw + raw_size - 1 - width, width);
+        }
+
+        writer.Truncate(pos);
+        writer.Write((uint8_t) ValueType::Block);
+        writer.Write((uint32_t) (BLOCK_HEADER_SIZE - 1 - CONTAINER_SIZE_BYTES + size));
+        writer.Write((uint8_t) (pos % 8));
+        writer.Write((uint8_t) type);
+        writer.Write(count);
+        writer.Write((uint32_t) raw_size);
+        writer.Write(m_compressed.data(), size);
+        m_block_bytes += writer.GetSize() - pos - block_bytes;
+        m_block_count += 1;
+    }
+}
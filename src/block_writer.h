@@ -0,0 +1,58 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include <jsonb/view.h>
+#include <vector>
+
+namespace jsonb
+{
+    // rewrites a v2 buffer with its containers and typed arrays compressed as blocks, bottom up:
+    // a value is compressed once it holds MIN_BLOCK_SIZE bytes outside of the blocks inside it.
+    // the children of a container bigger than MAX_BLOCK_SIZE only need SMALL_BLOCK_SIZE, so most
+    // of it lands in small blocks and a lazy reader does not decompress much more than it reads.
+    // a block is only kept if it saves an eighth of its bytes, the root is never compressed
+    class BlockWriter
+    {
+    public:
+        static const size_t MIN_BLOCK_SIZE = 8 * 1024;
+        static const size_t SMALL_BLOCK_SIZE = 1024;
+        static const size_t MAX_BLOCK_SIZE = 64 * 1024;
+
+        // source must be a v2 buffer without blocks, level is 1 to 9
+        bool Write(const View& source, int level, BufferWriter& writer);
+
+    private:
+        void WriteValue(BufferWriter& writer, const uint8_t* p, size_t min_size);
+        // compresses the value at pos if the bytes it holds outside of blocks reach min_size
+        void Compress(BufferWriter& writer, size_t pos, size_t min_size, size_t block_bytes);
+
+    private:
+        int m_level;
+        const uint8_t* m_end;
+        size_t m_root_pos;
+        // bytes of the blocks written so far, a container only counts what it holds outside of them
+        size_t m_block_bytes;
+        size_t m_block_count;
+        std::vector<uint32_t> m_offsets;
+        std::vector<uint32_t> m_tables;
+        std::vector<uint8_t> m_compressed;
+    };
+}
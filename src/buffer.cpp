@@ -0,0 +1,105 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/buffer.h>
+#include <stdlib.h>
+#include <new>
+
+namespace jsonb
+{
+    BufferWriter::BufferWriter():
+        m_data(nullptr),
+        m_size(0),
+        m_capacity(0)
+    {
+
+    }
+
+    BufferWriter::~BufferWriter()
+    {
+        if (m_data)
+        {
+            free(m_data);
+            m_data = nullptr;
+        }
+        m_size = 0;
+        m_capacity = 0;
+    }
+
+    BufferWriter::BufferWriter(BufferWriter&& other):
+        m_data(other.m_data),
+        m_size(other.m_size),
+        m_capacity(other.m_capacity)
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+    }
+
+    BufferWriter& BufferWriter::operator=(BufferWriter&& other)
+    {
+        if (this != &other)
+        {
+            if (m_data)
+            {
+                free(m_data);
+            }
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_capacity = other.m_capacity;
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_capacity = 0;
+        }
+        return *this;
+    }
+
+    void BufferWriter::Reserve(size_t capacity)
+    {
+        if (capacity > m_capacity)
+        {
+            void* data = realloc(m_data, capacity);
+            if (data == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            m_data = (uint8_t*) data;
+            m_capacity = capacity;
+        }
+    }
+
+    void BufferWriter::Grow(size_t size)
+    {
+        // amortized doubling, never less than what the pending write needs
+        size_t capacity = m_capacity < 256 ? 256 : m_capacity * 2;
+        if (capacity - m_size < size)
+        {
+            capacity = m_size + size;
+        }
+        this->Reserve(capacity);
+    }
+
+    void* BufferWriter::Release(size_t& size)
+    {
+        void* data = m_data;
+        size = m_size;
+        m_data = nullptr;
+        m_size = 0;
+        m_capacity = 0;
+        return data;
+    }
+}
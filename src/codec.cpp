@@ -0,0 +1,728 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/codec.h>
+#include "encoder.h"
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace jsonb
+{
+    namespace
+    {
+        const int MAX_DEPTH = 1000;
+
+        const ValueType NUMBER_TYPES[] = {
+            ValueType::Uint8,
+            ValueType::Int8,
+            ValueType::Uint16,
+            ValueType::Int16,
+            ValueType::Uint32,
+            ValueType::Int32,
+            ValueType::Uint64,
+            ValueType::Int64,
+            ValueType::Float,
+            ValueType::Double,
+        };
+
+        // tags an int like the transcoder tags a parsed one: past an Int32 non-negative values
+        // are Uint64 and negative ones Int64
+        void WriteParsedInt(BufferWriter& writer, int64_t i)
+        {
+            if (i > INT32_MAX)
+            {
+                encoder::WriteUint64(writer, (uint64_t) i);
+                return;
+            }
+            encoder::WriteInt64(writer, i);
+        }
+
+        void WriteParsedUint(BufferWriter& writer, uint64_t u)
+        {
+            if (u > INT32_MAX)
+            {
+                encoder::WriteUint64(writer, u);
+                return;
+            }
+            encoder::WriteInt64(writer, (int64_t) u);
+        }
+
+        // the type the encoder packs the same ints with once parsed: the smallest that holds them all
+        // while they fit an Int32, Uint64 or Int64 when every one is past it on the same side, else
+        // Null and they stay tagged one by one
+        template <class T>
+        ValueType NarrowType(const T* data, size_t count)
+        {
+            int64_t min = 0;
+            int64_t max = 0;
+            size_t above = 0;
+            size_t below = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (std::is_signed<T>::value && (int64_t) data[i] < INT32_MIN)
+                {
+                    ++below;
+                    continue;
+                }
+                if ((std::is_signed<T>::value ? (int64_t) data[i] > INT32_MAX : (uint64_t) data[i] > INT32_MAX))
+                {
+                    ++above;
+                    continue;
+                }
+                int64_t value = (int64_t) data[i];
+                min = i == above + below || value < min ? value : min;
+                max = i == above + below || value > max ? value : max;
+            }
+
+            if (above + below > 0)
+            {
+                return above == count ? ValueType::Uint64 : below == count ? ValueType::Int64 : ValueType::Null;
+            }
+            if (min >= -128 && max <= 127)
+            {
+                return ValueType::Int8;
+            }
+            if (min >= 0 && max <= 255)
+            {
+                return ValueType::Uint8;
+            }
+            if (min >= -32768 && max <= 32767)
+            {
+                return ValueType::Int16;
+            }
+            if (min >= 0 && max <= 65535)
+            {
+                return ValueType::Uint16;
+            }
+            return ValueType::Int32;
+        }
+
+        template <class To, class From>
+        void Convert(const From* data, size_t count, BufferWriter& scratch)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                scratch.Write((To) data[i]);
+            }
+        }
+
+        template <class T>
+        void WriteInts(BufferWriter& writer, BufferWriter& scratch, std::vector<uint32_t>& offsets, ValueType type, const T* data, size_t count)
+        {
+            ValueType packed = NarrowType(data, count);
+            if (packed == ValueType::Null)
+            {
+                size_t body_pos = encoder::BeginContainer(writer, ValueType::Array);
+                size_t first_offset = offsets.size();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                    if (std::is_signed<T>::value)
+                    {
+                        WriteParsedInt(writer, (int64_t) data[i]);
+                    }
+                    else
+                    {
+                        WriteParsedUint(writer, (uint64_t) data[i]);
+                    }
+                }
+                encoder::EndContainer(writer, body_pos, offsets, first_offset);
+                return;
+            }
+            // 64 bit elements in range of both keep their bits under either tag
+            if (packed == type || (ScalarSize(packed) == 8 && sizeof(T) == 8))
+            {
+                encoder::WriteTypedArray(writer, packed, data, count);
+                return;
+            }
+
+            scratch.Clear();
+            scratch.Reserve(count * ScalarSize(packed));
+            switch (packed)
+            {
+            case ValueType::Int8:
+                Convert<int8_t>(data, count, scratch);
+                break;
+            case ValueType::Uint8:
+                Convert<uint8_t>(data, count, scratch);
+                break;
+            case ValueType::Int16:
+                Convert<int16_t>(data, count, scratch);
+                break;
+            case ValueType::Uint16:
+                Convert<uint16_t>(data, count, scratch);
+                break;
+            case ValueType::Uint64:
+                Convert<uint64_t>(data, count, scratch);
+                break;
+            default:
+                Convert<int32_t>(data, count, scratch);
+                break;
+            }
+            encoder::WriteTypedArray(writer, packed, scratch.GetData(), count);
+        }
+
+        // doubles are packed as floats when every one of them is exact, like parsed reals
+        void WriteDoubles(BufferWriter& writer, BufferWriter& scratch, const double* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if ((double) (float) data[i] != data[i])
+                {
+                    encoder::WriteTypedArray(writer, ValueType::Double, data, count);
+                    return;
+                }
+            }
+
+            scratch.Clear();
+            scratch.Reserve(count * sizeof(float));
+            Convert<float>(data, count, scratch);
+            encoder::WriteTypedArray(writer, ValueType::Float, scratch.GetData(), count);
+        }
+
+        // an int payload as int64 bits, big is set for a Uint64 past INT64_MAX
+        bool LoadInteger(ValueType type, const uint8_t* p, const uint8_t* end, int64_t& i, bool& big)
+        {
+            if (type < ValueType::Uint8 || type > ValueType::Int64 || end - p < ScalarSize(type))
+            {
+                return false;
+            }
+            big = false;
+            switch (type)
+            {
+            case ValueType::Uint8:
+                i = p[0];
+                break;
+            case ValueType::Int8:
+                i = (int8_t) p[0];
+                break;
+            case ValueType::Uint16:
+            {
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                i = v;
+                break;
+            }
+            case ValueType::Int16:
+            {
+                int16_t v;
+                memcpy(&v, p, sizeof(v));
+                i = v;
+                break;
+            }
+            case ValueType::Uint32:
+            {
+                uint32_t v;
+                memcpy(&v, p, sizeof(v));
+                i = v;
+                break;
+            }
+            case ValueType::Int32:
+            {
+                int32_t v;
+                memcpy(&v, p, sizeof(v));
+                i = v;
+                break;
+            }
+            case ValueType::Uint64:
+            {
+                uint64_t v;
+                memcpy(&v, p, sizeof(v));
+                i = (int64_t) v;
+                big = v > INT64_MAX;
+                break;
+            }
+            default:
+                memcpy(&i, p, sizeof(i));
+                break;
+            }
+            return true;
+        }
+
+        // a count or length written with WriteInt64, returns the position after it or nullptr
+        const uint8_t* ReadLength(const uint8_t* p, const uint8_t* end, size_t& length)
+        {
+            int64_t i;
+            bool big;
+            if (p >= end || !LoadInteger((ValueType) *p, p + 1, end, i, big) || big || i < 0)
+            {
+                return nullptr;
+            }
+            length = (size_t) i;
+            return p + 1 + ScalarSize((ValueType) *p);
+        }
+
+        // a string or dictionary reference starting at its tag, returns the position after it or nullptr
+        const uint8_t* ReadStringAt(const View* view, const uint8_t* p, const uint8_t* end, std::string_view& str)
+        {
+            ValueType type = (ValueType) *p;
+            if (type == ValueType::String)
+            {
+                size_t size = 0;
+                p = ReadLength(p + 1, end, size);
+                if (p == nullptr || (size_t) (end - p) < size)
+                {
+                    return nullptr;
+                }
+                str = std::string_view((const char*) p, size);
+                return p + size;
+            }
+            if (!IsStringRef(type))
+            {
+                return nullptr;
+            }
+            int size = ScalarSize(type);
+            if (end - p - 1 < size)
+            {
+                return nullptr;
+            }
+            size_t index = LoadOffset(p + 1, size);
+            if (index >= view->GetStringCount())
+            {
+                return nullptr;
+            }
+            str = view->GetString(index);
+            return p + 1 + size;
+        }
+
+        // the position after a v1 value, children are stored back to back
+        const uint8_t* SkipValue(const View* view, const uint8_t* p, const uint8_t* end, int depth)
+        {
+            if (p >= end || depth > MAX_DEPTH)
+            {
+                return nullptr;
+            }
+            ValueType type = (ValueType) *p;
+            if (type == ValueType::Object || type == ValueType::Array)
+            {
+                size_t count = 0;
+                p = ReadLength(p + 1, end, count);
+                for (size_t i = 0; i < count && p; ++i)
+                {
+                    std::string_view key;
+                    p = type == ValueType::Object && p < end ? ReadStringAt(view, p, end, key) : p;
+                    p = p ? SkipValue(view, p, end, depth + 1) : nullptr;
+                }
+                return p;
+            }
+            if (type == ValueType::String || IsStringRef(type))
+            {
+                std::string_view str;
+                return ReadStringAt(view, p, end, str);
+            }
+            int size = ScalarSize(type);
+            return size >= 0 && end - p - 1 >= size ? p + 1 + size : nullptr;
+        }
+
+        template <class From, class To>
+        void ConvertNumbers(const uint8_t* p, size_t count, To* out)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                From v;
+                memcpy(&v, p + i * sizeof(From), sizeof(From));
+                out[i] = (To) v;
+            }
+        }
+
+        template <class To>
+        bool ReadPacked(const StructReader::Children& children, To* out)
+        {
+            const uint8_t* p = children.pos;
+            size_t count = children.count;
+            switch ((ValueType) children.element_type)
+            {
+            case ValueType::Uint8:
+                ConvertNumbers<uint8_t>(p, count, out);
+                break;
+            case ValueType::Int8:
+                ConvertNumbers<int8_t>(p, count, out);
+                break;
+            case ValueType::Uint16:
+                ConvertNumbers<uint16_t>(p, count, out);
+                break;
+            case ValueType::Int16:
+                ConvertNumbers<int16_t>(p, count, out);
+                break;
+            case ValueType::Uint32:
+                ConvertNumbers<uint32_t>(p, count, out);
+                break;
+            case ValueType::Int32:
+                ConvertNumbers<int32_t>(p, count, out);
+                break;
+            case ValueType::Uint64:
+                ConvertNumbers<uint64_t>(p, count, out);
+                break;
+            case ValueType::Int64:
+                ConvertNumbers<int64_t>(p, count, out);
+                break;
+            case ValueType::Float:
+                ConvertNumbers<float>(p, count, out);
+                break;
+            case ValueType::Double:
+                ConvertNumbers<double>(p, count, out);
+                break;
+            default:
+                return false;
+            }
+            return true;
+        }
+    }
+
+    StructWriter::StructWriter(BufferWriter& writer):
+        m_writer(writer)
+    {
+    }
+
+    void StructWriter::WriteHeader()
+    {
+        encoder::WriteHeader(m_writer);
+    }
+
+    void StructWriter::WriteInt(int64_t i)
+    {
+        WriteParsedInt(m_writer, i);
+    }
+
+    void StructWriter::WriteUint(uint64_t u)
+    {
+        WriteParsedUint(m_writer, u);
+    }
+
+    void StructWriter::WriteFloat(float f)
+    {
+        encoder::WriteFloat(m_writer, f);
+    }
+
+    void StructWriter::WriteDouble(double d)
+    {
+        encoder::WriteReal(m_writer, d);
+    }
+
+    void StructWriter::WriteBool(bool b)
+    {
+        encoder::WriteBool(m_writer, b);
+    }
+
+    void StructWriter::WriteNull()
+    {
+        encoder::WriteNull(m_writer);
+    }
+
+    void StructWriter::WriteString(std::string_view str)
+    {
+        encoder::WriteString(m_writer, str.data(), str.size());
+    }
+
+    void StructWriter::WriteNumbers(NumberType type, const void* data, size_t count)
+    {
+        ValueType element_type = NUMBER_TYPES[(int) type];
+        switch (type)
+        {
+        case NumberType::Uint8:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const uint8_t*) data, count);
+            break;
+        case NumberType::Int8:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const int8_t*) data, count);
+            break;
+        case NumberType::Uint16:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const uint16_t*) data, count);
+            break;
+        case NumberType::Int16:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const int16_t*) data, count);
+            break;
+        case NumberType::Uint32:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const uint32_t*) data, count);
+            break;
+        case NumberType::Int32:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const int32_t*) data, count);
+            break;
+        case NumberType::Uint64:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const uint64_t*) data, count);
+            break;
+        case NumberType::Int64:
+            WriteInts(m_writer, m_scratch, m_offsets, element_type, (const int64_t*) data, count);
+            break;
+        case NumberType::Double:
+            WriteDoubles(m_writer, m_scratch, (const double*) data, count);
+            break;
+        default:
+            encoder::WriteTypedArray(m_writer, element_type, data, count);
+            break;
+        }
+    }
+
+    StructWriter::Scope StructWriter::BeginObject()
+    {
+        size_t body_pos = encoder::BeginContainer(m_writer, ValueType::Object);
+        return { body_pos, m_offsets.size() };
+    }
+
+    StructWriter::Scope StructWriter::BeginArray()
+    {
+        size_t body_pos = encoder::BeginContainer(m_writer, ValueType::Array);
+        return { body_pos, m_offsets.size() };
+    }
+
+    void StructWriter::AddChild(const Scope& scope)
+    {
+        m_offsets.push_back((uint32_t) (m_writer.GetSize() - scope.body_pos));
+    }
+
+    void StructWriter::End(const Scope& scope)
+    {
+        encoder::EndContainer(m_writer, scope.body_pos, m_offsets, scope.first_offset);
+    }
+
+    bool StructReader::GetRoot(Item& item) const
+    {
+        return m_view.IsValid() && this->MakeItem(&m_view, m_view.m_root, item);
+    }
+
+    bool StructReader::IsNull(const Item& item) const
+    {
+        return (ValueType) item.type == ValueType::Null;
+    }
+
+    bool StructReader::ReadBool(const Item& item, bool& b) const
+    {
+        if ((ValueType) item.type != ValueType::Bool || item.payload >= item.end)
+        {
+            return false;
+        }
+        b = item.payload[0] != 0;
+        return true;
+    }
+
+    bool StructReader::ReadInt(const Item& item, int64_t& i) const
+    {
+        bool big;
+        return LoadInteger((ValueType) item.type, item.payload, item.end, i, big) && !big;
+    }
+
+    bool StructReader::ReadUint(const Item& item, uint64_t& u) const
+    {
+        int64_t i;
+        bool big;
+        if (!LoadInteger((ValueType) item.type, item.payload, item.end, i, big) || (i < 0 && !big))
+        {
+            return false;
+        }
+        u = (uint64_t) i;
+        return true;
+    }
+
+    bool StructReader::ReadReal(const Item& item, double& d) const
+    {
+        int64_t i;
+        bool big;
+        ValueType type = (ValueType) item.type;
+        if (LoadInteger(type, item.payload, item.end, i, big))
+        {
+            d = big ? (double) (uint64_t) i : (double) i;
+            return true;
+        }
+        if (!IsReal(type) || item.end - item.payload < ScalarSize(type))
+        {
+            return false;
+        }
+        if (type == ValueType::Float)
+        {
+            float f;
+            memcpy(&f, item.payload, sizeof(f));
+            d = f;
+        }
+        else if (type == ValueType::Double)
+        {
+            memcpy(&d, item.payload, sizeof(d));
+        }
+        else
+        {
+            d = LoadDecimal(item.payload);
+        }
+        return true;
+    }
+
+    bool StructReader::ReadString(const Item& item, std::string_view& str) const
+    {
+        return ReadStringAt(item.view, item.payload - 1, item.end, str) != nullptr;
+    }
+
+    bool StructReader::OpenObject(const Item& item, Children& children) const
+    {
+        return this->OpenContainer(item, (uint8_t) ValueType::Object, children);
+    }
+
+    bool StructReader::OpenArray(const Item& item, Children& children) const
+    {
+        return this->OpenContainer(item, (uint8_t) ValueType::Array, children);
+    }
+
+    bool StructReader::OpenContainer(const Item& item, uint8_t type, Children& children) const
+    {
+        const uint8_t* p = item.payload - 1;
+        children.view = item.view;
+        children.table = nullptr;
+        children.end = item.end;
+        children.index = 0;
+        children.width = 0;
+        children.element_type = 0;
+        children.element_size = 0;
+        if ((ValueType) item.type == ValueType::TypedArray && (ValueType) type == ValueType::Array)
+        {
+            TypedArray a;
+            if (!ReadTypedArray(p, item.end, a))
+            {
+                return false;
+            }
+            children.pos = a.data;
+            children.count = a.count;
+            children.element_type = (uint8_t) a.type;
+            children.element_size = a.size;
+            return true;
+        }
+        if (item.type != type)
+        {
+            return false;
+        }
+
+        if (item.view->GetVersion() >= 2)
+        {
+            Container c;
+            if (!ReadContainer(p, item.end, c))
+            {
+                return false;
+            }
+            children.pos = c.body;
+            children.table = c.table;
+            children.count = c.count;
+            children.width = c.width;
+            return true;
+        }
+
+        // every v1 child takes a byte at least, a bigger count can not be right
+        children.pos = ReadLength(item.payload, item.end, children.count);
+        return children.pos != nullptr && children.count <= (size_t) (item.end - children.pos);
+    }
+
+    bool StructReader::NextMember(Children& children, std::string_view& key, Item& value) const
+    {
+        if (children.index >= children.count || children.element_size > 0)
+        {
+            return false;
+        }
+        // a malformed v1 child leaves nothing to find the next one by
+        const uint8_t* p = children.pos;
+        if (p == nullptr)
+        {
+            return false;
+        }
+        if (children.table != nullptr)
+        {
+            uint32_t offset = LoadOffset(children.table + children.index * children.width, children.width);
+            if (offset >= (size_t) (children.table - children.pos))
+            {
+                return false;
+            }
+            p += offset;
+        }
+        ++children.index;
+
+        p = p < children.end ? ReadStringAt(children.view, p, children.end, key) : nullptr;
+        if (p == nullptr)
+        {
+            return false;
+        }
+        if (children.table == nullptr)
+        {
+            children.pos = SkipValue(children.view, p, children.end, 0);
+        }
+        return this->MakeItem(children.view, p, value);
+    }
+
+    bool StructReader::NextElement(Children& children, Item& value) const
+    {
+        if (children.index >= children.count)
+        {
+            return false;
+        }
+        size_t index = children.index++;
+        if (children.element_size > 0)
+        {
+            value.view = children.view;
+            value.payload = children.pos + index * children.element_size;
+            value.end = children.end;
+            value.type = children.element_type;
+            return true;
+        }
+
+        const uint8_t* p = children.pos;
+        if (p == nullptr)
+        {
+            return false;
+        }
+        if (children.table != nullptr)
+        {
+            uint32_t offset = LoadOffset(children.table + index * children.width, children.width);
+            if (offset >= (size_t) (children.table - children.pos))
+            {
+                return false;
+            }
+            p += offset;
+        }
+        else
+        {
+            children.pos = SkipValue(children.view, p, children.end, 0);
+        }
+        return this->MakeItem(children.view, p, value);
+    }
+
+    bool StructReader::ReadNumbers(const Children& children, float* out) const
+    {
+        return ReadPacked(children, out);
+    }
+
+    bool StructReader::ReadNumbers(const Children& children, double* out) const
+    {
+        return ReadPacked(children, out);
+    }
+
+    bool StructReader::MakeItem(const View* view, const uint8_t* p, Item& item) const
+    {
+        if (p == nullptr || p >= view->GetEnd())
+        {
+            return false;
+        }
+        if ((ValueType) *p == ValueType::Block)
+        {
+            // the container the block decompresses to
+            view = view->GetBlock(p);
+            if (view == nullptr)
+            {
+                return false;
+            }
+            p = view->m_root;
+        }
+        item.view = view;
+        item.payload = p + 1;
+        item.end = view->GetEnd();
+        item.type = *p;
+        return true;
+    }
+}
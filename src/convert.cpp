@@ -0,0 +1,184 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSONB_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define JSONB_AVX 1
+#include <immintrin.h>
+#endif
+
+namespace jsonb
+{
+    namespace
+    {
+        template <class S, class D>
+        void Convert(const uint8_t* src, D* dst, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                S s;
+                memcpy(&s, src + i * sizeof(S), sizeof(S));
+                dst[i] = (D) s;
+            }
+        }
+
+        template <class D>
+        void ConvertTo(ValueType type, const uint8_t* src, D* dst, size_t count)
+        {
+            switch (type)
+            {
+            case ValueType::Uint8:
+                Convert<uint8_t>(src, dst, count);
+                break;
+            case ValueType::Int8:
+                Convert<int8_t>(src, dst, count);
+                break;
+            case ValueType::Uint16:
+                Convert<uint16_t>(src, dst, count);
+                break;
+            case ValueType::Int16:
+                Convert<int16_t>(src, dst, count);
+                break;
+            case ValueType::Uint32:
+                Convert<uint32_t>(src, dst, count);
+                break;
+            case ValueType::Int32:
+                Convert<int32_t>(src, dst, count);
+                break;
+            case ValueType::Uint64:
+                Convert<uint64_t>(src, dst, count);
+                break;
+            case ValueType::Int64:
+                Convert<int64_t>(src, dst, count);
+                break;
+            case ValueType::Float:
+                Convert<float>(src, dst, count);
+                break;
+            case ValueType::Double:
+                Convert<double>(src, dst, count);
+                break;
+            default:
+                break;
+            }
+        }
+
+        void FloatToDouble(const uint8_t* src, double* dst, size_t count)
+        {
+            size_t i = 0;
+#if JSONB_AVX
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 f = _mm_loadu_ps((const float*) (src + i * 4));
+                _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(f));
+            }
+#elif JSONB_SSE2
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 f = _mm_loadu_ps((const float*) (src + i * 4));
+                _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+                _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+            }
+#endif
+            Convert<float>(src + i * 4, dst + i, count - i);
+        }
+
+        void Int32ToDouble(const uint8_t* src, double* dst, size_t count)
+        {
+            size_t i = 0;
+#if JSONB_AVX
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 4));
+                _mm256_storeu_pd(dst + i, _mm256_cvtepi32_pd(v));
+            }
+#elif JSONB_SSE2
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 4));
+                _mm_storeu_pd(dst + i, _mm_cvtepi32_pd(v));
+                _mm_storeu_pd(dst + i + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+            }
+#endif
+            Convert<int32_t>(src + i * 4, dst + i, count - i);
+        }
+
+        void Int32ToFloat(const uint8_t* src, float* dst, size_t count)
+        {
+            size_t i = 0;
+#if JSONB_AVX
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (src + i * 4));
+                _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+            }
+#endif
+#if JSONB_SSE2
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 4));
+                _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(v));
+            }
+#endif
+            Convert<int32_t>(src + i * 4, dst + i, count - i);
+        }
+    }
+
+    void ConvertToDouble(ValueType type, const uint8_t* src, double* dst, size_t count)
+    {
+        switch (type)
+        {
+        case ValueType::Float:
+            FloatToDouble(src, dst, count);
+            break;
+        case ValueType::Int32:
+            Int32ToDouble(src, dst, count);
+            break;
+        case ValueType::Double:
+            memcpy(dst, src, count * sizeof(double));
+            break;
+        default:
+            ConvertTo(type, src, dst, count);
+            break;
+        }
+    }
+
+    void ConvertToFloat(ValueType type, const uint8_t* src, float* dst, size_t count)
+    {
+        switch (type)
+        {
+        case ValueType::Float:
+            memcpy(dst, src, count * sizeof(float));
+            break;
+        case ValueType::Int32:
+            Int32ToFloat(src, dst, count);
+            break;
+        default:
+            ConvertTo(type, src, dst, count);
+            break;
+        }
+    }
+
+    void ConvertToInt64(ValueType type, const uint8_t* src, int64_t* dst, size_t count)
+    {
+        ConvertTo(type, src, dst, count);
+    }
+}
@@ -0,0 +1,29 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "format.h"
+
+namespace jsonb
+{
+    // bulk conversion of packed little endian elements, as stored in typed arrays.
+    // float and int32 elements go through SSE2, or AVX when the build enables it
+    void ConvertToDouble(ValueType type, const uint8_t* src, double* dst, size_t count);
+    void ConvertToFloat(ValueType type, const uint8_t* src, float* dst, size_t count);
+    void ConvertToInt64(ValueType type, const uint8_t* src, int64_t* dst, size_t count);
+}
@@ -0,0 +1,233 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/dictionary.h>
+#include "encoder.h"
+#include <algorithm>
+
+namespace jsonb
+{
+    namespace
+    {
+        const uint32_t NO_INDEX = 0xffffffff;
+
+        // bytes WriteString spends on the length of a string
+        size_t LengthSize(size_t size)
+        {
+            if (size <= 255)
+            {
+                return 2;
+            }
+            if (size <= 65535)
+            {
+                return 3;
+            }
+            return 5;
+        }
+    }
+
+    bool DictionaryWriter::Write(const View& source, bool strings, BufferWriter& writer)
+    {
+        ValueRef root = source.Root();
+        if (!root.IsValid())
+        {
+            return false;
+        }
+
+        m_entries.clear();
+        m_strings.clear();
+        m_offsets.clear();
+        m_values = strings;
+
+        this->Collect(root);
+
+        // keys always go in, values only when the references save more than the dictionary costs,
+        // a reference is taken as 3 bytes
+        for (auto& i : m_entries)
+        {
+            Entry& entry = i.second;
+            size_t size = i.first.size();
+            size_t saved = 1 + LengthSize(size) + size - 3;
+            if (entry.key || (entry.count > 1 && entry.count * saved > size + 4))
+            {
+                m_strings.push_back(i.first);
+            }
+        }
+
+        // sorted like object keys, so references compare like the strings they stand for
+        std::sort(m_strings.begin(), m_strings.end());
+        for (size_t i = 0; i < m_strings.size(); ++i)
+        {
+            m_entries[m_strings[i]].index = (uint32_t) i;
+        }
+
+        encoder::WriteHeader(writer, FLAG_DICTIONARY);
+        this->WriteSection(writer);
+        this->WriteValue(writer, root);
+        return true;
+    }
+
+    void DictionaryWriter::WriteShared(const std::vector<std::string>& strings, BufferWriter& writer)
+    {
+        m_entries.clear();
+        m_strings.clear();
+        m_offsets.clear();
+        for (size_t i = 0; i < strings.size(); ++i)
+        {
+            m_strings.push_back(strings[i]);
+            m_entries.emplace(strings[i], Entry { 0, (uint32_t) i, true });
+        }
+        if (!strings.empty())
+        {
+            this->WriteSection(writer);
+        }
+    }
+
+    bool DictionaryWriter::WriteRoot(const View& source, BufferWriter& writer)
+    {
+        ValueRef root = source.Root();
+        if (!root.IsValid())
+        {
+            return false;
+        }
+
+        this->WriteValue(writer, root);
+        return true;
+    }
+
+    void DictionaryWriter::WriteSection(BufferWriter& writer)
+    {
+        size_t section_pos = writer.Skip(sizeof(uint32_t));
+        writer.Write((uint32_t) m_strings.size());
+        uint32_t offset = 0;
+        for (size_t i = 0; i < m_strings.size(); ++i)
+        {
+            writer.Write(offset);
+            offset += (uint32_t) m_strings[i].size();
+        }
+        writer.Write(offset);
+        for (size_t i = 0; i < m_strings.size(); ++i)
+        {
+            writer.Write(m_strings[i].data(), m_strings[i].size());
+        }
+        writer.Patch(section_pos, (uint32_t) (writer.GetSize() - section_pos - sizeof(uint32_t)));
+    }
+
+    void DictionaryWriter::Collect(const ValueRef& value)
+    {
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                this->AddString(i.Key(), true);
+                this->Collect(*i);
+            }
+            break;
+        case Kind::Array:
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                this->Collect(*i);
+            }
+            break;
+        case Kind::String:
+            if (m_values)
+            {
+                this->AddString(value.AsString(), false);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void DictionaryWriter::AddString(std::string_view str, bool key)
+    {
+        auto result = m_entries.emplace(str, Entry { 0, NO_INDEX, key });
+        Entry& entry = result.first->second;
+        entry.count += 1;
+        entry.key = entry.key || key;
+    }
+
+    void DictionaryWriter::WriteValue(BufferWriter& writer, const ValueRef& value)
+    {
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+        case Kind::Array:
+        {
+            if (value.IsTypedArray())
+            {
+                // packed numbers only need their alignment redone
+                TypedArray a;
+                if (ReadTypedArray(value.GetData(), value.GetEnd(), a))
+                {
+                    encoder::WriteTypedArray(writer, a.type, a.data, a.count);
+                }
+                break;
+            }
+
+            bool object = value.IsObject();
+            size_t body_pos = encoder::BeginContainer(writer, object ? ValueType::Object : ValueType::Array);
+            size_t first_offset = m_offsets.size();
+
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                m_offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                if (object)
+                {
+                    this->WriteString(writer, i.Key());
+                }
+                this->WriteValue(writer, *i);
+            }
+
+            if (object)
+            {
+                encoder::EndContainer(writer, body_pos, m_offsets, first_offset);
+            }
+            else
+            {
+                encoder::EndArray(writer, body_pos, m_offsets, first_offset, m_scratch);
+            }
+            break;
+        }
+        case Kind::String:
+            this->WriteString(writer, value.AsString());
+            break;
+        default:
+        {
+            // scalars keep the exact bytes they were written with
+            int size = ScalarSize((ValueType) value.GetData()[0]);
+            writer.Write(value.GetData(), 1 + size);
+            break;
+        }
+        }
+    }
+
+    void DictionaryWriter::WriteString(BufferWriter& writer, std::string_view str)
+    {
+        auto i = m_entries.find(str);
+        if (i != m_entries.end() && i->second.index != NO_INDEX)
+        {
+            encoder::WriteStringRef(writer, i->second.index);
+        }
+        else
+        {
+            encoder::WriteString(writer, str.data(), str.size());
+        }
+    }
+}
@@ -0,0 +1,842 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/diff.h>
+#include "format.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace jsonb
+{
+    namespace
+    {
+        const int MAX_DEPTH = 1000;
+        // copies shorter than this take more bytes as an op than as a literal
+        const size_t MIN_COPY = 8;
+        const size_t DELTA_HEADER_SIZE = 40;
+        const int OP_LITERAL = 0;
+        const int OP_COPY = 1;
+        const int OP_SHIFT = 2;
+
+        // 64 bit hash of a byte range, 8 bytes at a time
+        uint64_t HashBytes(const uint8_t* p, size_t size)
+        {
+            const uint64_t K0 = 0x9e3779b97f4a7c15ull;
+            const uint64_t K1 = 0xbf58476d1ce4e5b9ull;
+            uint64_t h = (uint64_t) size * K0;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t v;
+                memcpy(&v, p + i, sizeof(v));
+                h ^= v * K1;
+                h = ((h << 31) | (h >> 33)) * K0;
+            }
+            uint64_t v = 0;
+            if (i < size)
+            {
+                memcpy(&v, p + i, size - i);
+            }
+            h ^= v * K1;
+            h ^= h >> 30;
+            h *= K1;
+            h ^= h >> 27;
+            h *= 0x94d049bb133111ebull;
+            h ^= h >> 31;
+            return h;
+        }
+
+        void WriteVarint(BufferWriter& writer, uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                writer.Write((uint8_t) (v | 0x80));
+                v >>= 7;
+            }
+            writer.Write((uint8_t) v);
+        }
+
+        uint64_t Zigzag(int64_t v)
+        {
+            return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+        }
+
+        uint64_t UnZigzag(uint64_t v)
+        {
+            return (v >> 1) ^ (0 - (v & 1));
+        }
+
+        bool ReadVarint(Cursor& cursor, uint64_t& v)
+        {
+            v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                uint8_t b = cursor.Read<uint8_t>();
+                if (cursor.IsFailed())
+                {
+                    return false;
+                }
+                v |= (uint64_t) (b & 0x7f) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // start of the root of a v2 buffer, behind its header and dictionary, nullptr for anything else
+        const uint8_t* FindRoot(const uint8_t* p, size_t size)
+        {
+            Header header = ReadHeader(p, size);
+            if (header.version != FORMAT_VERSION || size == HEADER_SIZE)
+            {
+                return nullptr;
+            }
+            if ((header.flags & FLAG_DICTIONARY) == 0)
+            {
+                return p + HEADER_SIZE;
+            }
+            if (size - HEADER_SIZE < CONTAINER_SIZE_BYTES)
+            {
+                return nullptr;
+            }
+            uint32_t section_size;
+            memcpy(&section_size, p + HEADER_SIZE, sizeof(section_size));
+            if (size - HEADER_SIZE - CONTAINER_SIZE_BYTES <= section_size)
+            {
+                return nullptr;
+            }
+            return p + HEADER_SIZE + CONTAINER_SIZE_BYTES + section_size;
+        }
+
+        // bytes of a string, inline or a dictionary reference, 0 if it is malformed
+        size_t StringSize(const uint8_t* p, const uint8_t* end)
+        {
+            ValueType type = (ValueType) *p;
+            if (IsStringRef(type))
+            {
+                size_t size = 1 + ScalarSize(type);
+                return size <= (size_t) (end - p) ? size : 0;
+            }
+            if (type != ValueType::String || end - p < 2)
+            {
+                return 0;
+            }
+            ValueType length_type = (ValueType) p[1];
+            if (length_type < ValueType::Uint8 || length_type > ValueType::Int64)
+            {
+                return 0;
+            }
+            size_t bytes = ScalarSize(length_type);
+            if ((size_t) (end - p - 2) < bytes)
+            {
+                return 0;
+            }
+            uint64_t length = 0;
+            memcpy(&length, p + 2, bytes);
+            if (length > (uint64_t) (end - p - 2) - bytes)
+            {
+                return 0;
+            }
+            return 2 + bytes + (size_t) length;
+        }
+
+        uint64_t Mix(uint64_t h, uint64_t v)
+        {
+            h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+            return h ^ (h >> 32);
+        }
+
+        // walks the value at p in the order it is laid out, passing its typed arrays to on_array and
+        // every other byte to on_bytes. returns its end, nullptr if it is malformed
+        template <class Bytes, class Array>
+        const uint8_t* WalkValue(const uint8_t* p, const uint8_t* end, int depth, Bytes& on_bytes, Array& on_array)
+        {
+            if (p >= end || depth > MAX_DEPTH)
+            {
+                return nullptr;
+            }
+            ValueType type = (ValueType) *p;
+            if (type == ValueType::TypedArray)
+            {
+                TypedArray a;
+                if (!ReadTypedArray(p, end, a))
+                {
+                    return nullptr;
+                }
+                on_array(p, a);
+                return a.end;
+            }
+            if (type != ValueType::Object && type != ValueType::Array)
+            {
+                size_t size = 0;
+                if (type == ValueType::String || IsStringRef(type))
+                {
+                    size = StringSize(p, end);
+                }
+                else if (type == ValueType::Block)
+                {
+                    // a block is decompressed at its own phase, it does not depend on where it is
+                    Block block;
+                    size = ReadBlock(p, end, block) ? block.end - p : 0;
+                }
+                else if (ScalarSize(type) >= 0 && end - p > ScalarSize(type))
+                {
+                    size = 1 + ScalarSize(type);
+                }
+                if (size == 0)
+                {
+                    return nullptr;
+                }
+                on_bytes(p, size);
+                return p + size;
+            }
+
+            Container c;
+            if (!ReadContainer(p, end, c))
+            {
+                return nullptr;
+            }
+            on_bytes(p, c.body - p);
+            const uint8_t* pos = c.body;
+            while (pos < c.table)
+            {
+                if (type == ValueType::Object)
+                {
+                    size_t key = StringSize(pos, c.table);
+                    if (key == 0)
+                    {
+                        return nullptr;
+                    }
+                    on_bytes(pos, key);
+                    pos += key;
+                }
+                pos = WalkValue(pos, c.table, depth + 1, on_bytes, on_array);
+                if (pos == nullptr)
+                {
+                    return nullptr;
+                }
+            }
+            on_bytes(c.table, c.end - c.table);
+            return c.end;
+        }
+
+        // hash of the value at p that leaves out the padding of its typed arrays,
+        // the same wherever it is aligned. falls back to the bytes if it is malformed
+        uint64_t HashValue(const uint8_t* p, const uint8_t* end)
+        {
+            // the bytes between typed arrays are hashed in runs
+            uint64_t h = 0;
+            const uint8_t* run = p;
+            const uint8_t* run_end = p;
+            auto on_bytes = [&](const uint8_t* bytes, size_t size) {
+                if (bytes != run_end)
+                {
+                    h = Mix(h, HashBytes(run, run_end - run));
+                    run = bytes;
+                }
+                run_end = bytes + size;
+            };
+            auto on_array = [&](const uint8_t* array, const TypedArray& a) {
+                h = Mix(h, HashBytes(run, run_end - run));
+                h = Mix(h, (uint64_t) array[1] << 8 | (array[2] & 0xf));
+                h = Mix(h, HashBytes(a.data, a.count * a.size));
+                run = a.end;
+                run_end = a.end;
+            };
+            if (WalkValue(p, end, 0, on_bytes, on_array) != end)
+            {
+                return HashBytes(p, end - p);
+            }
+            return Mix(h, HashBytes(run, run_end - run));
+        }
+
+        // aligns the typed arrays under the value at pos again after it was moved, like
+        // encoder::AlignTypedArrays but on bytes that are not known to be well formed
+        bool AlignValue(uint8_t* begin, size_t pos, size_t end)
+        {
+            auto on_bytes = [](const uint8_t*, size_t) { };
+            auto on_array = [&](const uint8_t* array, const TypedArray& a) {
+                uint8_t* p = begin + (array - begin);
+                int width = p[2] & 0xf;
+                int pad = p[2] >> 4;
+                uint8_t* slot = p + 3 + width;
+                int aligned = (int) ((a.size - (size_t) (slot - begin) % a.size) % a.size);
+                if (aligned != pad)
+                {
+                    memmove(slot + aligned, slot + pad, a.count * a.size);
+                    memset(slot, 0, aligned);
+                    memset(slot + aligned + a.count * a.size, 0, a.size - 1 - aligned);
+                    p[2] = (uint8_t) (aligned << 4 | width);
+                }
+            };
+            return WalkValue(begin + pos, begin + end, 0, on_bytes, on_array) == begin + end;
+        }
+    }
+
+    Differ::Differ():
+        m_base(nullptr),
+        m_target(nullptr),
+        m_delta(nullptr),
+        m_target_pos(0),
+        m_literal(0),
+        m_copy_base(0),
+        m_copy_size(0),
+        m_last_copy(0),
+        m_align(false)
+    {
+    }
+
+    void Differ::Diff(const void* base, size_t base_size, const void* target, size_t target_size, BufferWriter& delta)
+    {
+        m_base = (const uint8_t*) base;
+        m_target = (const uint8_t*) target;
+        m_delta = &delta;
+        m_target_pos = 0;
+        m_literal = 0;
+        m_copy_base = 0;
+        m_copy_size = 0;
+        m_last_copy = 0;
+        m_align = false;
+        m_children.clear();
+
+        delta.Clear();
+        delta.Write(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+        delta.Write(DELTA_VERSION);
+        delta.Write((uint8_t) 0);
+        delta.Write((uint16_t) 0);
+        delta.Write((uint64_t) base_size);
+        delta.Write(HashBytes(m_base, base_size));
+        delta.Write((uint64_t) target_size);
+        delta.Write(HashBytes(m_target, target_size));
+
+        // string references only mean the same in both with the same dictionary
+        const uint8_t* b_root = m_base ? FindRoot(m_base, base_size) : nullptr;
+        const uint8_t* t_root = m_target ? FindRoot(m_target, target_size) : nullptr;
+        size_t root = t_root ? t_root - m_target : 0;
+        if (b_root && t_root && (size_t) (b_root - m_base) == root &&
+            (m_base[5] & FLAG_DICTIONARY) == (m_target[5] & FLAG_DICTIONARY) &&
+            memcmp(m_base + HEADER_SIZE, m_target + HEADER_SIZE, root - HEADER_SIZE) == 0)
+        {
+            this->DiffBytes(m_base, root, m_target, root);
+            this->DiffValue(b_root, m_base + base_size, t_root, m_target + target_size, 0);
+        }
+        else
+        {
+            this->Literal(target_size);
+        }
+        this->FlushCopy();
+        this->WriteLiteral(m_target_pos);
+        delta.Patch(5, (uint8_t) (m_align ? DELTA_FLAG_ALIGN : 0));
+    }
+
+    Status Differ::Apply(const void* base, size_t base_size, const void* delta, size_t delta_size, BufferWriter& target)
+    {
+        target.Clear();
+        Cursor cursor(delta, delta_size);
+        if (delta == nullptr || delta_size < DELTA_HEADER_SIZE)
+        {
+            return Status(Error::Truncated, 0);
+        }
+        const uint8_t* magic = cursor.ReadBytes(sizeof(DELTA_MAGIC));
+        uint8_t version = cursor.Read<uint8_t>();
+        uint8_t flags = cursor.Read<uint8_t>();
+        cursor.Read<uint16_t>();
+        if (memcmp(magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0 || version != DELTA_VERSION || (flags & ~DELTA_FLAG_ALIGN) != 0)
+        {
+            return Status(Error::BadHeader, 0);
+        }
+        uint64_t expected_base_size = cursor.Read<uint64_t>();
+        uint64_t base_hash = cursor.Read<uint64_t>();
+        uint64_t target_size = cursor.Read<uint64_t>();
+        uint64_t target_hash = cursor.Read<uint64_t>();
+        const uint8_t* b = (const uint8_t*) base;
+        if (expected_base_size != base_size || (base_size > 0 && b == nullptr) || HashBytes(b, base_size) != base_hash)
+        {
+            return Status(Error::BaseMismatch, 0);
+        }
+
+        // the sizes are not trusted for more than the bytes a delta can take to write them
+        target.Reserve((size_t) std::min<uint64_t>(target_size, (uint64_t) base_size + delta_size));
+        uint64_t last_copy = 0;
+        while (cursor.GetRemaining() > 0)
+        {
+            size_t offset = cursor.GetOffset();
+            uint64_t op;
+            if (!ReadVarint(cursor, op))
+            {
+                return Status(Error::Truncated, offset);
+            }
+            int kind = (int) (op & 3);
+            int width = kind == OP_SHIFT ? (int) (op >> 2 & 7) : 1;
+            uint64_t size = kind == OP_SHIFT ? (op >> 5) * width : op >> 2;
+            if (kind > OP_SHIFT || (width != 1 && width != 2 && width != 4) || size > target_size - target.GetSize())
+            {
+                return Status(Error::BadLayout, offset);
+            }
+            if (kind == OP_LITERAL)
+            {
+                const uint8_t* bytes = cursor.ReadBytes((size_t) size);
+                if (bytes == nullptr)
+                {
+                    return Status(Error::Truncated, offset);
+                }
+                target.Write(bytes, (size_t) size);
+                continue;
+            }
+
+            uint64_t from;
+            uint64_t shift = 0;
+            if (!ReadVarint(cursor, from) || (kind == OP_SHIFT && !ReadVarint(cursor, shift)))
+            {
+                return Status(Error::Truncated, offset);
+            }
+            from = last_copy + UnZigzag(from);
+            if (from > base_size || size > base_size - from)
+            {
+                return Status(Error::BadLayout, offset);
+            }
+            if (kind == OP_COPY)
+            {
+                target.Write(b + from, (size_t) size);
+            }
+            else
+            {
+                uint32_t add = (uint32_t) UnZigzag(shift);
+                size_t pos = target.Skip((size_t) size);
+                uint8_t* out = target.GetData() + pos;
+                for (size_t i = 0; i < size; i += width)
+                {
+                    uint32_t v = LoadOffset(b + from + i, width) + add;
+                    memcpy(out + i, &v, width);
+                }
+            }
+            last_copy = from + size;
+        }
+        if (target.GetSize() != target_size)
+        {
+            return Status(Error::Truncated, delta_size);
+        }
+        const uint8_t* root = (flags & DELTA_FLAG_ALIGN) ? FindRoot(target.GetData(), target.GetSize()) : nullptr;
+        if ((flags & DELTA_FLAG_ALIGN) && (root == nullptr || !AlignValue(target.GetData(), root - target.GetData(), target.GetSize())))
+        {
+            return Status(Error::BadChecksum, 0);
+        }
+        if (HashBytes(target.GetData(), target.GetSize()) != target_hash)
+        {
+            return Status(Error::BadChecksum, 0);
+        }
+        return Status();
+    }
+
+    void Differ::DiffValue(const uint8_t* b, const uint8_t* b_end, const uint8_t* t, const uint8_t* t_end, int depth)
+    {
+        size_t b_size = b_end - b;
+        size_t t_size = t_end - t;
+        if (b_size == t_size && memcmp(b, t, t_size) == 0)
+        {
+            this->Copy(b, t_size);
+            return;
+        }
+        if (b_size == t_size && (b - m_base) % 8 != (t - m_target) % 8 && this->IsMoved(b, t, t_size))
+        {
+            this->Copy(b, t_size);
+            m_align = true;
+            return;
+        }
+        if (depth < MAX_DEPTH && b_size > 0 && t_size > 0 && *b == *t)
+        {
+            ValueType type = (ValueType) *t;
+            if ((type == ValueType::Object || type == ValueType::Array) && this->DiffContainer(b, b_end, t, t_end, depth))
+            {
+                return;
+            }
+            TypedArray b_array;
+            TypedArray t_array;
+            if (type == ValueType::TypedArray && ReadTypedArray(b, b_end, b_array) && ReadTypedArray(t, t_end, t_array) &&
+                b_array.type == t_array.type && t_array.end == t_end)
+            {
+                // the padding differs when the two are aligned differently, the elements are compared alone
+                size_t t_elements = t_array.count * t_array.size;
+                this->Literal(t_array.data - t);
+                this->DiffBytes(b_array.data, b_array.count * b_array.size, t_array.data, t_elements);
+                this->Literal(t_end - t_array.data - t_elements);
+                return;
+            }
+        }
+        this->DiffBytes(b, b_size, t, t_size);
+    }
+
+    bool Differ::DiffContainer(const uint8_t* b, const uint8_t* b_end, const uint8_t* t, const uint8_t* t_end, int depth)
+    {
+        Container bc;
+        Container tc;
+        if (!ReadContainer(b, b_end, bc) || !ReadContainer(t, t_end, tc) || bc.end != b_end || tc.end != t_end)
+        {
+            return false;
+        }
+        bool object = (ValueType) *t == ValueType::Object;
+        size_t base_first = m_children.size();
+        size_t target_first = base_first + bc.count;
+        if (!this->ReadChildren(bc.body, bc.table, bc.width, bc.count, object) ||
+            !this->ReadChildren(tc.body, tc.table, tc.width, tc.count, object))
+        {
+            m_children.resize(base_first);
+            return false;
+        }
+
+        if (object)
+        {
+            // the key bytes are the same for the same key, both use one dictionary or none
+            m_keys.clear();
+            for (size_t i = 0; i < bc.count; ++i)
+            {
+                const Child& c = m_children[base_first + i];
+                m_keys.emplace(std::string_view((const char*) bc.body + c.start, c.key), (uint32_t) i);
+            }
+            for (size_t i = 0; i < tc.count; ++i)
+            {
+                Child& c = m_children[target_first + i];
+                auto found = m_keys.find(std::string_view((const char*) tc.body + c.start, c.key));
+                if (found != m_keys.end())
+                {
+                    const Child& base_child = m_children[base_first + found->second];
+                    c.match = found->second;
+                    c.same = base_child.end - base_child.start == c.end - c.start &&
+                        memcmp(bc.body + base_child.start, tc.body + c.start, c.end - c.start) == 0;
+                }
+            }
+        }
+        else
+        {
+            this->MatchElements(bc.body, base_first, bc.count, tc.body, target_first, tc.count);
+        }
+
+        // the target is written in the order its children are laid out
+        std::sort(m_children.begin() + target_first, m_children.end(), [](const Child& x, const Child& y) {
+            return x.start < y.start;
+        });
+        this->DiffBytes(b, bc.body - b, t, tc.body - t);
+        size_t covered = 0;
+        for (size_t i = 0; i < tc.count; ++i)
+        {
+            // recursing appends to m_children, the child is copied out first
+            Child c = m_children[target_first + i];
+            this->Literal(c.start - covered);
+            covered = c.end;
+            if (c.match < 0)
+            {
+                this->Literal(c.end - c.start);
+                continue;
+            }
+            const Child& base_child = m_children[base_first + (size_t) c.match];
+            const uint8_t* base_start = bc.body + base_child.start;
+            const uint8_t* base_end = bc.body + base_child.end;
+            if (c.same)
+            {
+                this->Copy(base_start, c.end - c.start);
+                continue;
+            }
+            this->Copy(base_start, c.key);
+            this->DiffValue(base_start + c.key, base_end, tc.body + c.start + c.key, tc.body + c.end, depth + 1);
+        }
+        this->Literal((tc.table - tc.body) - covered);
+
+        if (bc.width == tc.width)
+        {
+            std::sort(m_children.begin() + target_first, m_children.end(), [](const Child& x, const Child& y) {
+                return x.index < y.index;
+            });
+            this->DiffTable(bc.table, base_first, target_first, tc.count, tc.width);
+            size_t trailer = tc.end - tc.table - tc.count * tc.width;
+            this->DiffBytes(bc.end - trailer, trailer, tc.end - trailer, trailer);
+        }
+        else
+        {
+            this->DiffBytes(bc.table, bc.end - bc.table, tc.table, tc.end - tc.table);
+        }
+        m_children.resize(base_first);
+        return true;
+    }
+
+    void Differ::MatchElements(const uint8_t* b_body, size_t base_first, size_t b_count, const uint8_t* t_body, size_t target_first, size_t t_count)
+    {
+        auto same = [&](const Child& base_child, const Child& target_child) {
+            size_t size = target_child.end - target_child.start;
+            return base_child.end - base_child.start == size &&
+                memcmp(b_body + base_child.start, t_body + target_child.start, size) == 0;
+        };
+        // an element edited in place leaves the others where they were
+        if (b_count == t_count)
+        {
+            size_t changed = 0;
+            for (size_t i = 0; i < t_count; ++i)
+            {
+                Child& c = m_children[target_first + i];
+                c.match = (int64_t) i;
+                c.same = same(m_children[base_first + i], c);
+                changed += c.same ? 0 : 1;
+            }
+            if (changed <= 1)
+            {
+                return;
+            }
+            for (size_t i = 0; i < t_count; ++i)
+            {
+                m_children[target_first + i].match = -1;
+                m_children[target_first + i].same = false;
+            }
+        }
+
+        // elements were inserted, removed or moved. the ones that are the same somewhere in the base are
+        // found by a hash that leaves out the padding of typed arrays, which moves with everything
+        // after the edit. the others are diffed with the base elements between the same neighbours
+        m_hashes.clear();
+        for (size_t i = 0; i < b_count; ++i)
+        {
+            const Child& c = m_children[base_first + i];
+            m_hashes.emplace(HashValue(b_body + c.start, b_body + c.end), (uint32_t) i);
+        }
+        for (size_t i = 0; i < t_count; ++i)
+        {
+            Child& c = m_children[target_first + i];
+            auto found = m_hashes.find(HashValue(t_body + c.start, t_body + c.end));
+            if (found != m_hashes.end())
+            {
+                c.match = found->second;
+                c.same = same(m_children[base_first + found->second], c);
+            }
+        }
+
+        auto size = [](const Child& c) {
+            return (int64_t) (c.end - c.start);
+        };
+        size_t lower = 0;
+        size_t i = 0;
+        while (i < t_count)
+        {
+            if (m_children[target_first + i].match >= 0)
+            {
+                lower = (size_t) m_children[target_first + i].match + 1;
+                ++i;
+                continue;
+            }
+            size_t gap_end = i;
+            while (gap_end < t_count && m_children[target_first + gap_end].match < 0)
+            {
+                ++gap_end;
+            }
+            size_t upper = gap_end < t_count ? (size_t) m_children[target_first + gap_end].match : b_count;
+            if (upper > lower)
+            {
+                // pairs the gap from its front or its back, whichever is closer in size
+                size_t n = std::min(upper - lower, gap_end - i);
+                int64_t front = 0;
+                int64_t back = 0;
+                for (size_t k = 0; k < n; ++k)
+                {
+                    front += std::abs(size(m_children[target_first + i + k]) - size(m_children[base_first + lower + k]));
+                    back += std::abs(size(m_children[target_first + gap_end - n + k]) - size(m_children[base_first + upper - n + k]));
+                }
+                size_t t_start = back < front ? gap_end - n : i;
+                size_t b_start = back < front ? upper - n : lower;
+                for (size_t k = 0; k < n; ++k)
+                {
+                    m_children[target_first + t_start + k].match = (int64_t) (b_start + k);
+                }
+            }
+            i = gap_end;
+        }
+    }
+
+    void Differ::DiffTable(const uint8_t* b_table, size_t base_first, size_t target_first, size_t count, int width)
+    {
+        // runs of entries whose children kept their order in the base and moved by as many bytes
+        size_t i = 0;
+        while (i < count)
+        {
+            const Child& c = m_children[target_first + i];
+            if (c.match < 0)
+            {
+                this->Literal(width);
+                ++i;
+                continue;
+            }
+            int64_t shift = (int64_t) c.start - m_children[base_first + (size_t) c.match].start;
+            size_t run = 1;
+            while (i + run < count)
+            {
+                const Child& next = m_children[target_first + i + run];
+                if (next.match != c.match + (int64_t) run ||
+                    (int64_t) next.start - m_children[base_first + (size_t) next.match].start != shift)
+                {
+                    break;
+                }
+                ++run;
+            }
+            const uint8_t* base = b_table + (size_t) c.match * width;
+            if (shift == 0)
+            {
+                this->Copy(base, run * width);
+            }
+            else if (run * width >= MIN_COPY)
+            {
+                this->Shift(base, run, width, shift);
+            }
+            else
+            {
+                this->Literal(run * width);
+            }
+            i += run;
+        }
+    }
+
+    bool Differ::IsMoved(const uint8_t* b, const uint8_t* t, size_t size)
+    {
+        // the base bytes at the target's phase, aligned again
+        size_t phase = (t - m_target) % 8;
+        m_scratch.Clear();
+        m_scratch.Skip(phase);
+        m_scratch.Write(b, size);
+        return AlignValue(m_scratch.GetData(), phase, phase + size) && memcmp(m_scratch.GetData() + phase, t, size) == 0;
+    }
+
+    void Differ::DiffBytes(const uint8_t* b, size_t b_size, const uint8_t* t, size_t t_size)
+    {
+        size_t size = std::min(b_size, t_size);
+        size_t prefix = std::mismatch(t, t + size, b).first - t;
+        size_t suffix = 0;
+        while (suffix < size - prefix && b[b_size - 1 - suffix] == t[t_size - 1 - suffix])
+        {
+            ++suffix;
+        }
+        this->Copy(b, prefix);
+        this->Literal(t_size - prefix - suffix);
+        this->Copy(b + b_size - suffix, suffix);
+    }
+
+    bool Differ::ReadChildren(const uint8_t* body, const uint8_t* table, int width, size_t count, bool object)
+    {
+        size_t first = m_children.size();
+        size_t body_size = table - body;
+        m_sorted.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t start = LoadOffset(table + i * width, width);
+            if (start >= body_size)
+            {
+                return false;
+            }
+            m_children.push_back({ start, 0, (uint32_t) i, 0, -1, false });
+            m_sorted.push_back(start);
+        }
+        std::sort(m_sorted.begin(), m_sorted.end());
+        if (std::adjacent_find(m_sorted.begin(), m_sorted.end()) != m_sorted.end())
+        {
+            return false;
+        }
+        // a child runs up to the next one laid out after it
+        for (size_t i = first; i < m_children.size(); ++i)
+        {
+            Child& c = m_children[i];
+            auto next = std::upper_bound(m_sorted.begin(), m_sorted.end(), c.start);
+            c.end = next == m_sorted.end() ? (uint32_t) body_size : *next;
+            if (object)
+            {
+                c.key = (uint32_t) StringSize(body + c.start, body + c.end);
+                if (c.key == 0 || c.key == c.end - c.start)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void Differ::Copy(const uint8_t* base, size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        size_t pos = base - m_base;
+        if (m_copy_size > 0 && m_copy_base + m_copy_size == pos)
+        {
+            m_copy_size += size;
+        }
+        else
+        {
+            this->FlushCopy();
+            m_copy_base = pos;
+            m_copy_size = size;
+        }
+        m_target_pos += size;
+    }
+
+    void Differ::Shift(const uint8_t* base, size_t count, int width, int64_t shift)
+    {
+        this->FlushCopy();
+        this->WriteLiteral(m_target_pos);
+        WriteVarint(*m_delta, (uint64_t) count << 5 | (uint64_t) width << 2 | OP_SHIFT);
+        this->WriteBaseOffset(base - m_base, count * width);
+        WriteVarint(*m_delta, Zigzag(shift));
+        m_target_pos += count * width;
+        m_literal = m_target_pos;
+    }
+
+    void Differ::Literal(size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+        this->FlushCopy();
+        m_target_pos += size;
+    }
+
+    void Differ::FlushCopy()
+    {
+        // a short copy is left to the literal bytes in front of it
+        if (m_copy_size >= MIN_COPY)
+        {
+            this->WriteLiteral(m_target_pos - m_copy_size);
+            WriteVarint(*m_delta, (uint64_t) m_copy_size << 2 | OP_COPY);
+            this->WriteBaseOffset(m_copy_base, m_copy_size);
+            m_literal = m_target_pos;
+        }
+        m_copy_size = 0;
+    }
+
+    void Differ::WriteLiteral(size_t end)
+    {
+        if (end > m_literal)
+        {
+            WriteVarint(*m_delta, (uint64_t) (end - m_literal) << 2 | OP_LITERAL);
+            m_delta->Write(m_target + m_literal, end - m_literal);
+        }
+        m_literal = end;
+    }
+
+    void Differ::WriteBaseOffset(size_t offset, size_t size)
+    {
+        WriteVarint(*m_delta, Zigzag((int64_t) offset - (int64_t) m_last_copy));
+        m_last_copy = offset + size;
+    }
+}
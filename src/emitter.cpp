@@ -0,0 +1,300 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/emitter.h>
+#include "format.h"
+#include <charconv>
+#include <cmath>
+
+namespace jsonb
+{
+    namespace
+    {
+        const size_t MAX_DEPTH = 1000;
+        const size_t FILE_BUFFER_SIZE = 64 * 1024;
+
+        // characters that need an escape inside a JSON string
+        struct EscapeTable
+        {
+            bool escape[256];
+
+            EscapeTable()
+            {
+                for (int i = 0; i < 256; ++i)
+                {
+                    escape[i] = i < 0x20 || i == '"' || i == '\\';
+                }
+            }
+        };
+        const EscapeTable ESCAPE_TABLE;
+
+        template <class T>
+        void WriteNumber(BufferWriter& writer, T t)
+        {
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), t);
+            writer.Write(buffer, result.ptr - buffer);
+        }
+
+        template <class T>
+        void WriteReal(BufferWriter& writer, T t)
+        {
+            if (!std::isfinite(t))
+            {
+                writer.Write("null", 4);
+                return;
+            }
+
+            char buffer[64];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), t);
+            size_t size = result.ptr - buffer;
+
+            // keep integral reals reading back as reals
+            bool integral = true;
+            for (size_t i = 0; i < size && integral; ++i)
+            {
+                integral = buffer[i] != '.' && buffer[i] != 'e';
+            }
+            writer.Write(buffer, size);
+            if (integral)
+            {
+                writer.Write(".0", 2);
+            }
+        }
+    }
+
+    JsonEmitter::JsonEmitter():
+        m_pretty(false),
+        m_float_text(false),
+        m_indent("\t"),
+        m_writer(nullptr),
+        m_file(nullptr)
+    {
+
+    }
+
+    bool JsonEmitter::Emit(const View& view, BufferWriter& writer)
+    {
+        m_writer = &writer;
+        m_file = nullptr;
+        m_float_text = view.GetVersion() < 2;
+
+        ValueRef root = view.Root();
+        bool result = root.IsValid() && this->EmitValue(root, 0);
+        if (result && m_pretty)
+        {
+            writer.Write((uint8_t) '\n');
+        }
+
+        m_writer = nullptr;
+        return result;
+    }
+
+    bool JsonEmitter::Emit(const View& view, FILE* file)
+    {
+        m_file_buffer.Clear();
+        m_file_buffer.Reserve(FILE_BUFFER_SIZE + 4096);
+        m_writer = &m_file_buffer;
+        m_file = file;
+        m_float_text = view.GetVersion() < 2;
+
+        ValueRef root = view.Root();
+        bool result = root.IsValid() && this->EmitValue(root, 0);
+        if (result && m_pretty)
+        {
+            m_file_buffer.Write((uint8_t) '\n');
+        }
+        this->Flush();
+
+        m_writer = nullptr;
+        m_file = nullptr;
+        return result && !ferror(file);
+    }
+
+    bool JsonEmitter::EmitValue(const ValueRef& value, int depth)
+    {
+        // the view reads unknown tags as numbers, here they mean a malformed buffer
+        if (depth > (int) MAX_DEPTH || value.GetTag() > (uint8_t) ValueType::Decimal)
+        {
+            return false;
+        }
+
+        BufferWriter& writer = *m_writer;
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+        case Kind::Array:
+        {
+            bool object = value.IsObject();
+            writer.Write((uint8_t) (object ? '{' : '['));
+
+            size_t count = 0;
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                if (count++ > 0)
+                {
+                    writer.Write((uint8_t) ',');
+                }
+                this->EmitNewline(depth + 1);
+
+                if (object)
+                {
+                    this->EmitString(i.Key());
+                    writer.Write(m_pretty ? ": " : ":", m_pretty ? 2 : 1);
+                }
+
+                ValueRef child = *i;
+                if (!child.IsValid() || !this->EmitValue(child, depth + 1))
+                {
+                    return false;
+                }
+            }
+            if (count != value.Size())
+            {
+                return false;
+            }
+
+            if (count > 0)
+            {
+                this->EmitNewline(depth);
+            }
+            writer.Write((uint8_t) (object ? '}' : ']'));
+            break;
+        }
+        case Kind::String:
+            this->EmitString(value.AsString());
+            break;
+        case Kind::Int:
+            WriteNumber(writer, value.AsInt64());
+            break;
+        case Kind::Uint:
+            WriteNumber(writer, value.AsUint64());
+            break;
+        case Kind::Real:
+            if (m_float_text && (ValueType) value.GetTag() == ValueType::Float)
+            {
+                WriteReal(writer, (float) value.AsDouble());
+            }
+            else
+            {
+                WriteReal(writer, value.AsDouble());
+            }
+            break;
+        case Kind::Bool:
+            if (value.AsBool())
+            {
+                writer.Write("true", 4);
+            }
+            else
+            {
+                writer.Write("false", 5);
+            }
+            break;
+        case Kind::Null:
+            writer.Write("null", 4);
+            break;
+        }
+
+        if (m_file && writer.GetSize() >= FILE_BUFFER_SIZE)
+        {
+            this->Flush();
+        }
+        return true;
+    }
+
+    void JsonEmitter::EmitString(std::string_view str)
+    {
+        BufferWriter& writer = *m_writer;
+        writer.Write((uint8_t) '"');
+
+        const char* p = str.data();
+        const char* end = p + str.size();
+        while (p < end)
+        {
+            // copy the run that needs no escaping in one go
+            const char* run = p;
+            while (p < end && !ESCAPE_TABLE.escape[(uint8_t) *p])
+            {
+                ++p;
+            }
+            writer.Write(run, p - run);
+            if (p == end)
+            {
+                break;
+            }
+
+            char c = *p++;
+            switch (c)
+            {
+            case '"':
+                writer.Write("\\\"", 2);
+                break;
+            case '\\':
+                writer.Write("\\\\", 2);
+                break;
+            case '\b':
+                writer.Write("\\b", 2);
+                break;
+            case '\f':
+                writer.Write("\\f", 2);
+                break;
+            case '\n':
+                writer.Write("\\n", 2);
+                break;
+            case '\r':
+                writer.Write("\\r", 2);
+                break;
+            case '\t':
+                writer.Write("\\t", 2);
+                break;
+            default:
+            {
+                static const char HEX[] = "0123456789abcdef";
+                char escape[6] = { '\\', 'u', '0', '0', HEX[(c >> 4) & 0xf], HEX[c & 0xf] };
+                writer.Write(escape, sizeof(escape));
+                break;
+            }
+            }
+        }
+
+        writer.Write((uint8_t) '"');
+    }
+
+    void JsonEmitter::EmitNewline(int depth)
+    {
+        if (!m_pretty)
+        {
+            return;
+        }
+
+        BufferWriter& writer = *m_writer;
+        writer.Write((uint8_t) '\n');
+        for (int i = 0; i < depth; ++i)
+        {
+            writer.Write(m_indent.c_str(), m_indent.size());
+        }
+    }
+
+    void JsonEmitter::Flush()
+    {
+        if (m_file && m_file_buffer.GetSize() > 0)
+        {
+            fwrite(m_file_buffer.GetData(), 1, m_file_buffer.GetSize(), m_file);
+            m_file_buffer.Clear();
+        }
+    }
+}
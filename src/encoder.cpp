@@ -0,0 +1,481 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "encoder.h"
+#include <algorithm>
+#include <cmath>
+
+namespace jsonb
+{
+    namespace encoder
+    {
+        namespace
+        {
+            bool IsSmallInt(ValueType type)
+            {
+                return type == ValueType::Uint8 || type == ValueType::Int8 || type == ValueType::Uint16 ||
+                    type == ValueType::Int16 || type == ValueType::Int32;
+            }
+
+            // value of a scalar written by WriteInt64 that fits in 32 bits
+            int64_t LoadInt(const uint8_t* p)
+            {
+                switch ((ValueType) p[0])
+                {
+                case ValueType::Uint8:
+                    return p[1];
+                case ValueType::Int8:
+                    return (int8_t) p[1];
+                case ValueType::Uint16:
+                {
+                    uint16_t v;
+                    memcpy(&v, p + 1, sizeof(v));
+                    return v;
+                }
+                case ValueType::Int16:
+                {
+                    int16_t v;
+                    memcpy(&v, p + 1, sizeof(v));
+                    return v;
+                }
+                default:
+                {
+                    int32_t v;
+                    memcpy(&v, p + 1, sizeof(v));
+                    return v;
+                }
+                }
+            }
+
+            double LoadReal(const uint8_t* p)
+            {
+                switch ((ValueType) p[0])
+                {
+                case ValueType::Float:
+                {
+                    float f;
+                    memcpy(&f, p + 1, sizeof(f));
+                    return f;
+                }
+                case ValueType::Decimal:
+                    return LoadDecimal(p + 1);
+                default:
+                {
+                    double d;
+                    memcpy(&d, p + 1, sizeof(d));
+                    return d;
+                }
+                }
+            }
+
+            // d as mantissa / 10^scale with an int32 mantissa and the smallest scale that reads back exactly.
+            // the mantissa of the shortest decimal text of d is found by rounding d * 10^scale
+            bool ToDecimal(double d, int32_t& mantissa, uint8_t& scale)
+            {
+                for (int s = 0; s <= MAX_DECIMAL_SCALE; ++s)
+                {
+                    double scaled = d * POW10[s];
+                    if (!(std::fabs(scaled) <= (double) INT32_MAX))
+                    {
+                        return false;
+                    }
+
+                    int32_t m = (int32_t) std::lrint(scaled);
+                    if ((double) m / POW10[s] == d)
+                    {
+                        mantissa = m;
+                        scale = (uint8_t) s;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // element type able to hold every child of an array without changing how it reads back,
+            // Null if some child is not a number. ints written with different widths share the
+            // smallest type that holds them all, reals that are not all floats share Double,
+            // anything else has to be one type already
+            ValueType PackedType(const uint8_t* body, const uint32_t* offsets, size_t count)
+            {
+                ValueType first = (ValueType) body[offsets[0]];
+                if (!IsTypedArrayElement(first) && first != ValueType::Decimal)
+                {
+                    return ValueType::Null;
+                }
+
+                bool same = true;
+                bool small = true;
+                bool real = true;
+                int64_t min = 0;
+                int64_t max = 0;
+                for (size_t i = 0; i < count && (same || small || real); ++i)
+                {
+                    const uint8_t* child = body + offsets[i];
+                    ValueType type = (ValueType) child[0];
+                    same = same && type == first;
+                    real = real && IsReal(type);
+                    small = small && IsSmallInt(type);
+                    if (small)
+                    {
+                        int64_t value = LoadInt(child);
+                        min = i == 0 || value < min ? value : min;
+                        max = i == 0 || value > max ? value : max;
+                    }
+                }
+
+                if (small)
+                {
+                    if (min >= -128 && max <= 127)
+                    {
+                        return ValueType::Int8;
+                    }
+                    if (min >= 0 && max <= 255)
+                    {
+                        return ValueType::Uint8;
+                    }
+                    if (min >= -32768 && max <= 32767)
+                    {
+                        return ValueType::Int16;
+                    }
+                    if (min >= 0 && max <= 65535)
+                    {
+                        return ValueType::Uint16;
+                    }
+                    return ValueType::Int32;
+                }
+                if (same && first != ValueType::Decimal)
+                {
+                    return first;
+                }
+                return real ? ValueType::Double : ValueType::Null;
+            }
+        }
+
+        void WriteHeader(BufferWriter& writer, uint8_t flags)
+        {
+            uint8_t header[HEADER_SIZE] = { 0 };
+            memcpy(header, FORMAT_MAGIC, sizeof(FORMAT_MAGIC));
+            header[4] = FORMAT_VERSION;
+            header[5] = flags;
+            writer.Write(header, sizeof(header));
+        }
+
+        void WriteInt64(BufferWriter& writer, int64_t i)
+        {
+            if (i >= INT32_MIN && i <= INT32_MAX)
+            {
+                if (i >= -32768 && i <= 32767)
+                {
+                    if (i >= -128 && i <= 127)
+                    {
+                        writer.Write((uint8_t) ValueType::Int8);
+                        writer.Write((int8_t) i);
+                    }
+                    else if (i >= 128 && i <= 255)
+                    {
+                        writer.Write((uint8_t) ValueType::Uint8);
+                        writer.Write((uint8_t) i);
+                    }
+                    else
+                    {
+                        writer.Write((uint8_t) ValueType::Int16);
+                        writer.Write((int16_t) i);
+                    }
+                }
+                else if (i >= 32768 && i <= 65535)
+                {
+                    writer.Write((uint8_t) ValueType::Uint16);
+                    writer.Write((uint16_t) i);
+                }
+                else
+                {
+                    writer.Write((uint8_t) ValueType::Int32);
+                    writer.Write((int32_t) i);
+                }
+            }
+            else if (i > INT32_MAX && i <= UINT32_MAX)
+            {
+                writer.Write((uint8_t) ValueType::Uint32);
+                writer.Write((uint32_t) i);
+            }
+            else
+            {
+                writer.Write((uint8_t) ValueType::Int64);
+                writer.Write((int64_t) i);
+            }
+        }
+
+        void WriteUint64(BufferWriter& writer, uint64_t i)
+        {
+            writer.Write((uint8_t) ValueType::Uint64);
+            writer.Write((uint64_t) i);
+        }
+
+        void WriteFloat(BufferWriter& writer, float f)
+        {
+            writer.Write((uint8_t) ValueType::Float);
+            writer.Write(f);
+        }
+
+        void WriteReal(BufferWriter& writer, double d)
+        {
+            // nan and infinities keep their meaning as floats
+            float f = (float) d;
+            if ((double) f == d || std::isnan(d))
+            {
+                WriteFloat(writer, f);
+                return;
+            }
+
+            int32_t mantissa = 0;
+            uint8_t scale = 0;
+            if (ToDecimal(d, mantissa, scale))
+            {
+                writer.Write((uint8_t) ValueType::Decimal);
+                writer.Write(scale);
+                writer.Write(mantissa);
+                return;
+            }
+
+            writer.Write((uint8_t) ValueType::Double);
+            writer.Write(d);
+        }
+
+        void WriteString(BufferWriter& writer, const char* str, size_t size)
+        {
+            writer.Write((uint8_t) ValueType::String);
+            WriteInt64(writer, (int64_t) size);
+            writer.Write(str, size);
+        }
+
+        void WriteStringRef(BufferWriter& writer, uint32_t index)
+        {
+            if (index <= 0xff)
+            {
+                writer.Write((uint8_t) ValueType::StringRef8);
+                writer.Write((uint8_t) index);
+            }
+            else if (index <= 0xffff)
+            {
+                writer.Write((uint8_t) ValueType::StringRef16);
+                writer.Write((uint16_t) index);
+            }
+            else
+            {
+                writer.Write((uint8_t) ValueType::StringRef32);
+                writer.Write(index);
+            }
+        }
+
+        void WriteBool(BufferWriter& writer, bool b)
+        {
+            writer.Write((uint8_t) ValueType::Bool);
+            writer.Write((int8_t) (b ? 1 : 0));
+        }
+
+        void WriteNull(BufferWriter& writer)
+        {
+            writer.Write((uint8_t) ValueType::Null);
+        }
+
+        size_t BeginContainer(BufferWriter& writer, ValueType type)
+        {
+            writer.Write((uint8_t) type);
+            writer.Skip(CONTAINER_SIZE_BYTES);
+            return writer.GetSize();
+        }
+
+        void EndContainer(BufferWriter& writer, size_t body_pos, std::vector<uint32_t>& offsets, size_t first_offset)
+        {
+            size_t count = offsets.size() - first_offset;
+            size_t children_size = writer.GetSize() - body_pos;
+            int width = OffsetWidth(std::max(children_size, count));
+
+            // offset table, count and width trail the children so nothing has to move
+            size_t table_pos = writer.Skip((count + 1) * width + 1);
+            uint8_t* table = writer.GetData() + table_pos;
+            for (size_t i = 0; i < count; ++i)
+            {
+                memcpy(table, &offsets[first_offset + i], width);
+                table += width;
+            }
+            memcpy(table, &count, width);
+            table[width] = (uint8_t) width;
+            offsets.resize(first_offset);
+
+            // patch the size now that the container is complete
+            writer.Patch(body_pos - CONTAINER_SIZE_BYTES, (uint32_t) (writer.GetSize() - body_pos));
+        }
+
+        void EndArray(BufferWriter& writer, size_t body_pos, std::vector<uint32_t>& offsets, size_t first_offset, BufferWriter& scratch)
+        {
+            size_t count = offsets.size() - first_offset;
+            ValueType type = count >= 2 ? PackedType(writer.GetData() + body_pos, &offsets[first_offset], count) : ValueType::Null;
+            if (type == ValueType::Null)
+            {
+                EndContainer(writer, body_pos, offsets, first_offset);
+                return;
+            }
+
+            // children are tagged scalars, the packed elements may be wider than some of them
+            const uint8_t* body = writer.GetData() + body_pos;
+            int size = ScalarSize(type);
+            scratch.Clear();
+            scratch.Reserve(count * size);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const uint8_t* child = body + offsets[first_offset + i];
+                if ((ValueType) child[0] == type)
+                {
+                    scratch.Write(child + 1, size);
+                    continue;
+                }
+                if (type == ValueType::Double)
+                {
+                    scratch.Write(LoadReal(child));
+                    continue;
+                }
+
+                int64_t value = LoadInt(child);
+                switch (type)
+                {
+                case ValueType::Uint8:
+                    scratch.Write((uint8_t) value);
+                    break;
+                case ValueType::Int8:
+                    scratch.Write((int8_t) value);
+                    break;
+                case ValueType::Uint16:
+                    scratch.Write((uint16_t) value);
+                    break;
+                case ValueType::Int16:
+                    scratch.Write((int16_t) value);
+                    break;
+                default:
+                    scratch.Write((int32_t) value);
+                    break;
+                }
+            }
+
+            offsets.resize(first_offset);
+            writer.Truncate(body_pos - 1 - CONTAINER_SIZE_BYTES);
+            WriteTypedArray(writer, type, scratch.GetData(), count);
+        }
+
+        void WriteTypedArray(BufferWriter& writer, ValueType type, const void* data, size_t count)
+        {
+            int size = ScalarSize(type);
+            int width = OffsetWidth(count);
+            size_t data_pos = writer.GetSize() + 3 + width;
+            int pad = (int) ((size - data_pos % size) % size);
+
+            writer.Write((uint8_t) ValueType::TypedArray);
+            writer.Write((uint8_t) type);
+            writer.Write((uint8_t) (pad << 4 | width));
+            writer.Write(&count, width);
+            uint64_t zero = 0;
+            writer.Write(&zero, pad);
+            writer.Write(data, count * size);
+            writer.Write(&zero, size - 1 - pad);
+        }
+
+        void AlignTypedArrays(uint8_t* begin, size_t pos)
+        {
+            uint8_t* p = begin + pos;
+            switch ((ValueType) *p)
+            {
+            case ValueType::Object:
+            case ValueType::Array:
+            {
+                uint32_t size;
+                memcpy(&size, p + 1, sizeof(size));
+                uint8_t* body = p + 1 + CONTAINER_SIZE_BYTES;
+                int width = body[size - 1];
+                size_t count = LoadOffset(body + size - 1 - width, width);
+                const uint8_t* table = body + size - 1 - width - count * width;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const uint8_t* child = body + LoadOffset(table + i * width, width);
+                    if ((ValueType) *p == ValueType::Object && IsStringRef((ValueType) *child))
+                    {
+                        child += 1 + ScalarSize((ValueType) *child);
+                    }
+                    else if ((ValueType) *p == ValueType::Object)
+                    {
+                        std::string_view key = ReadKey(child);
+                        child = (const uint8_t*) key.data() + key.size();
+                    }
+                    AlignTypedArrays(begin, child - begin);
+                }
+                break;
+            }
+            case ValueType::TypedArray:
+            {
+                int size = ScalarSize((ValueType) p[1]);
+                int width = p[2] & 0xf;
+                int pad = p[2] >> 4;
+                size_t count = LoadOffset(p + 3, width);
+                uint8_t* slot = p + 3 + width;
+                int aligned = (int) ((size - (size_t) (slot - begin) % size) % size);
+                if (aligned != pad)
+                {
+                    memmove(slot + aligned, slot + pad, count * size);
+                    memset(slot, 0, aligned);
+                    memset(slot + aligned + count * size, 0, size - 1 - aligned);
+                    p[2] = (uint8_t) (aligned << 4 | width);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        std::string_view ReadKey(const uint8_t* entry)
+        {
+            // String tag, then the length as written by WriteInt64, then the bytes
+            const uint8_t* p = entry + 1;
+            size_t size = 0;
+            switch ((ValueType) *p)
+            {
+            case ValueType::Int8:
+            case ValueType::Uint8:
+                size = p[1];
+                p += 2;
+                break;
+            case ValueType::Int16:
+            case ValueType::Uint16:
+            {
+                uint16_t v;
+                memcpy(&v, p + 1, sizeof(v));
+                size = v;
+                p += 3;
+                break;
+            }
+            default:
+            {
+                uint32_t v;
+                memcpy(&v, p + 1, sizeof(v));
+                size = v;
+                p += 5;
+                break;
+            }
+            }
+            return std::string_view((const char*) p, size);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <jsonb/buffer.h>
+#include "format.h"
+#include <string_view>
+#include <vector>
+
+namespace jsonb
+{
+    // v2 value encoding shared by every writer, so that all of them produce the same bytes
+    namespace encoder
+    {
+        void WriteHeader(BufferWriter& writer, uint8_t flags = 0);
+        void WriteInt64(BufferWriter& writer, int64_t i);
+        void WriteUint64(BufferWriter& writer, uint64_t i);
+        void WriteFloat(BufferWriter& writer, float f);
+        // smallest exact form of d: Float, Decimal or Double
+        void WriteReal(BufferWriter& writer, double d);
+        void WriteString(BufferWriter& writer, const char* str, size_t size);
+        // reference to the index-th string of the dictionary section
+        void WriteStringRef(BufferWriter& writer, uint32_t index);
+        void WriteBool(BufferWriter& writer, bool b);
+        void WriteNull(BufferWriter& writer);
+
+        // writes the tag and leaves room for the size, returns the position of the first child
+        size_t BeginContainer(BufferWriter& writer, ValueType type);
+        // appends the trailer for offsets[first_offset..] and pops them,
+        // nested containers must have popped their own offsets already
+        void EndContainer(BufferWriter& writer, size_t body_pos, std::vector<uint32_t>& offsets, size_t first_offset);
+
+        // like EndContainer, but an array of two or more numbers that share a type
+        // is rewritten as a typed array, scratch holds the elements meanwhile
+        void EndArray(BufferWriter& writer, size_t body_pos, std::vector<uint32_t>& offsets, size_t first_offset, BufferWriter& scratch);
+        // count packed little endian elements of type, aligned to their size in the output
+        void WriteTypedArray(BufferWriter& writer, ValueType type, const void* data, size_t count);
+        // aligns the typed arrays under the value at pos again after it was moved,
+        // the value must be well formed
+        void AlignTypedArrays(uint8_t* begin, size_t pos);
+
+        // key of an object entry, the entry must be well formed
+        std::string_view ReadKey(const uint8_t* entry);
+    }
+}
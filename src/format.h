@@ -0,0 +1,365 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace jsonb
+{
+    // type tag written in front of every encoded value
+    enum class ValueType
+    {
+        Object,
+        Array,
+        String,
+        Uint8,
+        Int8,
+        Uint16,
+        Int16,
+        Uint32,
+        Int32,
+        Uint64,
+        Int64,
+        Float,
+        Bool,
+        Null,
+        // index into the dictionary section, stored with 1, 2 or 4 bytes
+        StringRef8,
+        StringRef16,
+        StringRef32,
+        // array of numbers packed without per element tags
+        TypedArray,
+        // reals that do not fit a float without loss
+        Double,
+        Decimal,
+        // container compressed on its own
+        Block,
+    };
+
+    // v1 buffers are a bare root value, v2 buffers start with a header:
+    //   magic "JSNB" | uint8 version | uint8 flags | uint16 reserved
+    //
+    // v2 containers are laid out as
+    //   tag | uint32 size | children | offsets[count] | count | width
+    // where size counts every byte after the size field, offsets are relative to
+    // the first child and count and offsets are stored with width (1, 2 or 4) bytes.
+    // object children are key string + value pairs and the offset table is sorted by key,
+    // so elements are found in O(1), keys in O(log n) and a subtree is skipped in O(1).
+    //
+    // with FLAG_DICTIONARY a dictionary section sits between the header and the root:
+    //   uint32 size | uint32 count | uint32 offsets[count + 1] | string bytes
+    // offsets are relative to the string bytes and the strings are sorted like keys,
+    // so comparing two StringRef indices orders them the same as comparing the strings.
+    // every object key is then a StringRef, string values may be one too.
+    //
+    // arrays of two or more numbers of one type are packed as
+    //   TypedArray | uint8 element type | uint8 pad << 4 | width | count | slot
+    // count is stored with width (1, 2 or 4) bytes. the slot holds the little endian elements
+    // plus size - 1 spare bytes, pad of them in front, which align the first element to its size
+    // from the start of the buffer, so an aligned buffer can be read in place. a typed array that
+    // moves is aligned again inside its slot without changing its size.
+    //
+    // a real is stored as a Float when that is exact, otherwise as a Decimal
+    //   Decimal | uint8 scale | int32 mantissa
+    // reading back mantissa / 10^scale, when that division gives the same double, else as a Double.
+    //
+    // with FLAG_BLOCKS containers that encode to at least a block size may be compressed as
+    //   Block | uint32 size | uint8 phase | uint8 tag | uint32 count | uint32 raw size | lz4 block
+    // raw is the container, from its tag, as it was encoded at an offset of phase modulo 8 from the
+    // start of the buffer, so its typed arrays stay aligned when it is decompressed to phase bytes
+    // past an 8 byte boundary. its tag and child count are repeated to be known without decompressing.
+    // blocks nest, a compressed container may hold blocks of its own
+    //
+    // a stream holds many records behind one header, see include/jsonb/stream.h:
+    //   magic "JSNS" | uint8 version | uint8 flags | uint16 reserved
+    //   dictionary section, with FLAG_DICTIONARY, shared by every record
+    //   records, each uint32 size | root value as in a v2 buffer, typed arrays aligned from the stream start
+    //   index of uint64 offsets of the records' size fields from the stream start
+    //   trailer: uint64 index offset | uint64 record count | magic "JSNX"
+    // a record's keys are StringRefs when they are in the dictionary and inline strings otherwise
+    //
+    // a delta turns one buffer into another, see include/jsonb/diff.h:
+    //   magic "JSND" | uint8 version | uint8 flags | uint16 reserved
+    //   uint64 base size | uint64 base hash | uint64 target size | uint64 target hash | ops
+    // with DELTA_FLAG_ALIGN the typed arrays of the target are aligned again once the ops ran,
+    // a subtree copied to another phase modulo 8 is copied with its padding as it was in the base.
+    // the ops write the target front to back, each starts with a varint whose low 2 bits are its kind:
+    //   literal: size << 2 | 0, then the bytes
+    //   copy:    size << 2 | 1, then a zigzag varint of its base offset minus the end of the previous op's
+    //   shift:   count << 5 | width << 2 | 2, then the base offset as for a copy and a zigzag varint
+    //            added to each of count offsets of width bytes read there, an offset table whose children moved
+    constexpr uint8_t FORMAT_MAGIC[4] = { 'J', 'S', 'N', 'B' };
+    constexpr uint8_t FORMAT_VERSION = 2;
+    constexpr size_t HEADER_SIZE = 8;
+    constexpr size_t CONTAINER_SIZE_BYTES = 4;
+    // container sizes and offsets are uint32, a bigger body can not be encoded
+    constexpr size_t MAX_CONTAINER_SIZE = UINT32_MAX;
+    constexpr uint8_t FLAG_DICTIONARY = 0x01;
+    constexpr uint8_t FLAG_BLOCKS = 0x02;
+    constexpr size_t BLOCK_HEADER_SIZE = 15;
+    constexpr int MAX_DECIMAL_SCALE = 22;
+    constexpr uint8_t STREAM_MAGIC[4] = { 'J', 'S', 'N', 'S' };
+    constexpr uint8_t STREAM_INDEX_MAGIC[4] = { 'J', 'S', 'N', 'X' };
+    constexpr uint8_t STREAM_VERSION = 1;
+    constexpr size_t STREAM_TRAILER_SIZE = 20;
+    constexpr uint8_t DELTA_MAGIC[4] = { 'J', 'S', 'N', 'D' };
+    constexpr uint8_t DELTA_VERSION = 1;
+    constexpr uint8_t DELTA_FLAG_ALIGN = 0x01;
+
+    struct Header
+    {
+        uint8_t version;
+        uint8_t flags;
+    };
+
+    // returns the header of a buffer, a buffer without magic is a v1 buffer
+    inline Header ReadHeader(const uint8_t* p, size_t size)
+    {
+        Header header = { 1, 0 };
+        if (size >= HEADER_SIZE && memcmp(p, FORMAT_MAGIC, sizeof(FORMAT_MAGIC)) == 0)
+        {
+            header.version = p[4];
+            header.flags = p[5];
+        }
+        return header;
+    }
+
+    // size of the payload after a fixed size tag, -1 for containers, strings and unknown tags
+    inline int ScalarSize(ValueType type)
+    {
+        switch (type)
+        {
+        case ValueType::Uint8:
+        case ValueType::Int8:
+        case ValueType::Bool:
+        case ValueType::StringRef8:
+            return 1;
+        case ValueType::Uint16:
+        case ValueType::Int16:
+        case ValueType::StringRef16:
+            return 2;
+        case ValueType::Uint32:
+        case ValueType::Int32:
+        case ValueType::Float:
+        case ValueType::StringRef32:
+            return 4;
+        case ValueType::Decimal:
+            return 5;
+        case ValueType::Uint64:
+        case ValueType::Int64:
+        case ValueType::Double:
+            return 8;
+        case ValueType::Null:
+            return 0;
+        default:
+            return -1;
+        }
+    }
+
+    inline bool IsReal(ValueType type)
+    {
+        return type == ValueType::Float || type == ValueType::Double || type == ValueType::Decimal;
+    }
+
+    // powers of ten that are exact doubles
+    constexpr double POW10[MAX_DECIMAL_SCALE + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    // value of a Decimal payload, both operands are exact doubles so the division rounds correctly
+    inline double LoadDecimal(const uint8_t* p)
+    {
+        int32_t mantissa;
+        memcpy(&mantissa, p + 1, sizeof(mantissa));
+        return (double) mantissa / POW10[p[0] <= MAX_DECIMAL_SCALE ? p[0] : 0];
+    }
+
+    inline bool IsStringRef(ValueType type)
+    {
+        return type == ValueType::StringRef8 || type == ValueType::StringRef16 || type == ValueType::StringRef32;
+    }
+
+    // smallest width able to hold every offset and the count of a container
+    inline int OffsetWidth(size_t max_value)
+    {
+        if (max_value <= 0xff)
+        {
+            return 1;
+        }
+        if (max_value <= 0xffff)
+        {
+            return 2;
+        }
+        return 4;
+    }
+
+    inline uint32_t LoadOffset(const uint8_t* p, int width)
+    {
+        switch (width)
+        {
+        case 1:
+            return p[0];
+        case 2:
+        {
+            uint16_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        default:
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        }
+    }
+
+    // v2 container located through its size field and trailer
+    struct Container
+    {
+        const uint8_t* body;
+        const uint8_t* table;
+        const uint8_t* end;
+        size_t count;
+        int width;
+    };
+
+    inline bool ReadContainer(const uint8_t* p, const uint8_t* end, Container& c)
+    {
+        if ((size_t) (end - p) < 1 + CONTAINER_SIZE_BYTES)
+        {
+            return false;
+        }
+        uint32_t size;
+        memcpy(&size, p + 1, sizeof(size));
+        const uint8_t* body = p + 1 + CONTAINER_SIZE_BYTES;
+        if ((size_t) (end - body) < size || size < 2)
+        {
+            return false;
+        }
+
+        const uint8_t* body_end = body + size;
+        int width = body_end[-1];
+        if ((width != 1 && width != 2 && width != 4) || size < (size_t) width + 1)
+        {
+            return false;
+        }
+        size_t count = LoadOffset(body_end - 1 - width, width);
+        if (count > (size - width - 1) / width)
+        {
+            return false;
+        }
+
+        c.body = body;
+        c.table = body_end - 1 - width - count * width;
+        c.end = body_end;
+        c.count = count;
+        c.width = width;
+        return true;
+    }
+
+    // start of the i-th child in offset table order
+    inline const uint8_t* ReadChild(const Container& c, size_t i)
+    {
+        uint32_t offset = LoadOffset(c.table + i * c.width, c.width);
+        if (offset >= (size_t) (c.table - c.body))
+        {
+            return nullptr;
+        }
+        return c.body + offset;
+    }
+
+    // a typed array located through its header
+    struct TypedArray
+    {
+        ValueType type;
+        int size;
+        size_t count;
+        const uint8_t* data;
+        const uint8_t* end;
+    };
+
+    inline bool IsTypedArrayElement(ValueType type)
+    {
+        return (type >= ValueType::Uint8 && type <= ValueType::Float) || type == ValueType::Double;
+    }
+
+    inline bool ReadTypedArray(const uint8_t* p, const uint8_t* end, TypedArray& a)
+    {
+        if (end - p < 3)
+        {
+            return false;
+        }
+        a.type = (ValueType) p[1];
+        int width = p[2] & 0xf;
+        int pad = p[2] >> 4;
+        if (!IsTypedArrayElement(a.type) || (width != 1 && width != 2 && width != 4) || end - p < 3 + width)
+        {
+            return false;
+        }
+        a.size = ScalarSize(a.type);
+        a.count = LoadOffset(p + 3, width);
+        a.data = p + 3 + width + pad;
+        if (pad >= a.size || end - a.data < a.size - 1 - pad || (size_t) (end - a.data - (a.size - 1 - pad)) / a.size < a.count)
+        {
+            return false;
+        }
+        a.end = a.data + a.count * a.size + (a.size - 1 - pad);
+        return true;
+    }
+
+    // a compressed container located through its header
+    struct Block
+    {
+        ValueType type;
+        int phase;
+        size_t count;
+        size_t raw_size;
+        const uint8_t* data;
+        size_t size;
+        const uint8_t* end;
+    };
+
+    inline bool ReadBlock(const uint8_t* p, const uint8_t* end, Block& b)
+    {
+        if ((size_t) (end - p) < BLOCK_HEADER_SIZE)
+        {
+            return false;
+        }
+        uint32_t size;
+        uint32_t count;
+        uint32_t raw_size;
+        memcpy(&size, p + 1, sizeof(size));
+        memcpy(&count, p + 7, sizeof(count));
+        memcpy(&raw_size, p + 11, sizeof(raw_size));
+        b.type = (ValueType) p[6];
+        b.phase = p[5];
+        b.count = count;
+        b.raw_size = raw_size;
+        b.data = p + BLOCK_HEADER_SIZE;
+        b.size = size - (BLOCK_HEADER_SIZE - 1 - CONTAINER_SIZE_BYTES);
+        b.end = p + 1 + CONTAINER_SIZE_BYTES + size;
+        // an lz4 block expands at most 255 times
+        return b.phase < 8 && (b.type == ValueType::Object || b.type == ValueType::Array || b.type == ValueType::TypedArray) &&
+            size >= BLOCK_HEADER_SIZE - 1 - CONTAINER_SIZE_BYTES && (size_t) (end - p - 1 - CONTAINER_SIZE_BYTES) >= size &&
+            raw_size > 0 && raw_size / 255 <= b.size;
+    }
+}
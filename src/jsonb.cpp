@@ -16,32 +16,155 @@
 */
 
 #include <jsonb/jsonb.h>
+#include <jsonb/emitter.h>
+#include "block_writer.h"
+#include "convert.h"
+#include "encoder.h"
+#include "lz.h"
+#include "thread_pool.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
 
 namespace jsonb
 {
-    enum class ValueType
-    {
-        Object,
-        Array,
-        String,
-        Uint8,
-        Int8,
-        Uint16,
-        Int16,
-        Uint32,
-        Int32,
-        Uint64,
-        Int64,
-        Float,
-        Bool,
-        Null,
-    };
+    namespace
+    {
+        // typed arrays are converted through a small block that stays in cache
+        const size_t CONVERT_BLOCK = 256;
+        // with a pool, a Value tree of this many values is written by up to TASKS_PER_THREAD
+        // tasks per thread for each container, a task left with a single child splits it again.
+        // a v2 container this big in bytes is read by tasks of about TASK_BYTES
+        const size_t PARALLEL_VALUES = 4096;
+        const size_t TASKS_PER_THREAD = 4;
+        const size_t PARALLEL_BYTES = 128 * 1024;
+        const size_t TASK_BYTES = 64 * 1024;
+
+        // every container is inside the root, so only the root has to fit its uint32 size
+        bool FitsContainerSize(const BufferWriter& writer, size_t root_pos)
+        {
+            return writer.GetSize() - root_pos <= 1 + CONTAINER_SIZE_BYTES + MAX_CONTAINER_SIZE;
+        }
+
+        uint64_t Now()
+        {
+            return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // consecutive children of a Value container, written by one task to its own buffer
+        struct Chunk
+        {
+            size_t first;
+            size_t count;
+            BufferWriter writer;
+            // where each child starts in writer
+            std::vector<uint32_t> offsets;
+            // typed arrays written by the task, or by more than it when tasks ran inside it
+            size_t typed_arrays;
+        };
+
+        // same order as the v2 offset tables, bytes first then length
+        bool KeyLess(const Node::Member& a, const Node::Member& b)
+        {
+            uint32_t size = a.key_size < b.key_size ? a.key_size : b.key_size;
+            int c = memcmp(a.key, b.key, size);
+            return c < 0 || (c == 0 && a.key_size < b.key_size);
+        }
+
+        // values in the tree of value, counting stops once limit is reached
+        size_t CountValues(const Value& value, size_t limit)
+        {
+            size_t count = 1;
+            for (size_t i = 0; i < value.Size() && count < limit; ++i)
+            {
+                count += CountValues(value[i], limit - count);
+            }
+            return count;
+        }
+
+        // position of the index-th child of the v2 container whose body the cursor is at
+        size_t ChildPos(const Cursor& cursor, size_t end_pos, size_t count, size_t index)
+        {
+            const uint8_t* body_end = cursor.GetBegin() + end_pos;
+            int width = body_end[-1];
+            return cursor.GetOffset() + LoadOffset(body_end - 1 - width - (count - index) * width, width);
+        }
+
+        // groups those children into runs of about TASK_BYTES by the offset table and returns
+        // the first child of each run, false if the table is malformed or makes a single run
+        bool SplitRuns(const Cursor& cursor, size_t end_pos, size_t count, std::vector<size_t>& runs)
+        {
+            int width = cursor.GetBegin()[end_pos - 1];
+            size_t table_size = count * width + width + 1;
+            if (table_size > end_pos - cursor.GetOffset())
+            {
+                return false;
+            }
+            size_t run_pos = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t pos = ChildPos(cursor, end_pos, count, i);
+                if (pos >= end_pos - table_size)
+                {
+                    return false;
+                }
+                if (runs.empty() || pos - run_pos >= TASK_BYTES)
+                {
+                    runs.push_back(i);
+                    run_pos = pos;
+                }
+            }
+            return runs.size() > 1;
+        }
+    }
+
+    namespace
+    {
+        // decompresses the block whose tag the cursor just read to raw, block then reads the container in it
+        bool OpenBlock(Cursor& cursor, BufferWriter& raw, Cursor& block)
+        {
+            Block b;
+            if (!ReadBlock(cursor.GetPos() - 1, cursor.GetEnd(), b))
+            {
+                cursor.Fail();
+                return false;
+            }
+            cursor.Seek(b.end - cursor.GetBegin());
+
+            // at phase past the aligned start of the buffer its typed arrays are aligned
+            raw.Clear();
+            raw.Skip(b.phase + b.raw_size);
+            uint8_t* data = raw.GetData() + b.phase;
+            if (!lz::Decompress(b.data, b.size, data, b.raw_size) || data[0] != (uint8_t) b.type)
+            {
+                cursor.Fail();
+                return false;
+            }
+            block = Cursor(raw.GetData(), raw.GetSize());
+            block.Seek(b.phase);
+            return true;
+        }
+    }
 
     Document::Document():
         m_binary(nullptr),
-        m_binary_size(0)
+        m_binary_size(0),
+        m_version(FORMAT_VERSION),
+        m_validate(true),
+        m_dictionary_mode(DictionaryMode::None),
+        m_compression_level(0),
+        m_reuse_arena(false),
+        m_lazy_decode(false),
+        m_lazy(false),
+        m_stats(nullptr),
+        m_trace_hook(nullptr),
+        m_trace_context(nullptr),
+        m_phase_begin(0)
     {
-        
+        m_workers.emplace_back(new Worker());
     }
 
     Document::~Document()
@@ -54,345 +177,1408 @@ namespace jsonb
         m_binary_size = 0;
     }
 
-    void Document::WriteValue(std::ostringstream& os, const Json::Value& value)
+    void Document::SetThreadCount(int count)
     {
-        Json::ValueType type = value.type();
-        switch (type)
+        if (count <= 0)
+        {
+            count = (int) std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (count == this->GetThreadCount())
+        {
+            return;
+        }
+
+        m_pool.reset(count > 1 ? new ThreadPool(count) : nullptr);
+        while (m_workers.size() < (size_t) count)
         {
-        case Json::ValueType::objectValue:
-            this->WriteObject(os, value);
+            m_workers.emplace_back(new Worker());
+        }
+    }
+
+    int Document::GetThreadCount() const
+    {
+        return m_pool ? m_pool->GetThreadCount() : 1;
+    }
+
+    Document::Worker& Document::GetWorker()
+    {
+        return *m_workers[m_pool ? m_pool->GetCurrentIndex() : 0];
+    }
+
+    Arena& Document::GetArena()
+    {
+        int index = m_pool ? m_pool->GetCurrentIndex() : 0;
+        return index == 0 ? m_arena : m_workers[index]->arena;
+    }
+
+    void Document::WriteValue(BufferWriter& writer, const Value& value, Worker& worker, bool split)
+    {
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+            this->WriteObject(writer, value, worker, split);
             break;
-        case Json::ValueType::arrayValue:
-            this->WriteArray(os, value);
+        case Kind::Array:
+            this->WriteArray(writer, value, worker, split);
             break;
-        case Json::ValueType::stringValue:
-            this->WriteString(os, value);
+        case Kind::String:
+        {
+            std::string_view str = value.AsString();
+            encoder::WriteString(writer, str.data(), str.size());
             break;
-        case Json::ValueType::intValue:
-            this->WriteInt64(os, value.asLargestInt());
+        }
+        case Kind::Int:
+            encoder::WriteInt64(writer, value.AsInt64());
             break;
-        case Json::ValueType::uintValue:
-            this->WriteUint64(os, value.asLargestUInt());
+        case Kind::Uint:
+            encoder::WriteUint64(writer, value.AsUint64());
             break;
-        case Json::ValueType::realValue:
-            this->WriteFloat(os, value.asFloat());
+        case Kind::Real:
+            encoder::WriteReal(writer, value.AsDouble());
             break;
-        case Json::ValueType::booleanValue:
-            this->WriteBool(os, value.asBool());
+        case Kind::Bool:
+            encoder::WriteBool(writer, value.AsBool());
             break;
-        case Json::ValueType::nullValue:
-            this->WriteNull(os);
+        case Kind::Null:
+            encoder::WriteNull(writer);
             break;
         }
     }
 
-    void Document::WriteObject(std::ostringstream& os, const Json::Value& obj)
+    void Document::WriteObject(BufferWriter& writer, const Value& obj, Worker& worker, bool split)
     {
-        this->Write(os, (uint8_t) ValueType::Object);
+        size_t body_pos = encoder::BeginContainer(writer, ValueType::Object);
+        size_t first_offset = worker.offsets.size();
 
-        int value_count = obj.size();
-        this->WriteInt64(os, value_count);
-
-        for (auto i = obj.begin(); i != obj.end(); ++i)
+        // members are kept sorted by key, the order the offset table needs
+        if (!split || !this->WriteChildren(writer, obj, body_pos, worker))
         {
-            Json::Value key = i.key();
-            this->WriteString(os, key);
+            size_t member_count = obj.Size();
+            for (size_t i = 0; i < member_count; ++i)
+            {
+                worker.offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
 
-            const Json::Value& value = *i;
-            this->WriteValue(os, value);
+                std::string_view key = obj.GetKey(i);
+                encoder::WriteString(writer, key.data(), key.size());
+
+                this->WriteValue(writer, obj[i], worker, split);
+            }
         }
+
+        encoder::EndContainer(writer, body_pos, worker.offsets, first_offset);
     }
 
-    void Document::WriteArray(std::ostringstream& os, const Json::Value& arr)
+    void Document::WriteArray(BufferWriter& writer, const Value& arr, Worker& worker, bool split)
     {
-        this->Write(os, (uint8_t) ValueType::Array);
+        size_t body_pos = encoder::BeginContainer(writer, ValueType::Array);
+        size_t first_offset = worker.offsets.size();
 
-        int value_count = arr.size();
-        this->WriteInt64(os, value_count);
+        if (!split || !this->WriteChildren(writer, arr, body_pos, worker))
+        {
+            size_t value_count = arr.Size();
+            for (size_t i = 0; i < value_count; ++i)
+            {
+                worker.offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                this->WriteValue(writer, arr[i], worker, split);
+            }
+        }
 
-        for (int i = 0; i < value_count; ++i)
+        encoder::EndArray(writer, body_pos, worker.offsets, first_offset, worker.scratch);
+        if (writer.GetData()[body_pos - 1 - CONTAINER_SIZE_BYTES] == (uint8_t) ValueType::TypedArray)
         {
-            const Json::Value& value = arr[i];
-            this->WriteValue(os, value);
+            worker.typed_arrays += 1;
         }
     }
 
-    void Document::WriteInt64(std::ostringstream& os, int64_t i)
+    bool Document::WriteChildren(BufferWriter& writer, const Value& container, size_t body_pos, Worker& worker)
     {
-        if (i >= -2147483648i64 && i <= 2147483647i64)
+        // children are shared out by count, counting the values of each one would take
+        // about as long as writing them. uneven chunks are evened out by stealing
+        size_t child_count = container.Size();
+        size_t chunk_count = std::min(child_count, (size_t) m_pool->GetThreadCount() * TASKS_PER_THREAD);
+        if (chunk_count < 2)
         {
-            if (i >= -32768 && i <= 32767)
-            {
-                if (i >= -128 && i <= 127)
-                {
-                    this->Write(os, (uint8_t) ValueType::Int8);
-                    this->Write(os, (int8_t) i);
-                }
-                else if (i >= 128 && i <= 255)
-                {
-                    this->Write(os, (uint8_t) ValueType::Uint8);
-                    this->Write(os, (uint8_t) i);
-                }
-                else
-                {
-                    this->Write(os, (uint8_t) ValueType::Int16);
-                    this->Write(os, (int16_t) i);
-                }
-            }
-            else if (i >= 32768 && i <= 65535)
-            {
-                this->Write(os, (uint8_t) ValueType::Uint16);
-                this->Write(os, (uint16_t) i);
-            }
-            else
-            {
-                this->Write(os, (uint8_t) ValueType::Int32);
-                this->Write(os, (int32_t) i);
-            }
+            return false;
         }
-        else if (i >= 2147483648i64 && i <= 4294967295i64)
+        std::vector<Chunk> chunks(chunk_count);
+        for (size_t i = 0; i < chunk_count; ++i)
         {
-            this->Write(os, (uint8_t) ValueType::Uint32);
-            this->Write(os, (uint32_t) i);
+            chunks[i].first = i * child_count / chunk_count;
+            chunks[i].count = (i + 1) * child_count / chunk_count - chunks[i].first;
         }
-        else
+
+        bool object = container.IsObject();
+        ThreadPool::Group group;
+        for (Chunk& chunk : chunks)
         {
-            this->Write(os, (uint8_t) ValueType::Int64);
-            this->Write(os, (int64_t) i);
+            m_pool->Run(group, [this, &chunk, &container, object]() {
+                Worker& task_worker = this->GetWorker();
+                size_t typed_arrays = task_worker.typed_arrays;
+                for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i)
+                {
+                    chunk.offsets.push_back((uint32_t) chunk.writer.GetSize());
+                    if (object)
+                    {
+                        std::string_view key = container.GetKey(i);
+                        encoder::WriteString(chunk.writer, key.data(), key.size());
+                    }
+                    this->WriteValue(chunk.writer, container[i], task_worker, chunk.count == 1);
+                }
+                chunk.typed_arrays = task_worker.typed_arrays - typed_arrays;
+            });
         }
-    }
-
-    void Document::WriteUint64(std::ostringstream& os, uint64_t i)
-    {
-        this->Write(os, (uint8_t) ValueType::Uint64);
-        this->Write(os, (uint64_t) i);
-    }
-
-    void Document::WriteFloat(std::ostringstream& os, float f)
-    {
-        this->Write(os, (uint8_t) ValueType::Float);
-        this->Write(os, f);
-    }
-
-    void Document::WriteString(std::ostringstream& os, const Json::Value& s)
-    {
-        this->Write(os, (uint8_t) ValueType::String);
+        m_pool->Wait(group);
 
-        std::string str = s.asString();
-        int size = (int) str.length();
-
-        this->WriteInt64(os, size);
-        if (size > 0)
+        // typed arrays are aligned within their chunk, ToBinary aligns them for the final buffer
+        for (Chunk& chunk : chunks)
         {
-            os.write(str.c_str(), size);
+            size_t chunk_pos = writer.GetSize();
+            writer.Write(chunk.writer.GetData(), chunk.writer.GetSize());
+            worker.typed_arrays += chunk.typed_arrays;
+            for (uint32_t offset : chunk.offsets)
+            {
+                worker.offsets.push_back((uint32_t) (chunk_pos + offset - body_pos));
+            }
         }
+        return true;
     }
 
-    void Document::WriteBool(std::ostringstream& os, bool b)
+    Status Document::Load(std::string_view json)
     {
-        this->Write(os, (uint8_t) ValueType::Bool);
-        this->Write(os, (int8_t) (b ? 1 : 0));
-    }
+        StatsScope scope(*this, json.size());
+        Stats* stats = scope.Get();
 
-    void Document::WriteNull(std::ostringstream& os)
-    {
-        this->Write(os, (uint8_t) ValueType::Null);
-    }
+        // the binary is a compact, already sorted form to build the tree from
+        BufferWriter writer;
+        writer.Reserve(json.size() / 2);
+        if (!m_transcoder.Transcode(json.data(), json.size(), writer))
+        {
+            return Status(Error::BadJson, m_transcoder.GetErrorOffset());
+        }
+        this->EndPhase(stats, Phase::Parse);
 
-    bool Document::Load(const std::string& json)
-    {
-        Json::CharReaderBuilder builder;
-        Json::CharReader* reader = builder.newCharReader();
-        std::string errs;
-        const char* begin = json.c_str();
-        const char* end = begin + json.length();
-        bool result = reader->parse(begin, end, &m_root, &errs);
-        delete reader;
-        return result;
+        View view(writer.GetData(), writer.GetSize());
+        Status status = this->ReadRoot(view);
+        if (stats && status)
+        {
+            this->EndPhase(stats, Phase::Decode);
+            stats->heap_blocks = CollectStats(view, *stats);
+            scope.Succeed(0);
+        }
+        return status;
     }
 
-    void Document::ReadValue(std::istringstream& is, Json::Value& value)
+    void Document::ReadValue(Cursor& cursor, Value& value)
     {
-        ValueType type = (ValueType) this->Read<uint8_t>(is);
+        ValueType type = (ValueType) this->Read<uint8_t>(cursor);
         switch (type)
         {
             case ValueType::Object:
-                this->ReadObject(is, value);
+                this->ReadObject(cursor, value);
                 break;
             case ValueType::Array:
-                this->ReadArray(is, value);
+                this->ReadArray(cursor, value);
+                break;
+            case ValueType::TypedArray:
+                this->ReadTypedArray(cursor, value);
                 break;
             case ValueType::String:
-            {
-                std::string str;
-                this->ReadString(is, str);
+            case ValueType::StringRef8:
+            case ValueType::StringRef16:
+            case ValueType::StringRef32:
+                value = Value(this->ReadString(cursor, type));
                 break;
-            }
             case ValueType::Uint8:
-            {
-                Json::Value i((int) this->Read<uint8_t>(is));
-                value.swapPayload(i);
+                value = Value((int) this->Read<uint8_t>(cursor));
                 break;
-            }
             case ValueType::Int8:
-            {
-                Json::Value i((int) this->Read<int8_t>(is));
-                value.swapPayload(i);
+                value = Value((int) this->Read<int8_t>(cursor));
                 break;
-            }
             case ValueType::Uint16:
-            {
-                Json::Value i((int) this->Read<uint16_t>(is));
-                value.swapPayload(i);
+                value = Value((int) this->Read<uint16_t>(cursor));
                 break;
-            }
             case ValueType::Int16:
-            {
-                Json::Value i((int) this->Read<int16_t>(is));
-                value.swapPayload(i);
+                value = Value((int) this->Read<int16_t>(cursor));
                 break;
-            }
             case ValueType::Uint32:
-            {
-                Json::Value i(this->Read<uint32_t>(is));
-                value.swapPayload(i);
+                value = Value((long long) this->Read<uint32_t>(cursor));
                 break;
-            }
             case ValueType::Int32:
-            {
-                Json::Value i(this->Read<int32_t>(is));
-                value.swapPayload(i);
+                value = Value(this->Read<int32_t>(cursor));
                 break;
-            }
             case ValueType::Uint64:
-            {
-                Json::Value i(this->Read<uint64_t>(is));
-                value.swapPayload(i);
+                value = Value((unsigned long long) this->Read<uint64_t>(cursor));
                 break;
-            }
             case ValueType::Int64:
-            {
-                Json::Value i(this->Read<int64_t>(is));
-                value.swapPayload(i);
+                value = Value((long long) this->Read<int64_t>(cursor));
                 break;
-            }
             case ValueType::Float:
+                value = Value((double) this->Read<float>(cursor));
+                break;
+            case ValueType::Double:
+                value = Value(this->Read<double>(cursor));
+                break;
+            case ValueType::Decimal:
             {
-                Json::Value f(this->Read<float>(is));
-                value.swapPayload(f);
+                const uint8_t* payload = cursor.ReadBytes(5);
+                value = Value(payload ? LoadDecimal(payload) : 0.0);
                 break;
             }
             case ValueType::Bool:
+                value = Value(this->Read<int8_t>(cursor) == 1);
+                break;
+            case ValueType::Null:
+                value = Value();
+                break;
+            case ValueType::Block:
             {
-                Json::Value b(this->Read<int8_t>(is) == 1);
-                value.swapPayload(b);
+                BufferWriter raw;
+                Cursor block;
+                if (OpenBlock(cursor, raw, block))
+                {
+                    this->ReadValue(block, value);
+                    if (block.IsFailed())
+                    {
+                        cursor.Fail();
+                    }
+                }
                 break;
             }
-            case ValueType::Null:
+            default:
+                cursor.Fail();
                 break;
         }
     }
 
-    void Document::ReadObject(std::istringstream& is, Json::Value& value)
+    void Document::ReadObject(Cursor& cursor, Value& value)
+    {
+        size_t end_pos = 0;
+        int value_count = this->ReadContainerCount(cursor, end_pos);
+        // every member takes at least a key tag, a length and a value tag
+        value = Value(Kind::Object);
+        if ((size_t) value_count > cursor.GetRemaining() / 3)
+        {
+            cursor.Fail();
+            return;
+        }
+        value.Reserve(value_count);
+
+        // the members are added up front, they may not move while tasks fill them in
+        std::vector<size_t> runs;
+        if (this->SplitChildren(cursor, end_pos, value_count, runs))
+        {
+            for (int i = 0; i < value_count; ++i)
+            {
+                Cursor member = cursor;
+                member.Seek(ChildPos(cursor, end_pos, value_count, i));
+                ValueType key_type = (ValueType) this->Read<uint8_t>(member);
+                std::string_view key = this->ReadString(member, key_type);
+                if (member.IsFailed())
+                {
+                    cursor.Fail();
+                    return;
+                }
+                value[key];
+            }
+
+            // the keys of a v2 object come sorted, so the i-th member is the i-th child,
+            // unless repeated keys shared a member
+            if (value.Size() == (size_t) value_count)
+            {
+                std::vector<Value*> slots(value_count);
+                for (int i = 0; i < value_count; ++i)
+                {
+                    slots[i] = &value[(size_t) i];
+                }
+                this->ReadChildren(cursor, end_pos, runs, true, slots);
+                cursor.Seek(end_pos);
+                return;
+            }
+        }
+
+        for (int i = 0; i < value_count && !cursor.IsFailed(); ++i)
+        {
+            ValueType key_type = (ValueType) this->Read<uint8_t>(cursor);
+            std::string_view key = this->ReadString(cursor, key_type);
+            this->ReadValue(cursor, value[key]);
+        }
+        if (m_version >= 2)
+        {
+            cursor.Seek(end_pos);
+        }
+    }
+
+    void Document::ReadArray(Cursor& cursor, Value& value)
+    {
+        size_t end_pos = 0;
+        int value_count = this->ReadContainerCount(cursor, end_pos);
+        value = Value(Kind::Array);
+        if ((size_t) value_count > cursor.GetRemaining())
+        {
+            cursor.Fail();
+            return;
+        }
+        value.Resize(value_count);
+
+        std::vector<size_t> runs;
+        if (this->SplitChildren(cursor, end_pos, value_count, runs))
+        {
+            std::vector<Value*> slots(value_count);
+            for (int i = 0; i < value_count; ++i)
+            {
+                slots[i] = &value[(size_t) i];
+            }
+            this->ReadChildren(cursor, end_pos, runs, false, slots);
+            cursor.Seek(end_pos);
+            return;
+        }
+
+        for (int i = 0; i < value_count && !cursor.IsFailed(); ++i)
+        {
+            this->ReadValue(cursor, value[(size_t) i]);
+        }
+        if (m_version >= 2)
+        {
+            cursor.Seek(end_pos);
+        }
+    }
+
+    void Document::ReadChildren(Cursor& cursor, size_t end_pos, const std::vector<size_t>& runs, bool object, const std::vector<Value*>& slots)
+    {
+        std::atomic<bool> failed(false);
+        ThreadPool::Group group;
+        for (size_t k = 0; k < runs.size(); ++k)
+        {
+            size_t first = runs[k];
+            size_t last = k + 1 < runs.size() ? runs[k + 1] : slots.size();
+            m_pool->Run(group, [this, &cursor, &failed, &slots, end_pos, first, last, object]() {
+                Cursor run = cursor;
+                run.Seek(ChildPos(cursor, end_pos, slots.size(), first));
+                for (size_t i = first; i < last && !run.IsFailed(); ++i)
+                {
+                    if (object)
+                    {
+                        ValueType key_type = (ValueType) this->Read<uint8_t>(run);
+                        this->ReadString(run, key_type);
+                    }
+                    this->ReadValue(run, *slots[i]);
+                }
+                if (run.IsFailed())
+                {
+                    failed = true;
+                }
+            });
+        }
+        m_pool->Wait(group);
+
+        if (failed)
+        {
+            cursor.Fail();
+        }
+    }
+
+    void Document::ReadTypedArray(Cursor& cursor, Value& value)
+    {
+        ValueType type = ValueType::Null;
+        size_t count = 0;
+        const uint8_t* data = this->ReadTypedElements(cursor, type, count);
+        value = Value(Kind::Array);
+        if (data == nullptr)
+        {
+            return;
+        }
+        value.Resize(count);
+
+        int size = ScalarSize(type);
+        bool is_unsigned = type == ValueType::Uint64;
+        for (size_t i = 0; i < count; i += CONVERT_BLOCK)
+        {
+            size_t block = std::min(count - i, CONVERT_BLOCK);
+            if (IsReal(type))
+            {
+                double reals[CONVERT_BLOCK];
+                ConvertToDouble(type, data + i * size, reals, block);
+                for (size_t j = 0; j < block; ++j)
+                {
+                    value[i + j] = Value(reals[j]);
+                }
+            }
+            else
+            {
+                int64_t ints[CONVERT_BLOCK];
+                ConvertToInt64(type, data + i * size, ints, block);
+                for (size_t j = 0; j < block; ++j)
+                {
+                    if (is_unsigned)
+                    {
+                        value[i + j] = Value((unsigned long long) ints[j]);
+                    }
+                    else
+                    {
+                        value[i + j] = Value((long long) ints[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    const uint8_t* Document::ReadTypedElements(Cursor& cursor, ValueType& type, size_t& count)
+    {
+        type = (ValueType) this->Read<uint8_t>(cursor);
+        uint8_t layout = this->Read<uint8_t>(cursor);
+        int width = layout & 0xf;
+        const uint8_t* count_bytes = cursor.ReadBytes(width);
+        count = count_bytes ? LoadOffset(count_bytes, width) : 0;
+        int pad = layout >> 4;
+        int size = ScalarSize(type);
+        if (!IsTypedArrayElement(type) || (width != 1 && width != 2 && width != 4) || pad >= size || count > cursor.GetRemaining())
+        {
+            cursor.Fail();
+            return nullptr;
+        }
+        cursor.ReadBytes(pad);
+        const uint8_t* data = cursor.ReadBytes(count * size);
+        cursor.ReadBytes(size - 1 - pad);
+        return data;
+    }
+
+    int Document::ReadContainerCount(Cursor& cursor, size_t& end_pos)
     {
-        int value_count = this->ReadAsInt(is);
-        for (int i = 0; i < value_count; ++i)
+        if (m_version < 2)
+        {
+            return this->ReadAsInt(cursor);
+        }
+
+        // v2 keeps count and width in the trailer, children start right after the size
+        uint32_t size = this->Read<uint32_t>(cursor);
+        size_t body_pos = cursor.GetOffset();
+        end_pos = body_pos + size;
+        if (size < 2 || cursor.GetRemaining() < size)
+        {
+            cursor.Fail();
+            return 0;
+        }
+
+        const uint8_t* body_end = cursor.GetPos() + size;
+        int width = body_end[-1];
+        if (width != 1 && width != 2 && width != 4)
         {
-            std::string key;
-            this->Read<uint8_t>(is);
-            this->ReadString(is, key);
-            this->ReadValue(is, value[key]);
+            cursor.Fail();
+            return 0;
         }
+        return (int) LoadOffset(body_end - 1 - width, width);
     }
 
-    void Document::ReadArray(std::istringstream& is, Json::Value& value)
+    std::string_view Document::ReadString(Cursor& cursor, ValueType type)
     {
-        int value_count = this->ReadAsInt(is);
-        value.resize(value_count);
-        for (int i = 0; i < value_count; ++i)
+        if (IsStringRef(type))
         {
-            this->ReadValue(is, value[i]);
+            uint32_t index = this->ReadStringRef(cursor, type);
+            return cursor.IsFailed() ? std::string_view() : m_source.GetString(index);
         }
+        if (type != ValueType::String)
+        {
+            cursor.Fail();
+            return std::string_view();
+        }
+
+        int size = this->ReadAsInt(cursor);
+        const uint8_t* bytes = cursor.ReadBytes(size);
+        if (bytes == nullptr)
+        {
+            return std::string_view();
+        }
+        return std::string_view((const char*) bytes, size);
     }
 
-    void Document::ReadString(std::istringstream& is, std::string& str)
+    uint32_t Document::ReadStringRef(Cursor& cursor, ValueType type)
     {
-        int size = this->ReadAsInt(is);
-        str.resize(size);
-        if (size > 0)
+        uint32_t index = 0;
+        switch (type)
+        {
+        case ValueType::StringRef8:
+            index = this->Read<uint8_t>(cursor);
+            break;
+        case ValueType::StringRef16:
+            index = this->Read<uint16_t>(cursor);
+            break;
+        default:
+            index = this->Read<uint32_t>(cursor);
+            break;
+        }
+        if (index >= m_source.GetStringCount())
         {
-            is.read((char*) &str[0], size);
+            cursor.Fail();
+            index = 0;
         }
+        return index;
     }
 
-    int Document::ReadAsInt(std::istringstream& is)
+    int Document::ReadAsInt(Cursor& cursor)
     {
         int i = 0;
-        ValueType type = (ValueType) this->Read<uint8_t>(is);
+        ValueType type = (ValueType) this->Read<uint8_t>(cursor);
         switch (type)
         {
         case ValueType::Uint8:
-            i = (int) this->Read<uint8_t>(is);
+            i = (int) this->Read<uint8_t>(cursor);
             break;
         case ValueType::Int8:
-            i = (int) this->Read<int8_t>(is);
+            i = (int) this->Read<int8_t>(cursor);
             break;
         case ValueType::Uint16:
-            i = (int) this->Read<uint16_t>(is);
+            i = (int) this->Read<uint16_t>(cursor);
             break;
         case ValueType::Int16:
-            i = (int) this->Read<int16_t>(is);
+            i = (int) this->Read<int16_t>(cursor);
             break;
         case ValueType::Int32:
-            i = (int) this->Read<int32_t>(is);
+            i = (int) this->Read<int32_t>(cursor);
+            break;
+        default:
+            cursor.Fail();
             break;
         }
+        if (i < 0)
+        {
+            cursor.Fail();
+            i = 0;
+        }
         return i;
     }
 
-    bool Document::Load(const void* binary, size_t size)
+    bool Document::SplitChildren(const Cursor& cursor, size_t end_pos, size_t count, std::vector<size_t>& runs) const
+    {
+        // v1 containers have no offset table to find the children by
+        return m_pool && m_version >= 2 && !cursor.IsFailed() && end_pos - cursor.GetOffset() >= PARALLEL_BYTES &&
+            SplitRuns(cursor, end_pos, count, runs);
+    }
+
+    bool Document::OpenBinary(const View& view, Cursor& cursor)
     {
-        if (binary == nullptr || size == 0)
+        m_source = view;
+        ValueRef root = m_source.Root();
+        if (!root.IsValid())
         {
             return false;
         }
+        m_version = m_source.GetVersion();
 
-        // deserialize stream to root
-        std::string buffer((const char*) binary, size);
-        std::istringstream is(buffer);
-        
-        this->ReadValue(is, m_root);
-
+        // the root follows the header and the dictionary section, if any
+        cursor = Cursor(view.GetBegin(), view.GetEnd() - view.GetBegin());
+        cursor.Seek(root.GetData() - view.GetBegin());
         return true;
     }
 
-    void Document::ToBinary()
+    Status Document::Load(const void* binary, size_t size)
     {
-        std::ostringstream os;
-
-        // serialize root to stream
-        this->WriteValue(os, m_root);
+        View view(binary, size);
+        if (!view.IsValid() && m_validate)
+        {
+            StatsScope scope(*this, size);
+            Status status = m_validator.Validate(binary, size);
+            this->EndPhase(scope.Get(), Phase::Validate);
+            return status;
+        }
+        return this->Load(view);
+    }
 
-        std::string str = os.str();
-        const void* binary = &str[0];
-        size_t size = str.size();
+    Status Document::Load(const View& view)
+    {
+        StatsScope scope(*this, view.GetEnd() - view.GetBegin());
+        Stats* stats = scope.Get();
+        if (m_validate)
+        {
+            Status status = m_validator.Validate(view);
+            if (!status)
+            {
+                return status;
+            }
+            this->EndPhase(stats, Phase::Validate);
+        }
 
-        if (m_binary)
+        Status status = this->ReadRoot(view);
+        if (stats && status)
         {
-            free(m_binary);
-            m_binary = nullptr;
+            this->EndPhase(stats, Phase::Decode);
+            stats->heap_blocks = CollectStats(view, *stats);
+            scope.Succeed(0);
         }
+        return status;
+    }
 
-        m_binary_size = size;
-        if (size > 0)
+    Status Document::ReadRoot(const View& view)
+    {
+        // deserialize the caller's bytes to root in place
+        Cursor cursor;
+        if (!this->OpenBinary(view, cursor))
         {
-            m_binary = malloc(size);
-            memcpy(m_binary, binary, size);
+            return this->Diagnose(view);
         }
+
+        this->ReadValue(cursor, m_root);
+        m_source = View();
+
+        return cursor.IsFailed() ? this->Diagnose(view) : Status();
     }
 
-    std::string Document::ToJson()
+    Status Document::Diagnose(const View& view)
+    {
+        Status status = m_validator.Validate(view);
+        return status ? Status(Error::BadLayout, 0) : status;
+    }
+
+    Status Document::LoadFile(const std::string& path)
     {
-        return m_root.toStyledString();
+        // decoding reads the file front to back once
+        m_view = View();
+        if (!m_file.Open(path, MappedFile::Access::Sequential))
+        {
+            StatsScope scope(*this, 0);
+            return Status(Error::BadFile, 0);
+        }
+
+        m_view = View(m_file.GetData(), m_file.GetSize());
+        return this->Load(m_file.GetData(), m_file.GetSize());
+    }
+
+    bool Document::MapFile(const std::string& path)
+    {
+        // lookups through the view jump around the file
+        m_view = View();
+        if (!m_file.Open(path, MappedFile::Access::Random))
+        {
+            return false;
+        }
+
+        m_view = View(m_file.GetData(), m_file.GetSize());
+        return m_view.Root().IsValid();
+    }
+
+    bool Document::SaveFile(const std::string& path) const
+    {
+        MappedFile file;
+        if (!file.Create(path, m_binary_size))
+        {
+            return false;
+        }
+        if (m_binary_size > 0)
+        {
+            memcpy(file.GetWritableData(), m_binary, m_binary_size);
+        }
+        return true;
+    }
+
+    void Document::DecodeValue(Cursor& cursor, Node& node, Arena& arena)
+    {
+        ValueType type = (ValueType) this->Read<uint8_t>(cursor);
+        if (m_lazy && (type == ValueType::Object || type == ValueType::Array || type == ValueType::TypedArray || type == ValueType::Block))
+        {
+            this->DecodePending(cursor, node, type, arena);
+            return;
+        }
+
+        switch (type)
+        {
+            case ValueType::Object:
+                this->DecodeObject(cursor, node, arena);
+                break;
+            case ValueType::Array:
+                this->DecodeArray(cursor, node, arena);
+                break;
+            case ValueType::TypedArray:
+                this->DecodeTypedArray(cursor, node, arena);
+                break;
+            case ValueType::String:
+            case ValueType::StringRef8:
+            case ValueType::StringRef16:
+            case ValueType::StringRef32:
+                node.m_kind = Kind::String;
+                node.m_string = this->DecodeString(cursor, type, node.m_size, arena);
+                break;
+            case ValueType::Uint8:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<uint8_t>(cursor);
+                break;
+            case ValueType::Int8:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<int8_t>(cursor);
+                break;
+            case ValueType::Uint16:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<uint16_t>(cursor);
+                break;
+            case ValueType::Int16:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<int16_t>(cursor);
+                break;
+            case ValueType::Uint32:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<uint32_t>(cursor);
+                break;
+            case ValueType::Int32:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<int32_t>(cursor);
+                break;
+            case ValueType::Uint64:
+                node.m_kind = Kind::Uint;
+                node.m_u = this->Read<uint64_t>(cursor);
+                break;
+            case ValueType::Int64:
+                node.m_kind = Kind::Int;
+                node.m_int = this->Read<int64_t>(cursor);
+                break;
+            case ValueType::Float:
+                node.m_kind = Kind::Real;
+                node.m_real = this->Read<float>(cursor);
+                break;
+            case ValueType::Double:
+                node.m_kind = Kind::Real;
+                node.m_real = this->Read<double>(cursor);
+                break;
+            case ValueType::Decimal:
+            {
+                const uint8_t* payload = cursor.ReadBytes(5);
+                node.m_kind = Kind::Real;
+                node.m_real = payload ? LoadDecimal(payload) : 0.0;
+                break;
+            }
+            case ValueType::Bool:
+                node.m_kind = Kind::Bool;
+                node.m_bool = this->Read<int8_t>(cursor) == 1;
+                break;
+            case ValueType::Null:
+                node.m_kind = Kind::Null;
+                break;
+            case ValueType::Block:
+            {
+                BufferWriter raw;
+                Cursor block;
+                if (OpenBlock(cursor, raw, block))
+                {
+                    this->DecodeValue(block, node, arena);
+                    if (block.IsFailed())
+                    {
+                        cursor.Fail();
+                    }
+                }
+                break;
+            }
+            default:
+                cursor.Fail();
+                break;
+        }
+    }
+
+    void Document::DecodeObject(Cursor& cursor, Node& node, Arena& arena)
+    {
+        size_t end_pos = 0;
+        int value_count = this->ReadContainerCount(cursor, end_pos);
+        // every member takes at least a key tag, a length and a value tag
+        if ((size_t) value_count > cursor.GetRemaining() / 3)
+        {
+            cursor.Fail();
+            return;
+        }
+
+        Node::Member* members = arena.Allocate<Node::Member>(value_count);
+        bool sorted = true;
+        std::vector<size_t> runs;
+        if (!m_lazy && this->SplitChildren(cursor, end_pos, value_count, runs))
+        {
+            this->DecodeChildren(cursor, end_pos, runs, value_count, nullptr, members);
+            for (int i = 1; i < value_count && sorted && !cursor.IsFailed(); ++i)
+            {
+                sorted = KeyLess(members[i - 1], members[i]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < value_count && !cursor.IsFailed(); ++i)
+            {
+                this->DecodeMember(cursor, members[i], arena);
+                if (i > 0 && sorted)
+                {
+                    sorted = KeyLess(members[i - 1], members[i]);
+                }
+            }
+        }
+        if (cursor.IsFailed())
+        {
+            return;
+        }
+        if (m_version >= 2)
+        {
+            cursor.Seek(end_pos);
+        }
+
+        // v2 members come sorted, v1 members are sorted here with the last duplicate kept
+        if (!sorted)
+        {
+            std::stable_sort(members, members + value_count, KeyLess);
+            int count = 0;
+            for (int i = 0; i < value_count; ++i)
+            {
+                if (i + 1 < value_count && !KeyLess(members[i], members[i + 1]))
+                {
+                    continue;
+                }
+                members[count++] = members[i];
+            }
+            value_count = count;
+        }
+
+        node.m_kind = Kind::Object;
+        node.m_size = (uint32_t) value_count;
+        node.m_members = members;
+    }
+
+    void Document::DecodeMember(Cursor& cursor, Node::Member& member, Arena& arena)
+    {
+        ValueType key_type = (ValueType) this->Read<uint8_t>(cursor);
+        member.key = this->DecodeString(cursor, key_type, member.key_size, arena);
+        new (&member.value) Node();
+        this->DecodeValue(cursor, member.value, arena);
+    }
+
+    void Document::DecodeArray(Cursor& cursor, Node& node, Arena& arena)
+    {
+        size_t end_pos = 0;
+        int value_count = this->ReadContainerCount(cursor, end_pos);
+        if ((size_t) value_count > cursor.GetRemaining())
+        {
+            cursor.Fail();
+            return;
+        }
+
+        Node* elements = arena.Allocate<Node>(value_count);
+        std::vector<size_t> runs;
+        if (!m_lazy && this->SplitChildren(cursor, end_pos, value_count, runs))
+        {
+            this->DecodeChildren(cursor, end_pos, runs, value_count, elements, nullptr);
+        }
+        else
+        {
+            for (int i = 0; i < value_count && !cursor.IsFailed(); ++i)
+            {
+                new (&elements[i]) Node();
+                this->DecodeValue(cursor, elements[i], arena);
+            }
+        }
+        if (m_version >= 2)
+        {
+            cursor.Seek(end_pos);
+        }
+
+        node.m_kind = Kind::Array;
+        node.m_size = (uint32_t) value_count;
+        node.m_elements = elements;
+    }
+
+    void Document::DecodeChildren(Cursor& cursor, size_t end_pos, const std::vector<size_t>& runs, size_t count, Node* elements, Node::Member* members)
+    {
+        // every task allocates from the arena of the thread it runs on
+        std::atomic<bool> failed(false);
+        ThreadPool::Group group;
+        for (size_t k = 0; k < runs.size(); ++k)
+        {
+            size_t first = runs[k];
+            size_t last = k + 1 < runs.size() ? runs[k + 1] : count;
+            m_pool->Run(group, [this, &cursor, &failed, end_pos, count, first, last, elements, members]() {
+                Arena& arena = this->GetArena();
+                Cursor run = cursor;
+                run.Seek(ChildPos(cursor, end_pos, count, first));
+                for (size_t i = first; i < last && !run.IsFailed(); ++i)
+                {
+                    if (members)
+                    {
+                        this->DecodeMember(run, members[i], arena);
+                    }
+                    else
+                    {
+                        new (&elements[i]) Node();
+                        this->DecodeValue(run, elements[i], arena);
+                    }
+                }
+                if (run.IsFailed())
+                {
+                    failed = true;
+                }
+            });
+        }
+        m_pool->Wait(group);
+
+        if (failed)
+        {
+            cursor.Fail();
+        }
+    }
+
+    void Document::DecodeTypedArray(Cursor& cursor, Node& node, Arena& arena)
+    {
+        ValueType type = ValueType::Null;
+        size_t count = 0;
+        const uint8_t* data = this->ReadTypedElements(cursor, type, count);
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        Node* elements = arena.Allocate<Node>(count);
+        int size = ScalarSize(type);
+        Kind kind = type == ValueType::Uint64 ? Kind::Uint : Kind::Int;
+        for (size_t i = 0; i < count; i += CONVERT_BLOCK)
+        {
+            size_t block = std::min(count - i, CONVERT_BLOCK);
+            Node* nodes = elements + i;
+            if (IsReal(type))
+            {
+                double reals[CONVERT_BLOCK];
+                ConvertToDouble(type, data + i * size, reals, block);
+                for (size_t j = 0; j < block; ++j)
+                {
+                    nodes[j].m_kind = Kind::Real;
+                    nodes[j].m_lazy = false;
+                    nodes[j].m_size = 0;
+                    nodes[j].m_real = reals[j];
+                }
+            }
+            else
+            {
+                int64_t ints[CONVERT_BLOCK];
+                ConvertToInt64(type, data + i * size, ints, block);
+                for (size_t j = 0; j < block; ++j)
+                {
+                    nodes[j].m_kind = kind;
+                    nodes[j].m_lazy = false;
+                    nodes[j].m_size = 0;
+                    nodes[j].m_int = ints[j];
+                }
+            }
+        }
+
+        node.m_kind = Kind::Array;
+        node.m_size = (uint32_t) count;
+        node.m_elements = elements;
+    }
+
+    void Document::DecodePending(Cursor& cursor, Node& node, ValueType type, Arena& arena)
+    {
+        const uint8_t* data = cursor.GetPos() - 1;
+        size_t count = 0;
+        if (type == ValueType::Block)
+        {
+            // stays compressed until it is expanded
+            Block b;
+            if (!ReadBlock(data, cursor.GetEnd(), b))
+            {
+                cursor.Fail();
+                return;
+            }
+            count = b.count;
+            type = b.type;
+            cursor.Seek(b.end - cursor.GetBegin());
+        }
+        else if (type == ValueType::TypedArray)
+        {
+            TypedArray a;
+            if (!jsonb::ReadTypedArray(data, cursor.GetEnd(), a))
+            {
+                cursor.Fail();
+                return;
+            }
+            count = a.count;
+            cursor.Seek(a.end - cursor.GetBegin());
+        }
+        else
+        {
+            // the count sits in the trailer, the size steps over the whole body
+            size_t end_pos = 0;
+            count = this->ReadContainerCount(cursor, end_pos);
+            cursor.Seek(end_pos);
+        }
+        if (cursor.IsFailed())
+        {
+            return;
+        }
+
+        Node::Pending* pending = arena.Allocate<Node::Pending>(1);
+        pending->data = data;
+        pending->end = cursor.GetEnd();
+        pending->document = this;
+        node.m_kind = type == ValueType::Object ? Kind::Object : Kind::Array;
+        node.m_lazy = true;
+        node.m_size = (uint32_t) count;
+        node.m_pending = pending;
+    }
+
+    void Document::Expand(Node& node)
+    {
+        // decodes one level, containers among the children become placeholders in turn.
+        // a Load since the tree was decoded may have opened another buffer
+        m_source = m_tree_source;
+        m_version = m_source.GetVersion();
+        const uint8_t* data = node.m_pending->data;
+        const uint8_t* end = node.m_pending->end;
+        node.m_lazy = false;
+        if ((ValueType) *data == ValueType::Block)
+        {
+            // decompressed to the arena, the placeholders of its containers point there
+            Block b;
+            uint8_t* raw = nullptr;
+            if (ReadBlock(data, end, b))
+            {
+                raw = (uint8_t*) m_arena.Allocate(b.phase + b.raw_size, 8) + b.phase;
+            }
+            if (raw == nullptr || !lz::Decompress(b.data, b.size, raw, b.raw_size) || raw[0] != (uint8_t) b.type)
+            {
+                node.m_size = 0;
+                node.m_elements = nullptr;
+                return;
+            }
+            data = raw;
+            end = raw + b.raw_size;
+        }
+        Cursor cursor(data, end - data);
+        cursor.Seek(1);
+        ValueType type = (ValueType) *data;
+        switch (type)
+        {
+            case ValueType::Object:
+                this->DecodeObject(cursor, node, m_arena);
+                break;
+            case ValueType::Array:
+                this->DecodeArray(cursor, node, m_arena);
+                break;
+            default:
+                this->DecodeTypedArray(cursor, node, m_arena);
+                break;
+        }
+        if (cursor.IsFailed())
+        {
+            node.m_size = 0;
+            node.m_elements = nullptr;
+        }
+    }
+
+    const char* Document::DecodeString(Cursor& cursor, ValueType type, uint32_t& size, Arena& arena)
+    {
+        // dictionary strings were copied once, every reference shares that copy
+        if (IsStringRef(type))
+        {
+            uint32_t index = this->ReadStringRef(cursor, type);
+            std::string_view str = cursor.IsFailed() ? std::string_view("") : m_strings[index];
+            size = (uint32_t) str.size();
+            return str.data();
+        }
+
+        std::string_view bytes = this->ReadString(cursor, type);
+        if (cursor.IsFailed())
+        {
+            size = 0;
+            return "";
+        }
+
+        // copies are null terminated so they can be handed to C apis
+        char* str = arena.Allocate<char>(bytes.size() + 1);
+        memcpy(str, bytes.data(), bytes.size());
+        str[bytes.size()] = 0;
+        size = (uint32_t) bytes.size();
+        return str;
+    }
+
+    Status Document::Decode(const void* binary, size_t size)
+    {
+        View view(binary, size);
+        if (!view.IsValid() && m_validate)
+        {
+            StatsScope scope(*this, size);
+            m_tree = Node();
+            Status status = m_validator.Validate(binary, size);
+            this->EndPhase(scope.Get(), Phase::Validate);
+            return status;
+        }
+        return this->Decode(view);
+    }
+
+    Status Document::Decode(const View& view)
+    {
+        StatsScope scope(*this, view.GetEnd() - view.GetBegin());
+        Stats* stats = scope.Get();
+        m_tree = Node();
+        if (m_reuse_arena)
+        {
+            m_arena.Reset();
+            for (auto& worker : m_workers)
+            {
+                worker->arena.Reset();
+            }
+        }
+        else
+        {
+            m_arena.Clear();
+            for (auto& worker : m_workers)
+            {
+                worker->arena.Clear();
+            }
+        }
+
+        m_lazy = false;
+        if (m_validate)
+        {
+            Status status = m_validator.Validate(view);
+            if (!status)
+            {
+                return status;
+            }
+            this->EndPhase(stats, Phase::Validate);
+        }
+        Cursor cursor;
+        if (!this->OpenBinary(view, cursor))
+        {
+            return this->Diagnose(view);
+        }
+
+        // v1 containers have no byte size to skip them with
+        m_lazy = m_lazy_decode && m_version >= 2;
+        if (!m_lazy)
+        {
+            // the tree takes about twice the binary, get it in one chunk
+            m_arena.Reserve((view.GetEnd() - view.GetBegin()) * 2);
+        }
+
+        m_strings.resize(m_source.GetStringCount());
+        for (size_t i = 0; i < m_strings.size(); ++i)
+        {
+            std::string_view str = m_source.GetString(i);
+            char* copy = m_arena.Allocate<char>(str.size() + 1);
+            memcpy(copy, str.data(), str.size());
+            copy[str.size()] = 0;
+            m_strings[i] = std::string_view(copy, str.size());
+        }
+
+        this->DecodeValue(cursor, m_tree, m_arena);
+        m_tree_source = m_lazy ? m_source : View();
+        m_source = View();
+        if (cursor.IsFailed())
+        {
+            m_tree = Node();
+            m_lazy = false;
+            return this->Diagnose(view);
+        }
+
+        if (stats)
+        {
+            this->EndPhase(stats, Phase::Decode);
+            CollectStats(view, *stats);
+            stats->heap_blocks = m_arena.GetChunkCount();
+            for (auto& worker : m_workers)
+            {
+                stats->heap_blocks += worker->arena.GetChunkCount();
+            }
+            scope.Succeed(0);
+        }
+        return Status();
+    }
+
+    bool Document::ToBinary()
+    {
+        StatsScope scope(*this, 0);
+        Stats* stats = scope.Get();
+        BufferWriter writer;
+
+        // the previous output is a good guess for the size of the next one
+        writer.Reserve(std::max(m_binary_size, (size_t) 4096));
+
+        encoder::WriteHeader(writer);
+
+        // serialize root to buffer, with a pool big trees are written by tasks
+        Worker& worker = *m_workers[0];
+        size_t root_pos = writer.GetSize();
+        size_t typed_arrays = worker.typed_arrays;
+        bool split = m_pool && CountValues(m_root, PARALLEL_VALUES) >= PARALLEL_VALUES;
+        this->WriteValue(writer, m_root, worker, split);
+
+        if (!FitsContainerSize(writer, root_pos))
+        {
+            if (m_binary)
+            {
+                free(m_binary);
+                m_binary = nullptr;
+            }
+            m_binary_size = 0;
+            return false;
+        }
+
+        // the tasks' typed arrays moved with their chunks, one pass puts them where one thread would have
+        if (split && worker.typed_arrays != typed_arrays)
+        {
+            encoder::AlignTypedArrays(writer.GetData(), root_pos);
+        }
+        this->EndPhase(stats, Phase::Encode);
+
+        this->SetBinary(writer, stats);
+        scope.Succeed(m_binary_size);
+        return true;
+    }
+
+    bool Document::Encode(std::string_view json)
+    {
+        StatsScope scope(*this, json.size());
+        Stats* stats = scope.Get();
+        BufferWriter writer;
+        writer.Reserve(std::max(m_binary_size, json.size() / 2));
+
+        if (!m_transcoder.Transcode(json.data(), json.size(), writer))
+        {
+            return false;
+        }
+        this->EndPhase(stats, Phase::Parse);
+
+        this->SetBinary(writer, stats);
+        scope.Succeed(m_binary_size);
+
+        return true;
+    }
+
+    void Document::SetBinary(BufferWriter& writer, Stats* stats)
+    {
+        if (m_binary)
+        {
+            free(m_binary);
+            m_binary = nullptr;
+        }
+
+        // the dictionary is built from the finished encoding, it needs every key up front
+        BufferWriter* output = &writer;
+        BufferWriter dictionary_writer;
+        if (m_dictionary_mode != DictionaryMode::None)
+        {
+            dictionary_writer.Reserve(writer.GetSize());
+            View view(writer.GetData(), writer.GetSize());
+            m_dictionary_writer.Write(view, m_dictionary_mode == DictionaryMode::KeysAndStrings, dictionary_writer);
+            output = &dictionary_writer;
+            this->EndPhase(stats, Phase::Dictionary);
+        }
+
+        // blocks are compressed last, with the dictionary references in them
+        if (m_compression_level > 0)
+        {
+            BufferWriter block_writer;
+            block_writer.Reserve(output->GetSize() / 2);
+            BlockWriter blocks;
+            blocks.Write(View(output->GetData(), output->GetSize()), m_compression_level, block_writer);
+            m_binary = block_writer.Release(m_binary_size);
+            this->EndPhase(stats, Phase::Compress);
+        }
+        else
+        {
+            // hand the buffer over without copying it
+            m_binary = output->Release(m_binary_size);
+        }
+
+        if (stats)
+        {
+            // counted from what was written, with dictionary references and blocks
+            CollectStats(View(m_binary, m_binary_size), *stats);
+            stats->heap_blocks = 1;
+        }
+    }
+
+    std::string Document::ToJson()
+    {
+        // written the same way as by ToBinary and emitted from there, without a dictionary or blocks
+        StatsScope scope(*this, 0);
+        Stats* stats = scope.Get();
+        BufferWriter writer;
+        encoder::WriteHeader(writer);
+        this->WriteValue(writer, m_root, *m_workers[0], false);
+        if (!FitsContainerSize(writer, HEADER_SIZE))
+        {
+            return std::string();
+        }
+        this->EndPhase(stats, Phase::Encode);
+
+        BufferWriter text;
+        JsonEmitter emitter;
+        emitter.SetPretty(true);
+        View view(writer.GetData(), writer.GetSize());
+        emitter.Emit(view, text);
+        std::string json((const char*) text.GetData(), text.GetSize());
+        if (stats)
+        {
+            this->EndPhase(stats, Phase::Emit);
+            CollectStats(view, *stats);
+            // the binary, the text and the string
+            stats->heap_blocks = 3;
+            scope.Succeed(json.size());
+        }
+        return json;
+    }
+
+    Document::StatsScope::StatsScope(Document& doc, uint64_t input_bytes):
+        m_doc(doc),
+        m_stats(doc.BeginStats(input_bytes)),
+        m_succeeded(false)
+    {
+
+    }
+
+    Document::StatsScope::~StatsScope()
+    {
+        if (m_stats)
+        {
+            m_doc.EndStats(m_stats, m_succeeded);
+        }
+    }
+
+    void Document::StatsScope::Succeed(uint64_t output_bytes)
+    {
+        if (m_stats)
+        {
+            m_stats->output_bytes = output_bytes;
+            m_succeeded = true;
+        }
+    }
+
+    Stats* Document::BeginStats(uint64_t input_bytes)
+    {
+        if (!STATS_ENABLED)
+        {
+            return nullptr;
+        }
+        Stats* stats = m_stats ? m_stats : m_trace_hook ? &m_trace_stats : nullptr;
+        if (stats)
+        {
+            *stats = Stats();
+            stats->input_bytes = input_bytes;
+            m_phase_begin = Now();
+        }
+        return stats;
+    }
+
+    void Document::EndPhase(Stats* stats, Phase phase)
+    {
+        if (!stats)
+        {
+            return;
+        }
+        uint64_t now = Now();
+        stats->nanoseconds[(size_t) phase] += now - m_phase_begin;
+        if (m_trace_hook)
+        {
+            m_trace_hook(m_trace_context, phase, *stats);
+        }
+        // the hook's time is not part of the next phase
+        m_phase_begin = Now();
+    }
+
+    void Document::EndStats(Stats* stats, bool succeeded)
+    {
+        stats->failed = !succeeded;
+        if (m_trace_hook)
+        {
+            m_trace_hook(m_trace_context, Phase::Done, *stats);
+        }
     }
 }
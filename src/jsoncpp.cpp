@@ -0,0 +1,110 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsoncpp.h>
+
+namespace jsonb
+{
+    Value FromJsonCpp(const Json::Value& value)
+    {
+        switch (value.type())
+        {
+        case Json::ValueType::objectValue:
+        {
+            Value obj(Kind::Object);
+            obj.Reserve(value.size());
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                const char* key_end = nullptr;
+                const char* key = i.memberName(&key_end);
+                obj[std::string_view(key, key_end - key)] = FromJsonCpp(*i);
+            }
+            return obj;
+        }
+        case Json::ValueType::arrayValue:
+        {
+            Value arr(Kind::Array);
+            arr.Reserve(value.size());
+            for (const Json::Value& element : value)
+            {
+                arr.Append(FromJsonCpp(element));
+            }
+            return arr;
+        }
+        case Json::ValueType::stringValue:
+        {
+            const char* begin = nullptr;
+            const char* end = nullptr;
+            value.getString(&begin, &end);
+            return Value(std::string_view(begin, end - begin));
+        }
+        case Json::ValueType::intValue:
+            return Value((long long) value.asLargestInt());
+        case Json::ValueType::uintValue:
+            return Value((unsigned long long) value.asLargestUInt());
+        case Json::ValueType::realValue:
+            return Value(value.asDouble());
+        case Json::ValueType::booleanValue:
+            return Value(value.asBool());
+        default:
+            return Value();
+        }
+    }
+
+    Json::Value ToJsonCpp(const Value& value)
+    {
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+        {
+            Json::Value obj(Json::ValueType::objectValue);
+            for (size_t i = 0; i < value.Size(); ++i)
+            {
+                std::string_view key = value.GetKey(i);
+                obj[std::string(key)] = ToJsonCpp(value[i]);
+            }
+            return obj;
+        }
+        case Kind::Array:
+        {
+            Json::Value arr(Json::ValueType::arrayValue);
+            arr.resize((Json::ArrayIndex) value.Size());
+            for (size_t i = 0; i < value.Size(); ++i)
+            {
+                arr[(Json::ArrayIndex) i] = ToJsonCpp(value[i]);
+            }
+            return arr;
+        }
+        case Kind::String:
+        {
+            std::string_view str = value.AsString();
+            return Json::Value(str.data(), str.data() + str.size());
+        }
+        case Kind::Int:
+            return Json::Value((Json::Int64) value.AsInt64());
+        case Kind::Uint:
+            return Json::Value((Json::UInt64) value.AsUint64());
+        case Kind::Real:
+            return Json::Value(value.AsDouble());
+        case Kind::Bool:
+            return Json::Value(value.AsBool());
+        default:
+            return Json::Value();
+        }
+    }
+}
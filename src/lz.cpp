@@ -0,0 +1,332 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "lz.h"
+#include <algorithm>
+#include <string.h>
+
+namespace jsonb
+{
+    namespace lz
+    {
+        namespace
+        {
+            const size_t MIN_MATCH = 4;
+            // the format ends every block with literals, and no match starts in its last 12 bytes
+            const size_t LAST_LITERALS = 5;
+            const size_t MATCH_LIMIT = 12;
+            const size_t MAX_OFFSET = 65535;
+            const int MIN_HASH_BITS = 10;
+            const int MAX_HASH_BITS = 16;
+
+            inline uint32_t Load32(const uint8_t* p)
+            {
+                uint32_t v;
+                memcpy(&v, p, sizeof(v));
+                return v;
+            }
+
+            inline uint32_t Hash(const uint8_t* p, int bits)
+            {
+                return (Load32(p) * 2654435761u) >> (32 - bits);
+            }
+
+            inline size_t MatchLength(const uint8_t* a, const uint8_t* b, const uint8_t* end)
+            {
+                const uint8_t* start = b;
+                while (end - b >= 8)
+                {
+                    uint64_t x;
+                    uint64_t y;
+                    memcpy(&x, a, sizeof(x));
+                    memcpy(&y, b, sizeof(y));
+                    if (x != y)
+                    {
+                        // little endian, the lowest differing byte ends the match
+                        uint64_t diff = x ^ y;
+                        size_t same = 0;
+                        while ((diff & 0xff) == 0)
+                        {
+                            diff >>= 8;
+                            ++same;
+                        }
+                        return b - start + same;
+                    }
+                    a += 8;
+                    b += 8;
+                }
+                while (b < end && *a == *b)
+                {
+                    ++a;
+                    ++b;
+                }
+                return b - start;
+            }
+
+            inline uint8_t* WriteLength(uint8_t* op, size_t length)
+            {
+                while (length >= 255)
+                {
+                    *op++ = 255;
+                    length -= 255;
+                }
+                *op++ = (uint8_t) length;
+                return op;
+            }
+
+            uint8_t* WriteSequence(uint8_t* op, const uint8_t* literals, size_t literal_size, size_t offset, size_t match_size)
+            {
+                uint8_t* token = op++;
+                *token = (uint8_t) (std::min(literal_size, (size_t) 15) << 4);
+                if (literal_size >= 15)
+                {
+                    op = WriteLength(op, literal_size - 15);
+                }
+                memcpy(op, literals, literal_size);
+                op += literal_size;
+                if (match_size == 0)
+                {
+                    return op;
+                }
+
+                *op++ = (uint8_t) offset;
+                *op++ = (uint8_t) (offset >> 8);
+                size_t length = match_size - MIN_MATCH;
+                *token |= (uint8_t) std::min(length, (size_t) 15);
+                if (length >= 15)
+                {
+                    op = WriteLength(op, length - 15);
+                }
+                return op;
+            }
+
+            inline bool ReadLength(const uint8_t*& ip, const uint8_t* iend, size_t& length)
+            {
+                uint8_t b;
+                do
+                {
+                    if (ip == iend)
+                    {
+                        return false;
+                    }
+                    b = *ip++;
+                    length += b;
+                } while (b == 255);
+                return true;
+            }
+        }
+
+        size_t GetBound(size_t size)
+        {
+            return size + size / 255 + 16;
+        }
+
+        size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, int level, std::vector<uint32_t>& tables)
+        {
+            level = std::max(MIN_LEVEL, std::min(level, MAX_LEVEL));
+            size_t depth = (size_t) 1 << (level - 1);
+            bool chain = level > 1;
+
+            // head holds the position + 1 of the last occurrence of each hash, prev the distance back
+            // to the one before for levels above 1. small inputs clear small tables
+            int bits = MIN_HASH_BITS;
+            while (bits < MAX_HASH_BITS && ((size_t) 1 << bits) < size)
+            {
+                ++bits;
+            }
+            size_t hash_size = (size_t) 1 << bits;
+            size_t chain_mask = std::min(hash_size, MAX_OFFSET + 1) - 1;
+            tables.assign(hash_size + (chain ? chain_mask + 1 : 0), 0);
+            uint32_t* head = tables.data();
+            uint32_t* prev = chain ? head + hash_size : nullptr;
+
+            uint8_t* op = dst;
+            size_t anchor = 0;
+            size_t ip = 0;
+            size_t match_end = size > LAST_LITERALS ? size - LAST_LITERALS : 0;
+            size_t last_start = size > MATCH_LIMIT ? size - MATCH_LIMIT : 0;
+
+            auto insert = [&](size_t pos)
+            {
+                uint32_t h = Hash(src + pos, bits);
+                if (chain)
+                {
+                    size_t last = head[h];
+                    size_t distance = last ? pos + 1 - last : 0;
+                    prev[pos & chain_mask] = distance <= MAX_OFFSET ? (uint32_t) distance : 0;
+                }
+                head[h] = (uint32_t) (pos + 1);
+            };
+
+            while (ip < last_start)
+            {
+                size_t best_size = 0;
+                size_t best_offset = 0;
+                size_t candidate = head[Hash(src + ip, bits)];
+                for (size_t i = 0; i < depth && candidate != 0; ++i)
+                {
+                    size_t pos = candidate - 1;
+                    if (ip - pos > MAX_OFFSET)
+                    {
+                        break;
+                    }
+                    if (Load32(src + pos) == Load32(src + ip))
+                    {
+                        size_t match_size = MIN_MATCH + MatchLength(src + pos + MIN_MATCH, src + ip + MIN_MATCH, src + match_end);
+                        if (match_size > best_size)
+                        {
+                            best_size = match_size;
+                            best_offset = ip - pos;
+                        }
+                    }
+                    if (!chain || prev[pos & chain_mask] == 0)
+                    {
+                        break;
+                    }
+                    candidate = pos + 1 - prev[pos & chain_mask];
+                }
+                insert(ip);
+
+                if (best_size < MIN_MATCH)
+                {
+                    // level 1 strides faster over data that does not compress
+                    ip += chain ? 1 : 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+
+                op = WriteSequence(op, src + anchor, ip - anchor, best_offset, best_size);
+                size_t next = ip + best_size;
+                if (chain)
+                {
+                    for (size_t pos = ip + 1; pos < next && pos < last_start; ++pos)
+                    {
+                        insert(pos);
+                    }
+                }
+                else if (next - 2 < last_start)
+                {
+                    insert(next - 2);
+                }
+                ip = next;
+                anchor = ip;
+            }
+
+            op = WriteSequence(op, src + anchor, size - anchor, 0, 0);
+            return op - dst;
+        }
+
+        bool Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size)
+        {
+            const uint8_t* ip = src;
+            const uint8_t* iend = src + size;
+            uint8_t* op = dst;
+            uint8_t* oend = dst + dst_size;
+            while (ip < iend)
+            {
+                uint8_t token = *ip++;
+                size_t literal_size = token >> 4;
+                if (literal_size == 15 && !ReadLength(ip, iend, literal_size))
+                {
+                    return false;
+                }
+                if ((size_t) (iend - ip) < literal_size || (size_t) (oend - op) < literal_size)
+                {
+                    return false;
+                }
+                if (literal_size <= 16 && iend - ip >= 16 && oend - op >= 16)
+                {
+                    // most runs are short, a fixed size copy beats a call
+                    memcpy(op, ip, 16);
+                }
+                else
+                {
+                    memcpy(op, ip, literal_size);
+                }
+                ip += literal_size;
+                op += literal_size;
+                if (ip == iend)
+                {
+                    // the last sequence is literals only
+                    return op == oend;
+                }
+
+                if (iend - ip < 2)
+                {
+                    return false;
+                }
+                size_t offset = ip[0] | (size_t) ip[1] << 8;
+                ip += 2;
+                size_t match_size = token & 15;
+                if (match_size == 15 && !ReadLength(ip, iend, match_size))
+                {
+                    return false;
+                }
+                match_size += MIN_MATCH;
+                if (offset == 0 || offset > (size_t) (op - dst) || (size_t) (oend - op) < match_size)
+                {
+                    return false;
+                }
+
+                const uint8_t* match = op - offset;
+                uint8_t* end = op + match_size;
+                if ((size_t) (oend - end) < 16)
+                {
+                    for (size_t i = 0; i < match_size; ++i)
+                    {
+                        op[i] = match[i];
+                    }
+                    op = end;
+                    continue;
+                }
+
+                // copies in chunks may run past the match into room that is written next anyway
+                if (offset >= 16)
+                {
+                    do
+                    {
+                        memcpy(op, match, 16);
+                        op += 16;
+                        match += 16;
+                    } while (op < end);
+                }
+                else
+                {
+                    if (offset < 8)
+                    {
+                        // a short repeating pattern, once 8 bytes of it are out an earlier
+                        // copy of it lies a multiple of offset back and at least 8 bytes away
+                        for (int i = 0; i < 8; ++i)
+                        {
+                            op[i] = match[i];
+                        }
+                        op += 8;
+                        match = op - (8 + offset - 1) / offset * offset;
+                    }
+                    while (op < end)
+                    {
+                        memcpy(op, match, 8);
+                        op += 8;
+                        match += 8;
+                    }
+                }
+                op = end;
+            }
+            return false;
+        }
+    }
+}
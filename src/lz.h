@@ -0,0 +1,42 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace jsonb
+{
+    // compressor and decompressor for the lz4 block format, blocks read back with any lz4 decoder
+    namespace lz
+    {
+        constexpr int MIN_LEVEL = 1;
+        constexpr int MAX_LEVEL = 9;
+
+        // most bytes Compress writes for size input bytes
+        size_t GetBound(size_t size);
+        // compresses size bytes to dst, which holds GetBound(size) bytes, and returns the compressed size.
+        // level 1 takes the first match it finds, higher levels search up to 2^(level - 1) earlier
+        // positions for the longest one. tables is kept between calls to save allocating it
+        size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, int level, std::vector<uint32_t>& tables);
+        // false if src is not a block that decompresses to exactly dst_size bytes
+        bool Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
+    }
+}
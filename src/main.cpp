@@ -16,108 +16,759 @@
 */
 
 #include <jsonb/jsonb.h>
-#include <fstream>
+#include <jsonb/emitter.h>
+#include <jsonb/stream.h>
+#include <jsonb/patch.h>
+#include <jsonb/diff.h>
+#include "thread_pool.h"
+#ifdef JSONB_WITH_JSONCPP
+#include <jsonb/jsoncpp.h>
+#endif
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <thread>
+#include <cmath>
+#include <filesystem>
+#include <memory>
 
-int main(int argc, char* argv[])
+#ifdef JSONB_WITH_JSONCPP
+// compares a decoded value with the parsed text, reals bit for bit, prints the first difference
+static bool SameValue(const jsonb::Value& a, const jsonb::Value& b, const std::string& path)
 {
-    if (argc != 4)
+    bool same = true;
+    bool a_real = a.GetKind() == jsonb::Kind::Real;
+    bool b_real = b.GetKind() == jsonb::Kind::Real;
+    if (a.IsNumber() && b.IsNumber() && a_real == b_real)
     {
-        printf("Usage:\n");
-        printf("\tjsonb.exe -b input.json output.jsonb\n");
-        printf("\tjsonb.exe -t input.jsonb output.json\n");
-        return 0;
+        if (a_real)
+        {
+            double x = a.AsDouble();
+            double y = b.AsDouble();
+            same = memcmp(&x, &y, sizeof(x)) == 0 || (std::isnan(x) && std::isnan(y));
+        }
+        else
+        {
+            // int and uint are the same number when both types can hold it
+            same = a == b;
+        }
+    }
+    else if (a.GetKind() != b.GetKind() || a.Size() != b.Size())
+    {
+        same = false;
+    }
+    else if (a.IsObject())
+    {
+        // members of both are sorted by key
+        for (size_t i = 0; i < a.Size(); ++i)
+        {
+            std::string key(a.GetKey(i));
+            if (b.GetKey(i) != key)
+            {
+                same = false;
+                break;
+            }
+            if (!SameValue(a[i], b[i], path + "/" + key))
+            {
+                return false;
+            }
+        }
+    }
+    else if (a.IsArray())
+    {
+        for (size_t i = 0; i < a.Size(); ++i)
+        {
+            if (!SameValue(a[i], b[i], path + "/" + std::to_string(i)))
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        same = a == b;
     }
 
-    std::string conv = argv[1];
-    std::string input = argv[2];
-    std::string output = argv[3];
-
-    bool to_text = false;
-    if (conv == "-t")
+    if (!same)
     {
-        to_text = true;
+        printf("mismatch at %s: %s != %s\n", path.empty() ? "/" : path.c_str(),
+            jsonb::ToJsonCpp(a).toStyledString().c_str(), jsonb::ToJsonCpp(b).toStyledString().c_str());
     }
+    return same;
+}
 
-    std::string input_buffer;
-    std::ifstream is(input, std::ios::binary | std::ios::in);
-    if (is)
+// parses with jsoncpp, independent of the encoder that is checked
+static bool ParseJson(std::string_view json, jsonb::Value& value)
+{
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errs;
+    Json::Value parsed;
+    if (!reader->parse(json.data(), json.data() + json.size(), &parsed, &errs))
     {
-        is.seekg(0, std::ios::end);
-        size_t size = (size_t) is.tellg();
-        is.seekg(std::ios::beg);
+        return false;
+    }
+    value = jsonb::FromJsonCpp(parsed);
+    return true;
+}
 
-        input_buffer.resize(size);
-        is.read(&input_buffer[0], size);
+// encodes json, then checks the binary read back and the text emitted from it against the original
+static int Verify(std::string_view json, bool dictionary)
+{
+    jsonb::Value expected;
+    if (!ParseJson(json, expected))
+    {
+        printf("invalid json\n");
+        return 1;
+    }
 
-        is.close();
+    jsonb::Document doc;
+    if (dictionary)
+    {
+        doc.SetDictionaryMode(jsonb::DictionaryMode::KeysAndStrings);
     }
-    else
+    if (!doc.Encode(json))
     {
-        return 0;
+        printf("encode failed\n");
+        return 1;
+    }
+    std::string binary((const char*) doc.GetBinary(), doc.GetBinarySize());
+
+    jsonb::Document decoded;
+    if (!decoded.Load(binary.data(), binary.size()) || !SameValue(decoded.GetRoot(), expected, ""))
+    {
+        printf("binary does not round trip\n");
+        return 1;
     }
 
-#define BENCHMARK 0
-#if BENCHMARK
+    jsonb::BufferWriter text;
+    jsonb::JsonEmitter emitter;
+    jsonb::Value actual;
+    if (!emitter.Emit(jsonb::View(binary.data(), binary.size()), text) ||
+        !ParseJson(std::string_view((const char*) text.GetData(), text.GetSize()), actual) || !SameValue(actual, expected, ""))
     {
-        auto t = std::chrono::system_clock::now();
+        printf("emitted text does not round trip\n");
+        return 1;
+    }
+
+    printf("ok: %zu bytes of json, %zu bytes of jsonb\n", json.size(), binary.size());
+    return 0;
+}
+#endif
 
-        if (to_text)
+// calls f with each non-blank line of ndjson text, stops on the first false
+template <class F>
+static bool ForEachLine(std::string_view text, F f)
+{
+    while (!text.empty())
+    {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+        {
+            line.remove_suffix(1);
+        }
+        if (line.find_first_not_of(" \t") != std::string_view::npos && !f(line))
         {
-            jsonb::Document doc;
-            for (int i = 0; i < 100; ++i)
+            return false;
+        }
+    }
+    return true;
+}
+
+// encodes every line of ndjson as a record of a stream, with shared keys a first pass collects them
+static int WriteStream(std::string_view ndjson, const std::string& output, bool dictionary)
+{
+    jsonb::StreamWriter stream;
+    size_t line_count = 0;
+    if (dictionary)
+    {
+        jsonb::Document doc;
+        bool result = ForEachLine(ndjson, [&](std::string_view line) {
+            ++line_count;
+            if (!doc.Encode(line))
             {
-                doc.Load((const void*) &input_buffer[0], input_buffer.size());
+                return false;
             }
+            stream.AddDictionaryKeys(jsonb::View(doc.GetBinary(), doc.GetBinarySize()));
+            return true;
+        });
+        if (!result)
+        {
+            printf("invalid json on line %zu\n", line_count);
+            return 1;
         }
-        else
+    }
+
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return 1;
+    }
+    stream.Begin(file);
+    line_count = 0;
+    bool result = ForEachLine(ndjson, [&](std::string_view line) {
+        ++line_count;
+        return stream.Add(line);
+    });
+    result = stream.End() && result;
+    fclose(file);
+    if (!result)
+    {
+        printf("invalid json on line %zu\n", line_count);
+        remove(output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// emits every record of a stream as one line of compact json
+static int WriteLines(const jsonb::StreamReader& stream, const std::string& output)
+{
+    if (!stream.IsValid())
+    {
+        printf("not a jsonb stream\n");
+        return 1;
+    }
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return 1;
+    }
+    jsonb::JsonEmitter emitter;
+    emitter.SetPretty(false);
+    bool result = true;
+    for (auto i = stream.begin(); i != stream.end() && result; ++i)
+    {
+        result = emitter.Emit(*i, file) && fputc('\n', file) != EOF;
+    }
+    fclose(file);
+    if (!result)
+    {
+        remove(output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// applies an RFC 6902 JSON Patch to a binary, only the containers it touches are written again
+static int WritePatched(std::string_view binary, const std::string& output, const std::string& patch_path)
+{
+    jsonb::Patcher patcher;
+    jsonb::Status status = patcher.Open(binary.data(), binary.size());
+    if (!status)
+    {
+        printf("%s at byte %zu\n", status.GetMessage(), status.GetOffset());
+        return 1;
+    }
+    jsonb::MappedFile patch;
+    if (!patch.Open(patch_path))
+    {
+        return 1;
+    }
+    if (!patcher.ApplyJsonPatch(std::string_view((const char*) patch.GetData(), patch.GetSize())))
+    {
+        printf("patch does not apply\n");
+        return 1;
+    }
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return 1;
+    }
+    bool result = fwrite(patcher.GetData(), 1, patcher.GetSize(), file) == patcher.GetSize();
+    fclose(file);
+    if (!result)
+    {
+        remove(output.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static bool WriteFile(const std::string& output, const jsonb::BufferWriter& buffer)
+{
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool result = fwrite(buffer.GetData(), 1, buffer.GetSize(), file) == buffer.GetSize();
+    fclose(file);
+    if (!result)
+    {
+        remove(output.c_str());
+    }
+    return result;
+}
+
+// writes the delta that turns the base into the target, or rebuilds the target from the base and a delta
+static int WriteDelta(std::string_view base, const std::string& other_path, const std::string& output, bool apply)
+{
+    jsonb::MappedFile other;
+    if (!other.Open(other_path))
+    {
+        return 1;
+    }
+    jsonb::Differ differ;
+    jsonb::BufferWriter result;
+    if (apply)
+    {
+        jsonb::Status status = differ.Apply(base.data(), base.size(), other.GetData(), other.GetSize(), result);
+        if (!status)
+        {
+            printf("%s at byte %zu\n", status.GetMessage(), status.GetOffset());
+            return 1;
+        }
+    }
+    else
+    {
+        differ.Diff(base.data(), base.size(), other.GetData(), other.GetSize(), result);
+    }
+    return WriteFile(output, result) ? 0 : 1;
+}
+
+static void PrintStats(const char* operation, const jsonb::Stats& stats)
+{
+    // same order as the type tags
+    static const char* TAG_NAMES[jsonb::TAG_COUNT] = {
+        "object", "array", "string", "uint8", "int8", "uint16", "int16", "uint32", "int32",
+        "uint64", "int64", "float", "bool", "null", "stringref8", "stringref16", "stringref32",
+        "typedarray", "double", "decimal", "block",
+    };
+
+    printf("%s: %llu bytes in, %llu bytes out, %llu heap blocks, depth %u\n", operation,
+        (unsigned long long) stats.input_bytes, (unsigned long long) stats.output_bytes,
+        (unsigned long long) stats.heap_blocks, stats.max_depth);
+    printf("\tvalues:");
+    for (size_t i = 0; i < jsonb::TAG_COUNT; ++i)
+    {
+        if (stats.tags[i] > 0)
+        {
+            printf(" %s %llu", TAG_NAMES[i], (unsigned long long) stats.tags[i]);
+        }
+    }
+    printf("\n\tstrings %llu bytes, keys %llu bytes, typed elements %llu\n",
+        (unsigned long long) stats.string_bytes, (unsigned long long) stats.key_bytes,
+        (unsigned long long) stats.typed_elements);
+    printf("\t");
+    for (size_t i = 0; i < jsonb::PHASE_COUNT; ++i)
+    {
+        if (stats.nanoseconds[i] > 0)
+        {
+            printf("%s %.3f ms, ", jsonb::GetPhaseName((jsonb::Phase) i), stats.nanoseconds[i] / 1e6);
+        }
+    }
+    printf("total %.3f ms\n", stats.GetNanoseconds() / 1e6);
+}
+
+// loads json text or a binary with stats on and writes it back the other way
+static int ShowStats(std::string_view input)
+{
+    if (!jsonb::STATS_ENABLED)
+    {
+        printf("-i needs a build with JSONB_WITH_STATS\n");
+        return 1;
+    }
+
+    jsonb::Document doc;
+    jsonb::Stats stats;
+    doc.SetStats(&stats);
+    jsonb::View view(input.data(), input.size());
+    bool binary = view.IsValid() && view.GetVersion() >= 2;
+    jsonb::Status status = binary ? doc.Load(input.data(), input.size()) : doc.Load(input);
+    if (!status && !binary && view.IsValid())
+    {
+        // a v1 binary has no header to tell it from text
+        binary = (bool) doc.Load(input.data(), input.size());
+        status = binary ? jsonb::Status() : status;
+    }
+    if (!status)
+    {
+        printf("%s at byte %zu\n", status.GetMessage(), status.GetOffset());
+        return 1;
+    }
+    PrintStats("load", stats);
+    if (binary)
+    {
+        doc.ToJson();
+        PrintStats("to json", stats);
+    }
+    else
+    {
+        doc.ToBinary();
+        PrintStats("to binary", stats);
+    }
+    return 0;
+}
+
+// dictionary and compression level of the -d, -z and -zd conversions
+static void SetEncoding(jsonb::Document& doc, const std::string& conv)
+{
+    bool compress = conv.compare(0, 2, "-z") == 0;
+    if (conv == "-d" || conv.compare(0, 3, "-zd") == 0)
+    {
+        doc.SetDictionaryMode(jsonb::DictionaryMode::KeysAndStrings);
+    }
+    if (compress)
+    {
+        // -z alone is the fastest level
+        int level = atoi(conv.c_str() + (conv.compare(0, 3, "-zd") == 0 ? 3 : 2));
+        doc.SetCompressionLevel(std::max(1, std::min(level, 9)));
+    }
+}
+
+struct BatchFile
+{
+    std::string input;
+    std::string output;
+};
+
+// state of one batch thread, kept from file to file so its buffers are only grown once
+struct BatchWorker
+{
+    jsonb::Document doc;
+    jsonb::Validator validator;
+    jsonb::JsonEmitter emitter;
+    jsonb::BufferWriter text;
+    size_t failed = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+};
+
+// adds the files of one batch input: every matching file under a directory, a file with one path
+// per line after an @, the paths on stdin for -, or else the file itself
+static bool AddBatchInput(const std::string& input, const std::filesystem::path& output_dir, bool to_text, std::vector<BatchFile>& files)
+{
+    namespace fs = std::filesystem;
+    const char* extension = to_text ? ".json" : ".jsonb";
+    auto add = [&](const fs::path& path, const fs::path& relative) {
+        files.push_back({ path.string(), (output_dir / relative).replace_extension(extension).string() });
+        return true;
+    };
+
+    std::error_code error;
+    if (input != "-" && input[0] != '@' && fs::is_directory(input, error))
+    {
+        // the tree under the directory is kept in the output directory
+        for (fs::recursive_directory_iterator i(input, error), end; i != end && !error; i.increment(error))
         {
-            jsonb::Document doc;
-            for (int i = 0; i < 100; ++i)
+            std::string ext = i->path().extension().string();
+            bool match = to_text ? ext == ".jsonb" : ext == ".json" || ext == ".gltf";
+            if (match && i->is_regular_file(error))
             {
-                doc.Load(input_buffer);
+                add(i->path(), fs::relative(i->path(), input, error));
             }
         }
+        return !error;
+    }
 
-        auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - t).count();
+    std::string list;
+    if (input == "-")
+    {
+        char buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+        {
+            list.append(buffer, size);
+        }
+    }
+    else if (input[0] == '@')
+    {
+        jsonb::MappedFile file;
+        if (!file.Open(input.substr(1)))
+        {
+            return false;
+        }
+        list.assign((const char*) file.GetData(), file.GetSize());
+    }
+    else
+    {
+        return add(input, fs::path(input).filename());
+    }
+    return ForEachLine(list, [&](std::string_view line) {
+        fs::path path(line);
+        return add(path, path.filename());
+    });
+}
+
+static void ConvertBatchFile(const BatchFile& file, bool to_text, bool compact, BatchWorker& worker)
+{
+    // read in place from the page cache like a single conversion
+    jsonb::MappedFile input;
+    if (!input.Open(file.input))
+    {
+        printf("%s: can not open\n", file.input.c_str());
+        ++worker.failed;
+        return;
+    }
+    worker.bytes_in += input.GetSize();
+
+    if (to_text)
+    {
+        // the inputs are not trusted to be well formed like the one of -t
+        jsonb::Status status = worker.validator.Validate(input.GetData(), input.GetSize());
+        if (!status)
+        {
+            printf("%s: %s at byte %zu\n", file.input.c_str(), status.GetMessage(), status.GetOffset());
+            ++worker.failed;
+            return;
+        }
+        worker.text.Clear();
+        worker.emitter.SetPretty(!compact);
+        if (!worker.emitter.Emit(jsonb::View(input.GetData(), input.GetSize()), worker.text))
+        {
+            printf("%s: can not emit\n", file.input.c_str());
+            ++worker.failed;
+            return;
+        }
+        jsonb::MappedFile output;
+        if (!output.Create(file.output, worker.text.GetSize()))
+        {
+            printf("%s: can not write\n", file.output.c_str());
+            ++worker.failed;
+            return;
+        }
+        memcpy(output.GetWritableData(), worker.text.GetData(), worker.text.GetSize());
+        worker.bytes_out += worker.text.GetSize();
+        return;
+    }
 
-        printf("load time: %d ms", (int) time);
+    if (!worker.doc.Encode(std::string_view((const char*) input.GetData(), input.GetSize())))
+    {
+        printf("%s: invalid json\n", file.input.c_str());
+        ++worker.failed;
+        return;
+    }
+    if (!worker.doc.SaveFile(file.output))
+    {
+        printf("%s: can not write\n", file.output.c_str());
+        ++worker.failed;
+        return;
+    }
+    worker.bytes_out += worker.doc.GetBinarySize();
+}
+
+// converts many files in one process, each pool thread takes the next file until none are left
+static int ConvertBatch(int argc, char* argv[])
+{
+    std::string threads_arg = argv[1];
+    std::string conv = argv[2];
+    std::filesystem::path output_dir = argv[3];
+    bool to_text = conv == "-t" || conv == "-c";
+    bool compact = conv == "-c";
+    if (!to_text && conv != "-b" && conv != "-d" && conv.compare(0, 2, "-z") != 0)
+    {
+        printf("%s can not be batched\n", conv.c_str());
+        return 1;
+    }
 
+    std::vector<BatchFile> files;
+    for (int i = 4; i < argc; ++i)
+    {
+        if (!AddBatchInput(argv[i], output_dir, to_text, files))
+        {
+            printf("%s: can not read\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // two threads writing one mapped file would corrupt it, like a.json and a.gltf, or
+    // dir1/a.json and dir2/a.json from a list
+    std::vector<std::string> outputs;
+    outputs.reserve(files.size());
+    for (const BatchFile& file : files)
+    {
+        outputs.push_back(std::filesystem::path(file.output).lexically_normal().string());
+    }
+    std::sort(outputs.begin(), outputs.end());
+    auto duplicate = std::adjacent_find(outputs.begin(), outputs.end());
+    if (duplicate != outputs.end())
+    {
+        printf("%s: written by more than one input\n", duplicate->c_str());
+        return 1;
+    }
+
+    // the directories are made up front, the files of a directory come one after another
+    std::error_code error;
+    std::filesystem::create_directories(output_dir, error);
+    std::filesystem::path last_dir;
+    for (const BatchFile& file : files)
+    {
+        std::filesystem::path dir = std::filesystem::path(file.output).parent_path();
+        if (dir != last_dir)
+        {
+            std::filesystem::create_directories(dir, error);
+            last_dir = dir;
+        }
+    }
+
+    int thread_count = atoi(threads_arg.c_str() + 2);
+    if (thread_count <= 0)
+    {
+        thread_count = (int) std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::unique_ptr<BatchWorker>> workers;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        workers.emplace_back(new BatchWorker());
+        SetEncoding(workers.back()->doc, conv);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    jsonb::ThreadPool pool(thread_count);
+    jsonb::ThreadPool::Group group;
+    for (auto& worker : workers)
+    {
+        BatchWorker* w = worker.get();
+        pool.Run(group, [&, w]() {
+            for (size_t i = next++; i < files.size(); i = next++)
+            {
+                ConvertBatchFile(files[i], to_text, compact, *w);
+            }
+        });
+    }
+    pool.Wait(group);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    size_t failed = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    for (auto& worker : workers)
+    {
+        failed += worker->failed;
+        bytes_in += worker->bytes_in;
+        bytes_out += worker->bytes_out;
+    }
+    seconds = std::max(seconds, 1e-9);
+    printf("%zu files, %zu failed, %.1f MB in, %.1f MB out, %d threads, %.3f s: %.1f MB/s, %.0f files/s\n",
+        files.size(), failed, bytes_in / 1e6, bytes_out / 1e6, thread_count, seconds,
+        bytes_in / 1e6 / seconds, files.size() / seconds);
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool verify = argc == 3 && (std::string(argv[1]) == "-v" || std::string(argv[1]) == "-vd");
+    bool check = argc == 3 && std::string(argv[1]) == "-k";
+    bool info = argc == 3 && std::string(argv[1]) == "-i";
+    bool patch = argc == 5 && std::string(argv[1]) == "-p";
+    bool delta = argc == 5 && (std::string(argv[1]) == "-x" || std::string(argv[1]) == "-a");
+    if (argc >= 5 && std::string(argv[1]).compare(0, 2, "-m") == 0)
+    {
+        return ConvertBatch(argc, argv);
+    }
+    if (argc != 4 && !verify && !check && !info && !patch && !delta)
+    {
+        printf("Usage:\n");
+        printf("\tjsonb.exe -b input.json output.jsonb\n");
+        printf("\tjsonb.exe -d input.json output.jsonb (with dictionary)\n");
+        printf("\tjsonb.exe -z6 input.json output.jsonb (compressed blocks, level 1 to 9, -zd6 with dictionary)\n");
+        printf("\tjsonb.exe -t input.jsonb output.json\n");
+        printf("\tjsonb.exe -c input.jsonb output.json (compact)\n");
+        printf("\tjsonb.exe -v input.json (check every value round trips, -vd with dictionary)\n");
+        printf("\tjsonb.exe -k input.jsonb (check a binary is well formed)\n");
+        printf("\tjsonb.exe -i input.json (counts and phase times of a load, input.jsonb too)\n");
+        printf("\tjsonb.exe -s input.ndjson output.jsonbs (one record per line, -sd with shared keys)\n");
+        printf("\tjsonb.exe -n input.jsonbs output.ndjson\n");
+        printf("\tjsonb.exe -p input.jsonb output.jsonb patch.json (RFC 6902 JSON Patch)\n");
+        printf("\tjsonb.exe -x base.jsonb target.jsonb output.jsonbd (delta from base to target)\n");
+        printf("\tjsonb.exe -a base.jsonb delta.jsonbd output.jsonb (apply a delta)\n");
+        printf("\tjsonb.exe -m8 -b output_dir inputs... (8 threads, -m one per core, any of -b -d -z -zd -t -c;\n");
+        printf("\t\tan input is a directory, @list.txt with a path per line, - for paths on stdin or a file)\n");
         return 0;
     }
+
+    std::string conv = argv[1];
+    std::string input = argv[2];
+    std::string output = verify || check || info ? "" : argv[3];
+
+    bool to_text = false;
+    bool compact = false;
+    if (conv == "-t" || conv == "-c")
+    {
+        to_text = true;
+        compact = conv == "-c";
+    }
+
+    // the input is read in place from the page cache, never copied
+    jsonb::MappedFile input_file;
+    if (!input_file.Open(input))
+    {
+        return verify || check || info ? 1 : 0;
+    }
+    std::string_view input_buffer((const char*) input_file.GetData(), input_file.GetSize());
+
+    if (verify)
+    {
+#ifdef JSONB_WITH_JSONCPP
+        return Verify(input_buffer, conv == "-vd");
+#else
+        printf("-v needs a build with JSONB_WITH_JSONCPP\n");
+        return 1;
 #endif
-    
-    if (to_text)
+    }
+
+    if (check)
     {
-        jsonb::Document doc;
-        if (doc.Load((const void*) &input_buffer[0], input_buffer.size()))
+        jsonb::Validator validator;
+        jsonb::Status status = validator.Validate(input_buffer.data(), input_buffer.size());
+        if (!status)
         {
-            std::string json = doc.ToJson();
+            printf("%s at byte %zu\n", status.GetMessage(), status.GetOffset());
+            return 1;
+        }
+        printf("ok\n");
+        return 0;
+    }
+
+    if (info)
+    {
+        return ShowStats(input_buffer);
+    }
 
-            std::ofstream os(output, std::ios::binary | std::ios::out);
-            if (os)
+    if (conv == "-s" || conv == "-sd")
+    {
+        return WriteStream(input_buffer, output, conv == "-sd");
+    }
+    if (patch)
+    {
+        return WritePatched(input_buffer, output, argv[4]);
+    }
+    if (delta)
+    {
+        return WriteDelta(input_buffer, argv[3], argv[4], conv == "-a");
+    }
+    if (conv == "-n")
+    {
+        return WriteLines(jsonb::StreamReader(input_buffer.data(), input_buffer.size()), output);
+    }
+
+    if (to_text)
+    {
+        // emit the text straight from the binary, no tree in between
+        jsonb::View view(input_buffer.data(), input_buffer.size());
+        FILE* file = fopen(output.c_str(), "wb");
+        if (file)
+        {
+            jsonb::JsonEmitter emitter;
+            emitter.SetPretty(!compact);
+            bool result = emitter.Emit(view, file);
+            fclose(file);
+            if (!result)
             {
-                os.write(&json[0], json.size());
-                os.close();
+                remove(output.c_str());
             }
         }
     }
     else
     {
         jsonb::Document doc;
-        if (doc.Load(input_buffer))
+        SetEncoding(doc, conv);
+        if (doc.Encode(input_buffer))
         {
-            doc.ToBinary();
-            const void* bin = doc.GetBinary();
-            size_t bin_size = doc.GetBinarySize();
-
-            std::ofstream os(output, std::ios::binary | std::ios::out);
-            if (os)
-            {
-                os.write((const char*) bin, bin_size);
-                os.close();
-            }
+            doc.SaveFile(output);
         }
     }
     
@@ -0,0 +1,254 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/mapped_file.h>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace jsonb
+{
+    MappedFile::MappedFile():
+        m_data(nullptr),
+        m_size(0),
+        m_writable(false)
+#ifdef _WIN32
+        , m_file(INVALID_HANDLE_VALUE),
+        m_mapping(nullptr)
+#endif
+    {
+
+    }
+
+    MappedFile::~MappedFile()
+    {
+        this->Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other):
+        MappedFile()
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other)
+    {
+        if (this != &other)
+        {
+            this->Close();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_writable = other.m_writable;
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_writable = false;
+#ifdef _WIN32
+            m_file = other.m_file;
+            m_mapping = other.m_mapping;
+            other.m_file = INVALID_HANDLE_VALUE;
+            other.m_mapping = nullptr;
+#endif
+        }
+        return *this;
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const std::string& path, Access access)
+    {
+        this->Close();
+
+        DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        void* data = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (uint64_t) size.QuadPart <= (uint64_t) SIZE_MAX)
+        {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        if (mapping != nullptr)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (data == nullptr)
+        {
+            if (mapping != nullptr)
+            {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            return false;
+        }
+
+        // the counterpart of MADV_WILLNEED, starts reading the whole file in
+        WIN32_MEMORY_RANGE_ENTRY range = { data, (SIZE_T) size.QuadPart };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+        m_data = (uint8_t*) data;
+        m_size = (size_t) size.QuadPart;
+        m_file = file;
+        m_mapping = mapping;
+        return true;
+    }
+
+    bool MappedFile::Create(const std::string& path, size_t size)
+    {
+        this->Close();
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        if (size == 0)
+        {
+            CloseHandle(file);
+            return true;
+        }
+
+        uint64_t size64 = size;
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD) (size64 >> 32), (DWORD) size64, nullptr);
+        void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+        if (data == nullptr)
+        {
+            if (mapping != nullptr)
+            {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            return false;
+        }
+
+        m_data = (uint8_t*) data;
+        m_size = size;
+        m_writable = true;
+        m_file = file;
+        m_mapping = mapping;
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+        m_data = nullptr;
+        m_size = 0;
+        m_writable = false;
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = nullptr;
+    }
+#else
+    bool MappedFile::Open(const std::string& path, Access access)
+    {
+        this->Close();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t) st.st_size <= (uint64_t) SIZE_MAX)
+        {
+            data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        madvise(data, (size_t) st.st_size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        madvise(data, (size_t) st.st_size, MADV_WILLNEED);
+
+        m_data = (uint8_t*) data;
+        m_size = (size_t) st.st_size;
+        return true;
+    }
+
+    bool MappedFile::Create(const std::string& path, size_t size)
+    {
+        this->Close();
+
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        if (size == 0)
+        {
+            close(fd);
+            return true;
+        }
+
+        void* data = MAP_FAILED;
+        if (ftruncate(fd, (off_t) size) == 0)
+        {
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_data = (uint8_t*) data;
+        m_size = size;
+        m_writable = true;
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_data != nullptr)
+        {
+            munmap(m_data, m_size);
+        }
+        m_data = nullptr;
+        m_size = 0;
+        m_writable = false;
+    }
+#endif
+}
@@ -0,0 +1,170 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/node.h>
+#include <jsonb/jsonb.h>
+#include <string.h>
+
+namespace jsonb
+{
+    namespace
+    {
+        const Node NULL_NODE;
+
+        int CompareKey(const char* key, size_t key_size, std::string_view other)
+        {
+            size_t size = key_size < other.size() ? key_size : other.size();
+            int c = memcmp(key, other.data(), size);
+            if (c != 0)
+            {
+                return c;
+            }
+            return key_size < other.size() ? -1 : (key_size > other.size() ? 1 : 0);
+        }
+    }
+
+    bool Node::AsBool() const
+    {
+        if (m_kind == Kind::Bool)
+        {
+            return m_bool;
+        }
+        return this->AsInt64() != 0;
+    }
+
+    int64_t Node::AsInt64() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return m_int;
+        case Kind::Uint:
+            return (int64_t) m_u;
+        case Kind::Real:
+            return (int64_t) m_real;
+        default:
+            return 0;
+        }
+    }
+
+    uint64_t Node::AsUint64() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return (uint64_t) m_int;
+        case Kind::Uint:
+            return m_u;
+        case Kind::Real:
+            return (uint64_t) m_real;
+        default:
+            return 0;
+        }
+    }
+
+    double Node::AsDouble() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return (double) m_int;
+        case Kind::Uint:
+            return (double) m_u;
+        case Kind::Real:
+            return m_real;
+        default:
+            return 0;
+        }
+    }
+
+    std::string_view Node::AsString() const
+    {
+        if (m_kind != Kind::String)
+        {
+            return std::string_view();
+        }
+        return std::string_view(m_string, m_size);
+    }
+
+    void Node::ExpandPending() const
+    {
+        // nodes are only ever created in the arena as mutable objects
+        Node& node = const_cast<Node&>(*this);
+        m_pending->document->Expand(node);
+    }
+
+    const Node& Node::operator[](size_t index) const
+    {
+        this->Expand();
+        if (m_kind == Kind::Array && index < m_size)
+        {
+            return m_elements[index];
+        }
+        if (m_kind == Kind::Object && index < m_size)
+        {
+            return m_members[index].value;
+        }
+        return NULL_NODE;
+    }
+
+    const Node& Node::operator[](std::string_view key) const
+    {
+        const Node* node = this->Find(key);
+        return node ? *node : NULL_NODE;
+    }
+
+    std::string_view Node::GetKey(size_t index) const
+    {
+        this->Expand();
+        if (m_kind != Kind::Object || index >= m_size)
+        {
+            return std::string_view();
+        }
+        return std::string_view(m_members[index].key, m_members[index].key_size);
+    }
+
+    const Node* Node::Find(std::string_view key) const
+    {
+        if (m_kind != Kind::Object)
+        {
+            return nullptr;
+        }
+        this->Expand();
+
+        size_t low = 0;
+        size_t high = m_size;
+        while (low < high)
+        {
+            size_t mid = (low + high) / 2;
+            const Member& member = m_members[mid];
+            int c = CompareKey(member.key, member.key_size, key);
+            if (c == 0)
+            {
+                return &member.value;
+            }
+            if (c < 0)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,858 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/patch.h>
+#include <jsonb/jsonb.h>
+#include "encoder.h"
+#include "format.h"
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace jsonb
+{
+    namespace
+    {
+        // reads an object key, inline or a dictionary reference, returns the position after it or nullptr
+        const uint8_t* ReadKey(const View& view, const uint8_t* entry, std::string_view& key)
+        {
+            ValueType type = (ValueType) *entry;
+            if (IsStringRef(type))
+            {
+                int size = ScalarSize(type);
+                if (view.GetEnd() - entry - 1 < size)
+                {
+                    return nullptr;
+                }
+                size_t index = LoadOffset(entry + 1, size);
+                if (index >= view.GetStringCount())
+                {
+                    return nullptr;
+                }
+                key = view.GetString(index);
+                return entry + 1 + size;
+            }
+            if (type != ValueType::String)
+            {
+                return nullptr;
+            }
+            key = encoder::ReadKey(entry);
+            const uint8_t* p = (const uint8_t*) key.data() + key.size();
+            return p <= view.GetEnd() ? p : nullptr;
+        }
+
+        // returns the position right after the v2 value starting at p, or nullptr if it is malformed
+        const uint8_t* SkipValue(const View& view, const uint8_t* p)
+        {
+            const uint8_t* end = view.GetEnd();
+            switch ((ValueType) *p)
+            {
+            case ValueType::Object:
+            case ValueType::Array:
+            {
+                Container c;
+                return ReadContainer(p, end, c) ? c.end : nullptr;
+            }
+            case ValueType::String:
+            {
+                std::string_view str;
+                return ReadKey(view, p, str);
+            }
+            case ValueType::TypedArray:
+            {
+                TypedArray a;
+                return ReadTypedArray(p, end, a) ? a.end : nullptr;
+            }
+            case ValueType::Block:
+            {
+                Block b;
+                return ReadBlock(p, end, b) ? b.end : nullptr;
+            }
+            default:
+            {
+                int size = ScalarSize((ValueType) *p);
+                return size >= 0 && end - p - 1 >= size ? p + 1 + size : nullptr;
+            }
+            }
+        }
+
+        // true if the value at p is or holds a typed array outside of compressed blocks
+        bool HasTypedArrays(const View& view, const uint8_t* p)
+        {
+            ValueType type = (ValueType) *p;
+            if (type == ValueType::TypedArray)
+            {
+                return true;
+            }
+            Container c;
+            if ((type != ValueType::Object && type != ValueType::Array) || !ReadContainer(p, view.GetEnd(), c))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < c.count; ++i)
+            {
+                const uint8_t* child = ReadChild(c, i);
+                std::string_view key;
+                if (child && type == ValueType::Object)
+                {
+                    child = ReadKey(view, child, key);
+                }
+                if (child && child < c.table && HasTypedArrays(view, child))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // first entry of an object whose key is not less than key
+        size_t LowerBound(const View& view, const Container& c, std::string_view key)
+        {
+            size_t low = 0;
+            size_t high = c.count;
+            while (low < high)
+            {
+                size_t mid = low + (high - low) / 2;
+                const uint8_t* entry = ReadChild(c, mid);
+                std::string_view entry_key;
+                if (entry == nullptr || ReadKey(view, entry, entry_key) == nullptr)
+                {
+                    return c.count;
+                }
+                if (entry_key < key)
+                {
+                    low = mid + 1;
+                }
+                else
+                {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
+        // every element but a Uint64 reads back as Int, like Document and View read them, so
+        // a typed array written again packs to the same element type
+        Value ReadElement(ValueType type, const uint8_t* p)
+        {
+            switch (type)
+            {
+            case ValueType::Uint8:
+                return Value((long long) p[0]);
+            case ValueType::Int8:
+                return Value((long long) (int8_t) p[0]);
+            case ValueType::Uint16:
+            {
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((long long) v);
+            }
+            case ValueType::Int16:
+            {
+                int16_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((long long) v);
+            }
+            case ValueType::Uint32:
+            {
+                uint32_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((long long) v);
+            }
+            case ValueType::Int32:
+            {
+                int32_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((long long) v);
+            }
+            case ValueType::Uint64:
+            {
+                uint64_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((unsigned long long) v);
+            }
+            case ValueType::Int64:
+            {
+                int64_t v;
+                memcpy(&v, p, sizeof(v));
+                return Value((long long) v);
+            }
+            case ValueType::Float:
+            {
+                float v;
+                memcpy(&v, p, sizeof(v));
+                return Value((double) v);
+            }
+            default:
+            {
+                double v;
+                memcpy(&v, p, sizeof(v));
+                return Value(v);
+            }
+            }
+        }
+
+        template <class T>
+        bool StoreInt(uint8_t* p, const Value& value)
+        {
+            const int64_t min = (int64_t) std::numeric_limits<T>::min();
+            const uint64_t max = (uint64_t) std::numeric_limits<T>::max();
+            if (value.GetKind() == Kind::Int)
+            {
+                int64_t i = value.AsInt64();
+                if (i < min || (i >= 0 && (uint64_t) i > max))
+                {
+                    return false;
+                }
+            }
+            else if (value.GetKind() != Kind::Uint || value.AsUint64() > max)
+            {
+                return false;
+            }
+            T t = value.GetKind() == Kind::Int ? (T) value.AsInt64() : (T) value.AsUint64();
+            memcpy(p, &t, sizeof(t));
+            return true;
+        }
+
+        // overwrites an element of a typed array if value is of its kind and fits its type exactly
+        bool StoreElement(ValueType type, uint8_t* p, const Value& value)
+        {
+            switch (type)
+            {
+            case ValueType::Uint8:
+                return StoreInt<uint8_t>(p, value);
+            case ValueType::Int8:
+                return StoreInt<int8_t>(p, value);
+            case ValueType::Uint16:
+                return StoreInt<uint16_t>(p, value);
+            case ValueType::Int16:
+                return StoreInt<int16_t>(p, value);
+            case ValueType::Uint32:
+                return StoreInt<uint32_t>(p, value);
+            case ValueType::Int32:
+                return StoreInt<int32_t>(p, value);
+            case ValueType::Uint64:
+                return StoreInt<uint64_t>(p, value);
+            case ValueType::Int64:
+                return StoreInt<int64_t>(p, value);
+            case ValueType::Float:
+            {
+                float f = (float) value.AsDouble();
+                if (value.GetKind() != Kind::Real || (double) f != value.AsDouble())
+                {
+                    return false;
+                }
+                memcpy(p, &f, sizeof(f));
+                return true;
+            }
+            default:
+            {
+                double d = value.AsDouble();
+                if (value.GetKind() != Kind::Real)
+                {
+                    return false;
+                }
+                memcpy(p, &d, sizeof(d));
+                return true;
+            }
+            }
+        }
+
+        // equality as RFC 6902 tests it, numbers compare by value whatever they were written as
+        bool SameJson(const Value& a, const Value& b)
+        {
+            if (a.IsNumber() && b.IsNumber())
+            {
+                return a.IsInt() && b.IsInt() ? a == b : a.AsDouble() == b.AsDouble();
+            }
+            if (a.GetKind() != b.GetKind() || a.Size() != b.Size())
+            {
+                return false;
+            }
+            switch (a.GetKind())
+            {
+            case Kind::Array:
+                for (size_t i = 0; i < a.Size(); ++i)
+                {
+                    if (!SameJson(a[i], b[i]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            case Kind::Object:
+                for (size_t i = 0; i < a.Size(); ++i)
+                {
+                    if (a.GetKey(i) != b.GetKey(i) || !SameJson(a[i], b[i]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            default:
+                return a == b;
+            }
+        }
+    }
+
+    Patcher::Patcher():
+        m_typed_arrays(false),
+        m_in_place(false)
+    {
+    }
+
+    Status Patcher::Open(const void* binary, size_t size)
+    {
+        m_buffer.Clear();
+        m_in_place = false;
+        Status status = m_validator.Validate(binary, size);
+        if (!status)
+        {
+            return status;
+        }
+        View view(binary, size);
+        if (view.GetVersion() < 2)
+        {
+            return Status(Error::BadHeader, 0);
+        }
+        m_buffer.Write(binary, size);
+        m_typed_arrays = HasTypedArrays(view, view.Root().GetData());
+        return status;
+    }
+
+    bool Patcher::Get(std::string_view pointer, Value& value) const
+    {
+        Path path;
+        if (m_buffer.GetSize() == 0 || !path.Compile(pointer))
+        {
+            return false;
+        }
+
+        // walked by exact keys, a "*" segment is a key here and not a wildcard
+        View view = this->GetView();
+        ValueRef ref = view.Root();
+        for (size_t step = 0; step < path.GetStepCount() && ref.IsValid(); ++step)
+        {
+            if (ref.IsObject())
+            {
+                ref = ref.Find(path.GetKey(step));
+            }
+            else if (ref.IsArray() && path.GetIndex(step) < ref.Size())
+            {
+                ref = ref[path.GetIndex(step)];
+            }
+            else
+            {
+                return false;
+            }
+        }
+        if (!ref.IsValid())
+        {
+            return false;
+        }
+        value = Value(ref);
+        return true;
+    }
+
+    bool Patcher::Set(std::string_view pointer, const Value& value)
+    {
+        return this->Edit(pointer, Mode::Set, &value);
+    }
+
+    bool Patcher::Insert(std::string_view pointer, const Value& value)
+    {
+        return this->Edit(pointer, Mode::Insert, &value);
+    }
+
+    bool Patcher::Remove(std::string_view pointer)
+    {
+        return this->Edit(pointer, Mode::Remove, nullptr);
+    }
+
+    bool Patcher::ApplyJsonPatch(std::string_view patch)
+    {
+        Document doc;
+        if (m_buffer.GetSize() == 0 || !doc.Load(patch) || !doc.GetRoot().IsArray())
+        {
+            return false;
+        }
+
+        m_backup.Clear();
+        m_backup.Write(m_buffer.GetData(), m_buffer.GetSize());
+        const Value& operations = doc.GetRoot();
+        for (size_t i = 0; i < operations.Size(); ++i)
+        {
+            if (!this->Apply(operations[i]))
+            {
+                std::swap(m_buffer, m_backup);
+                m_in_place = false;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Patcher::Apply(const Value& operation)
+    {
+        const Value* op = operation.Find("op");
+        const Value* path = operation.Find("path");
+        const Value* value = operation.Find("value");
+        const Value* from = operation.Find("from");
+        if (op == nullptr || path == nullptr || !op->IsString() || !path->IsString())
+        {
+            return false;
+        }
+
+        std::string_view name = op->AsString();
+        std::string_view pointer = path->AsString();
+        if (name == "add")
+        {
+            return value && this->Insert(pointer, *value);
+        }
+        if (name == "remove")
+        {
+            return this->Remove(pointer);
+        }
+
+        Value target;
+        if (name == "replace")
+        {
+            return value && this->Get(pointer, target) && this->Set(pointer, *value);
+        }
+        if (name == "test")
+        {
+            return value && this->Get(pointer, target) && SameJson(target, *value);
+        }
+        if (name != "move" && name != "copy")
+        {
+            return false;
+        }
+
+        if (from == nullptr || !from->IsString() || !this->Get(from->AsString(), target))
+        {
+            return false;
+        }
+        if (name == "move")
+        {
+            std::string_view source = from->AsString();
+            if (pointer == source)
+            {
+                return true;
+            }
+            // a value can not move into itself
+            if (pointer.size() > source.size() && pointer.substr(0, source.size()) == source && pointer[source.size()] == '/')
+            {
+                return false;
+            }
+            if (!this->Remove(source))
+            {
+                return false;
+            }
+        }
+        return this->Insert(pointer, target);
+    }
+
+    bool Patcher::Edit(std::string_view pointer, Mode mode, const Value* value)
+    {
+        m_in_place = false;
+        if (m_buffer.GetSize() == 0 || !m_path.Compile(pointer))
+        {
+            return false;
+        }
+        View view = this->GetView();
+        if (!this->Walk(view) || (m_chain.empty() && mode == Mode::Remove))
+        {
+            return false;
+        }
+
+        if (!m_chain.empty())
+        {
+            const Link& link = m_chain.back();
+            const uint8_t* container = view.GetBegin() + link.pos;
+            if (mode == Mode::Remove && !link.found)
+            {
+                return false;
+            }
+
+            if ((ValueType) *container == ValueType::TypedArray)
+            {
+                TypedArray a;
+                if (!ReadTypedArray(container, view.GetEnd(), a))
+                {
+                    return false;
+                }
+                uint8_t* element = m_buffer.GetData() + (a.data - view.GetBegin()) + link.index * a.size;
+                if (mode == Mode::Set && link.found && StoreElement(a.type, element, *value))
+                {
+                    m_in_place = true;
+                    return true;
+                }
+
+                // anything else decodes the typed array and writes it again in its parent
+                Value(Kind::Array).Swap(m_array);
+                m_array.Reserve(a.count + 1);
+                for (size_t i = 0; i < a.count; ++i)
+                {
+                    m_array.Append(ReadElement(a.type, a.data + i * a.size));
+                }
+                if (mode == Mode::Remove)
+                {
+                    m_array.Erase(link.index);
+                }
+                else if (mode == Mode::Set && link.found)
+                {
+                    m_array[link.index] = *value;
+                }
+                else
+                {
+                    m_array.Insert(link.index, *value);
+                }
+                m_chain.pop_back();
+                mode = Mode::Set;
+                value = &m_array;
+            }
+            else if (mode == Mode::Set && link.found && value->GetKind() != Kind::Array && value->GetKind() != Kind::Object &&
+                this->WriteInPlace(view, *value))
+            {
+                m_in_place = true;
+                return true;
+            }
+        }
+
+        const uint8_t* root = view.Root().GetData();
+        const uint8_t* root_end = SkipValue(view, root);
+        if (root_end == nullptr)
+        {
+            return false;
+        }
+        m_scratch.Clear();
+        m_scratch.Reserve(m_buffer.GetSize() + 64);
+        m_scratch.Write(view.GetBegin(), root - view.GetBegin());
+        if (m_chain.empty())
+        {
+            this->WriteValue(m_scratch, view, *value);
+        }
+        else if (!this->WriteEdited(view, 0, mode, value))
+        {
+            return false;
+        }
+        m_scratch.Write(root_end, view.GetEnd() - root_end);
+        std::swap(m_buffer, m_scratch);
+        return true;
+    }
+
+    bool Patcher::Walk(const View& view)
+    {
+        m_chain.clear();
+        const uint8_t* begin = view.GetBegin();
+        const uint8_t* end = view.GetEnd();
+        const uint8_t* p = view.Root().GetData();
+        size_t step_count = m_path.GetStepCount();
+        for (size_t step = 0; step < step_count; ++step)
+        {
+            bool last = step + 1 == step_count;
+            std::string_view key = m_path.GetKey(step);
+            Link link;
+            link.pos = p - begin;
+
+            ValueType type = (ValueType) *p;
+            if (type == ValueType::Object)
+            {
+                Container c;
+                if (!ReadContainer(p, end, c))
+                {
+                    return false;
+                }
+                link.index = LowerBound(view, c, key);
+                const uint8_t* entry = link.index < c.count ? ReadChild(c, link.index) : nullptr;
+                std::string_view entry_key;
+                p = entry ? ReadKey(view, entry, entry_key) : nullptr;
+                link.found = p && entry_key == key;
+            }
+            else if (type == ValueType::Array)
+            {
+                Container c;
+                if (!ReadContainer(p, end, c))
+                {
+                    return false;
+                }
+                link.index = last && key == "-" ? c.count : m_path.GetIndex(step);
+                link.found = link.index < c.count;
+                p = link.found ? ReadChild(c, link.index) : nullptr;
+                if (link.index > c.count)
+                {
+                    return false;
+                }
+            }
+            else if (type == ValueType::TypedArray)
+            {
+                TypedArray a;
+                if (!ReadTypedArray(p, end, a))
+                {
+                    return false;
+                }
+                link.index = last && key == "-" ? a.count : m_path.GetIndex(step);
+                link.found = link.index < a.count;
+                p = nullptr;
+                if (link.index > a.count)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                // scalars have nothing under them and blocks are not edited
+                return false;
+            }
+
+            // elements of a typed array are the last segment if any
+            if (!last && (!link.found || p == nullptr))
+            {
+                return false;
+            }
+            m_chain.push_back(link);
+        }
+        return true;
+    }
+
+    bool Patcher::WriteInPlace(const View& view, const Value& value)
+    {
+        const Link& link = m_chain.back();
+        const uint8_t* container = view.GetBegin() + link.pos;
+        Container c;
+        if (!ReadContainer(container, view.GetEnd(), c))
+        {
+            return false;
+        }
+        const uint8_t* child = ReadChild(c, link.index);
+        std::string_view key;
+        if ((ValueType) *container == ValueType::Object)
+        {
+            child = ReadKey(view, child, key);
+        }
+        const uint8_t* child_end = SkipValue(view, child);
+        if (child_end == nullptr)
+        {
+            return false;
+        }
+
+        m_scratch.Clear();
+        this->WriteValue(m_scratch, view, value);
+        if (m_scratch.GetSize() != (size_t) (child_end - child))
+        {
+            return false;
+        }
+        memcpy(m_buffer.GetData() + (child - view.GetBegin()), m_scratch.GetData(), m_scratch.GetSize());
+        return true;
+    }
+
+    bool Patcher::WriteEdited(const View& view, size_t level, Mode mode, const Value* value)
+    {
+        BufferWriter& writer = m_scratch;
+        const uint8_t* begin = view.GetBegin();
+        const Link& link = m_chain[level];
+        const uint8_t* container = begin + link.pos;
+        bool object = (ValueType) *container == ValueType::Object;
+        bool last = level + 1 == m_chain.size();
+        Container c;
+        if (!ReadContainer(container, view.GetEnd(), c))
+        {
+            return false;
+        }
+
+        const uint8_t* entry = link.found ? ReadChild(c, link.index) : nullptr;
+        const uint8_t* child = entry;
+        std::string_view key;
+        if (entry && object)
+        {
+            child = ReadKey(view, entry, key);
+        }
+
+        // the bytes of the body from cut_begin to cut_end are replaced by what gets written
+        // in their place, a new entry goes after the last child
+        const uint8_t* cut_begin = c.table;
+        const uint8_t* cut_end = c.table;
+        bool add = false;
+        bool drop = false;
+        if (!last || (link.found && (mode == Mode::Set || object) && mode != Mode::Remove))
+        {
+            cut_begin = child;
+            cut_end = SkipValue(view, child);
+        }
+        else if (mode == Mode::Remove)
+        {
+            cut_begin = entry;
+            cut_end = SkipValue(view, child);
+            drop = true;
+        }
+        else
+        {
+            add = true;
+        }
+        if (cut_begin == nullptr || cut_end == nullptr)
+        {
+            return false;
+        }
+
+        size_t body_pos = encoder::BeginContainer(writer, (ValueType) *container);
+        writer.Write(c.body, cut_begin - c.body);
+        size_t new_begin = writer.GetSize();
+        if (!last)
+        {
+            if (!this->WriteEdited(view, level + 1, mode, value))
+            {
+                return false;
+            }
+        }
+        else if (!drop)
+        {
+            if (add && object)
+            {
+                this->WriteString(writer, view, m_path.GetKey(level));
+            }
+            this->WriteValue(writer, view, *value);
+        }
+        size_t new_end = writer.GetSize();
+        writer.Write(cut_end, c.table - cut_end);
+
+        // children after the cut moved by how much its size changed
+        int64_t delta = (int64_t) (new_end - new_begin) - (int64_t) (cut_end - cut_begin);
+        size_t cut_offset = cut_end - c.body;
+        size_t first_offset = m_offsets.size();
+        for (size_t i = 0; i < c.count; ++i)
+        {
+            if (i == link.index && add)
+            {
+                m_offsets.push_back((uint32_t) (new_begin - body_pos));
+            }
+            if (i == link.index && drop)
+            {
+                continue;
+            }
+            size_t offset = LoadOffset(c.table + i * c.width, c.width);
+            if (offset >= cut_offset)
+            {
+                offset = (size_t) ((int64_t) offset + delta);
+            }
+            m_offsets.push_back((uint32_t) offset);
+        }
+        if (add && link.index == c.count)
+        {
+            m_offsets.push_back((uint32_t) (new_begin - body_pos));
+        }
+        encoder::EndContainer(writer, body_pos, m_offsets, first_offset);
+
+        // the bytes before the cut kept their position, the ones after it have to keep
+        // their typed arrays aligned if they moved by other than a multiple of 8
+        if (m_typed_arrays && cut_end < c.table && (new_end - (size_t) (cut_end - begin)) % 8 != 0)
+        {
+            Container edited;
+            if (!ReadContainer(writer.GetData() + link.pos, writer.GetData() + writer.GetSize(), edited))
+            {
+                return false;
+            }
+            for (size_t i = 0; i < edited.count; ++i)
+            {
+                const uint8_t* moved = ReadChild(edited, i);
+                if (moved < writer.GetData() + new_end)
+                {
+                    continue;
+                }
+                if (object && IsStringRef((ValueType) *moved))
+                {
+                    moved += 1 + ScalarSize((ValueType) *moved);
+                }
+                else if (object)
+                {
+                    std::string_view moved_key = encoder::ReadKey(moved);
+                    moved = (const uint8_t*) moved_key.data() + moved_key.size();
+                }
+                encoder::AlignTypedArrays(writer.GetData(), moved - writer.GetData());
+            }
+        }
+        return true;
+    }
+
+    void Patcher::WriteValue(BufferWriter& writer, const View& view, const Value& value)
+    {
+        switch (value.GetKind())
+        {
+        case Kind::Object:
+        {
+            size_t body_pos = encoder::BeginContainer(writer, ValueType::Object);
+            size_t first_offset = m_offsets.size();
+            for (size_t i = 0; i < value.Size(); ++i)
+            {
+                m_offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                this->WriteString(writer, view, value.GetKey(i));
+                this->WriteValue(writer, view, value[i]);
+            }
+            encoder::EndContainer(writer, body_pos, m_offsets, first_offset);
+            break;
+        }
+        case Kind::Array:
+        {
+            size_t body_pos = encoder::BeginContainer(writer, ValueType::Array);
+            size_t first_offset = m_offsets.size();
+            for (size_t i = 0; i < value.Size(); ++i)
+            {
+                m_offsets.push_back((uint32_t) (writer.GetSize() - body_pos));
+                this->WriteValue(writer, view, value[i]);
+            }
+            encoder::EndArray(writer, body_pos, m_offsets, first_offset, m_typed_scratch);
+            if (writer.GetData()[body_pos - 1 - CONTAINER_SIZE_BYTES] == (uint8_t) ValueType::TypedArray)
+            {
+                m_typed_arrays = true;
+            }
+            break;
+        }
+        case Kind::String:
+            this->WriteString(writer, view, value.AsString());
+            break;
+        case Kind::Int:
+            encoder::WriteInt64(writer, value.AsInt64());
+            break;
+        case Kind::Uint:
+            encoder::WriteUint64(writer, value.AsUint64());
+            break;
+        case Kind::Real:
+            encoder::WriteReal(writer, value.AsDouble());
+            break;
+        case Kind::Bool:
+            encoder::WriteBool(writer, value.AsBool());
+            break;
+        case Kind::Null:
+            encoder::WriteNull(writer);
+            break;
+        }
+    }
+
+    void Patcher::WriteString(BufferWriter& writer, const View& view, std::string_view str)
+    {
+        // a reference is never longer than the string it stands for
+        size_t index = view.GetStringCount() > 0 ? view.FindString(str) : 0;
+        if (index < view.GetStringCount())
+        {
+            encoder::WriteStringRef(writer, (uint32_t) index);
+        }
+        else
+        {
+            encoder::WriteString(writer, str.data(), str.size());
+        }
+    }
+}
@@ -0,0 +1,197 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/query.h>
+#include <stdint.h>
+
+namespace jsonb
+{
+    Path::Path():
+        m_valid(true)
+    {
+
+    }
+
+    bool Path::Compile(std::string_view path)
+    {
+        m_keys.clear();
+        m_steps.clear();
+        m_valid = false;
+
+        // "" is the whole document, anything else is a list of "/segment"
+        if (!path.empty() && path[0] != '/')
+        {
+            return false;
+        }
+
+        size_t pos = 0;
+        while (pos < path.size())
+        {
+            if (m_steps.size() == MAX_STEPS)
+            {
+                return false;
+            }
+
+            size_t end = path.find('/', pos + 1);
+            if (end == std::string_view::npos)
+            {
+                end = path.size();
+            }
+            std::string_view segment = path.substr(pos + 1, end - pos - 1);
+            pos = end;
+
+            Step step;
+            step.key_begin = m_keys.size();
+            step.wildcard = segment == "*";
+            for (size_t i = 0; i < segment.size(); ++i)
+            {
+                char c = segment[i];
+                if (c == '~')
+                {
+                    if (i + 1 == segment.size() || (segment[i + 1] != '0' && segment[i + 1] != '1'))
+                    {
+                        m_keys.clear();
+                        m_steps.clear();
+                        return false;
+                    }
+                    c = segment[++i] == '0' ? '~' : '/';
+                }
+                m_keys.push_back(c);
+            }
+            step.key_size = m_keys.size() - step.key_begin;
+
+            // array indices are plain decimals without leading zeros
+            step.index = SIZE_MAX;
+            if (!segment.empty() && segment.size() < 20 && (segment[0] != '0' || segment.size() == 1))
+            {
+                size_t index = 0;
+                size_t i = 0;
+                for (; i < segment.size() && segment[i] >= '0' && segment[i] <= '9'; ++i)
+                {
+                    index = index * 10 + (segment[i] - '0');
+                }
+                if (i == segment.size())
+                {
+                    step.index = index;
+                }
+            }
+            m_steps.push_back(step);
+        }
+
+        m_valid = true;
+        return true;
+    }
+
+    ValueRef Path::Find(const View& view) const
+    {
+        ValueRef result;
+        this->ForEach(view, [&result](const ValueRef& value) {
+            result = value;
+            return false;
+        });
+        return result;
+    }
+
+    size_t Path::Select(const View& view, std::vector<ValueRef>& out) const
+    {
+        return this->ForEach(view, [&out](const ValueRef& value) {
+            out.push_back(value);
+            return true;
+        });
+    }
+
+    size_t Path::Run(const View& view, Visit visit, void* context) const
+    {
+        ValueRef root = view.Root();
+        if (!m_valid || !root.IsValid())
+        {
+            return 0;
+        }
+
+        // dictionary indices of the keys are looked up once per view, not once per object.
+        // when every key is interned a key missing from the dictionary matches nothing
+        size_t key_indices[MAX_STEPS];
+        size_t string_count = view.GetStringCount();
+        for (size_t i = 0; i < m_steps.size(); ++i)
+        {
+            const Step& step = m_steps[i];
+            key_indices[i] = string_count;
+            if (string_count > 0 && !step.wildcard)
+            {
+                key_indices[i] = view.FindString(std::string_view(m_keys.data() + step.key_begin, step.key_size));
+            }
+        }
+
+        size_t count = 0;
+        this->Walk(root, 0, key_indices, visit, context, count);
+        return count;
+    }
+
+    bool Path::Walk(const ValueRef& value, size_t step, const size_t* key_indices, Visit visit, void* context, size_t& count) const
+    {
+        if (step == m_steps.size())
+        {
+            ++count;
+            return visit(context, value);
+        }
+
+        const Step& s = m_steps[step];
+        Kind kind = value.GetKind();
+        if (s.wildcard)
+        {
+            if (kind == Kind::Array || kind == Kind::Object)
+            {
+                for (auto i = value.begin(); i != value.end(); ++i)
+                {
+                    if (!this->Walk(*i, step + 1, key_indices, visit, context, count))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        ValueRef child;
+        if (kind == Kind::Object)
+        {
+            child = value.Find(std::string_view(m_keys.data() + s.key_begin, s.key_size), key_indices[step]);
+        }
+        else if (kind == Kind::Array && s.index != SIZE_MAX)
+        {
+            child = value[s.index];
+        }
+        return !child.IsValid() || this->Walk(child, step + 1, key_indices, visit, context, count);
+    }
+
+    std::vector<ValueRef> Query(const View& view, std::string_view path)
+    {
+        std::vector<ValueRef> result;
+        Path compiled;
+        if (compiled.Compile(path))
+        {
+            compiled.Select(view, result);
+        }
+        return result;
+    }
+
+    ValueRef QueryFirst(const View& view, std::string_view path)
+    {
+        Path compiled;
+        return compiled.Compile(path) ? compiled.Find(view) : ValueRef();
+    }
+}
@@ -0,0 +1,101 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/stats.h>
+#include <jsonb/value.h>
+
+namespace jsonb
+{
+    namespace
+    {
+        const char* PHASE_NAMES[] = {
+            "parse",
+            "validate",
+            "encode",
+            "dictionary",
+            "compress",
+            "decode",
+            "emit",
+            "done",
+        };
+
+        uint64_t CountValue(const ValueRef& value, uint32_t depth, Stats& stats)
+        {
+            stats.tags[value.GetTag() < TAG_COUNT ? value.GetTag() : 0] += 1;
+            if (value.IsString())
+            {
+                size_t size = value.AsString().size();
+                stats.string_bytes += size;
+                return size > Value::INLINE_SIZE ? 1 : 0;
+            }
+            if (!value.IsArray() && !value.IsObject())
+            {
+                return 0;
+            }
+
+            if (depth + 1 > stats.max_depth)
+            {
+                stats.max_depth = depth + 1;
+            }
+            size_t size = value.Size();
+            uint64_t heap = size > 0 ? 1 : 0;
+            if (value.IsTypedArray())
+            {
+                stats.typed_elements += size;
+                return heap;
+            }
+            bool object = value.IsObject();
+            for (auto it = value.begin(); it != value.end(); ++it)
+            {
+                if (object)
+                {
+                    size_t key_size = it.Key().size();
+                    stats.key_bytes += key_size;
+                    heap += key_size > Value::INLINE_SIZE ? 1 : 0;
+                }
+                heap += CountValue(*it, depth + 1, stats);
+            }
+            return heap;
+        }
+    }
+
+    const char* GetPhaseName(Phase phase)
+    {
+        return (size_t) phase <= PHASE_COUNT ? PHASE_NAMES[(size_t) phase] : "";
+    }
+
+    uint64_t Stats::GetNanoseconds() const
+    {
+        uint64_t sum = 0;
+        for (uint64_t ns : nanoseconds)
+        {
+            sum += ns;
+        }
+        return sum;
+    }
+
+    uint64_t CollectStats(const View& view, Stats& stats)
+    {
+        ValueRef root = view.Root();
+        if (!root.IsValid())
+        {
+            return 0;
+        }
+        return CountValue(root, 0, stats);
+    }
+}
@@ -0,0 +1,310 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/stream.h>
+#include "format.h"
+#include <algorithm>
+
+namespace jsonb
+{
+    namespace
+    {
+        // the file buffer is written out in pieces of about this size
+        const size_t FLUSH_SIZE = 64 * 1024;
+        const size_t FRAME_SIZE = sizeof(uint32_t);
+    }
+
+    StreamWriter::StreamWriter():
+        m_out(nullptr),
+        m_file(nullptr),
+        m_flushed(0)
+    {
+
+    }
+
+    void StreamWriter::AddDictionaryKeys(const View& record)
+    {
+        // the keys are only seen once here, the record may be gone by Begin()
+        std::vector<ValueRef> stack;
+        stack.push_back(record.Root());
+        while (!stack.empty())
+        {
+            ValueRef value = stack.back();
+            stack.pop_back();
+            if (!value.IsObject() && !value.IsArray())
+            {
+                continue;
+            }
+            for (auto i = value.begin(); i != value.end(); ++i)
+            {
+                if (value.IsObject())
+                {
+                    m_key_counts[std::string(i.Key())] += 1;
+                }
+                stack.push_back(*i);
+            }
+        }
+    }
+
+    void StreamWriter::Begin(BufferWriter& out)
+    {
+        m_out = &out;
+        m_file = nullptr;
+        this->WriteHeader();
+    }
+
+    void StreamWriter::Begin(FILE* file)
+    {
+        m_buffer.Clear();
+        m_buffer.Reserve(FLUSH_SIZE + 4096);
+        m_out = &m_buffer;
+        m_file = file;
+        this->WriteHeader();
+    }
+
+    void StreamWriter::WriteHeader()
+    {
+        m_flushed = 0;
+        m_index.clear();
+        m_strings.clear();
+        for (auto& i : m_key_counts)
+        {
+            if (i.second > 1)
+            {
+                m_strings.push_back(i.first);
+            }
+        }
+        m_key_counts.clear();
+        std::sort(m_strings.begin(), m_strings.end());
+
+        size_t begin = m_out->GetSize();
+        m_out->Write(STREAM_MAGIC, sizeof(STREAM_MAGIC));
+        m_out->Write(STREAM_VERSION);
+        m_out->Write((uint8_t) (m_strings.empty() ? 0 : FLAG_DICTIONARY));
+        m_out->Write((uint16_t) 0);
+        m_dictionary_writer.WriteShared(m_strings, *m_out);
+
+        // positions in the stream are counted from its header
+        m_flushed = 0 - begin;
+    }
+
+    bool StreamWriter::Add(const View& record)
+    {
+        if (m_out == nullptr || !record.Root().IsValid())
+        {
+            return false;
+        }
+
+        // typed arrays are aligned to the position in out, which is the position in the stream modulo 8
+        size_t frame_pos = m_out->Skip(FRAME_SIZE);
+        m_index.push_back(m_flushed + frame_pos);
+        if (!m_dictionary_writer.WriteRoot(record, *m_out))
+        {
+            m_out->Truncate(frame_pos);
+            m_index.pop_back();
+            return false;
+        }
+        m_out->Patch(frame_pos, (uint32_t) (m_out->GetSize() - frame_pos - FRAME_SIZE));
+
+        if (m_file && m_out->GetSize() >= FLUSH_SIZE)
+        {
+            this->Flush(false);
+        }
+        return true;
+    }
+
+    bool StreamWriter::Add(std::string_view json)
+    {
+        m_record.Clear();
+        if (!m_transcoder.Transcode(json.data(), json.size(), m_record))
+        {
+            return false;
+        }
+        return this->Add(View(m_record.GetData(), m_record.GetSize()));
+    }
+
+    bool StreamWriter::End()
+    {
+        if (m_out == nullptr)
+        {
+            return false;
+        }
+
+        uint64_t index_pos = this->GetPosition();
+        for (uint64_t offset : m_index)
+        {
+            m_out->Write(offset);
+        }
+        m_out->Write(index_pos);
+        m_out->Write((uint64_t) m_index.size());
+        m_out->Write(STREAM_INDEX_MAGIC, sizeof(STREAM_INDEX_MAGIC));
+
+        bool result = true;
+        if (m_file)
+        {
+            this->Flush(true);
+            result = !ferror(m_file);
+        }
+        m_out = nullptr;
+        m_file = nullptr;
+        return result;
+    }
+
+    void StreamWriter::Flush(bool all)
+    {
+        // a multiple of 8 bytes is written, so the buffer keeps starting at an aligned stream position
+        size_t size = all ? m_out->GetSize() : m_out->GetSize() & ~(size_t) 7;
+        fwrite(m_out->GetData(), 1, size, m_file);
+        uint8_t rest[8];
+        size_t rest_size = m_out->GetSize() - size;
+        memcpy(rest, m_out->GetData() + size, rest_size);
+        m_out->Clear();
+        m_out->Write(rest, rest_size);
+        m_flushed += size;
+    }
+
+    StreamReader::StreamReader():
+        m_begin(nullptr),
+        m_records(nullptr),
+        m_records_end(nullptr),
+        m_index(nullptr),
+        m_count(0)
+    {
+
+    }
+
+    StreamReader::StreamReader(const void* data, size_t size):
+        StreamReader()
+    {
+        const uint8_t* begin = (const uint8_t*) data;
+        const uint8_t* end = begin + size;
+        if (data == nullptr || size < HEADER_SIZE || memcmp(begin, STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0 ||
+            begin[4] != STREAM_VERSION)
+        {
+            return;
+        }
+
+        const uint8_t* records = begin + HEADER_SIZE;
+        if (begin[5] & FLAG_DICTIONARY)
+        {
+            records = m_strings.ReadDictionary(records, end);
+            if (records == nullptr)
+            {
+                return;
+            }
+        }
+        m_begin = begin;
+        m_records = records;
+        m_records_end = end;
+
+        // without a well formed trailer the records are only reachable by walking them
+        if ((size_t) (end - records) < STREAM_TRAILER_SIZE ||
+            memcmp(end - sizeof(STREAM_INDEX_MAGIC), STREAM_INDEX_MAGIC, sizeof(STREAM_INDEX_MAGIC)) != 0)
+        {
+            return;
+        }
+        const uint8_t* trailer = end - STREAM_TRAILER_SIZE;
+        uint64_t index_pos = 0;
+        uint64_t count = 0;
+        memcpy(&index_pos, trailer, sizeof(index_pos));
+        memcpy(&count, trailer + 8, sizeof(count));
+        if (index_pos < (uint64_t) (records - begin) || index_pos > (uint64_t) (trailer - begin) ||
+            count != (uint64_t) (trailer - begin - index_pos) / 8)
+        {
+            return;
+        }
+        m_records_end = begin + index_pos;
+        m_index = m_records_end;
+        m_count = (size_t) count;
+    }
+
+    View StreamReader::GetRecord(size_t index) const
+    {
+        if (index >= m_count)
+        {
+            return View();
+        }
+        uint64_t offset = 0;
+        memcpy(&offset, m_index + index * 8, sizeof(offset));
+        if (offset < (uint64_t) (m_records - m_begin) || offset > (uint64_t) (m_records_end - m_begin))
+        {
+            return View();
+        }
+        return this->GetRecordAt(m_begin + offset);
+    }
+
+    View StreamReader::GetRecordAt(const uint8_t* frame) const
+    {
+        if ((size_t) (m_records_end - frame) < FRAME_SIZE)
+        {
+            return View();
+        }
+        uint32_t size = 0;
+        memcpy(&size, frame, sizeof(size));
+        if (size > (size_t) (m_records_end - frame - FRAME_SIZE))
+        {
+            return View();
+        }
+        return View(m_strings, frame + FRAME_SIZE, size);
+    }
+
+    StreamReader::Iterator StreamReader::begin() const
+    {
+        return Iterator(this, m_records);
+    }
+
+    StreamReader::Iterator StreamReader::end() const
+    {
+        return Iterator(this, m_records_end);
+    }
+
+    StreamReader::Iterator::Iterator():
+        m_reader(nullptr),
+        m_frame(nullptr),
+        m_index(0)
+    {
+
+    }
+
+    StreamReader::Iterator::Iterator(const StreamReader* reader, const uint8_t* frame):
+        m_reader(reader),
+        m_frame(frame),
+        m_index(0)
+    {
+        // a frame running past the records, a stream cut short, ends the walk
+        if (frame != reader->m_records_end && !reader->GetRecordAt(frame).IsValid())
+        {
+            m_frame = reader->m_records_end;
+        }
+    }
+
+    View StreamReader::Iterator::operator*() const
+    {
+        return m_reader->GetRecordAt(m_frame);
+    }
+
+    StreamReader::Iterator& StreamReader::Iterator::operator++()
+    {
+        uint32_t size = 0;
+        memcpy(&size, m_frame, sizeof(size));
+        size_t index = m_index + 1;
+        *this = Iterator(m_reader, m_frame + FRAME_SIZE + size);
+        m_index = index;
+        return *this;
+    }
+}
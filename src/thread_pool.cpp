@@ -0,0 +1,159 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "thread_pool.h"
+
+namespace jsonb
+{
+    namespace
+    {
+        thread_local const ThreadPool* t_pool = nullptr;
+        thread_local int t_index = 0;
+    }
+
+    ThreadPool::ThreadPool(int count):
+        m_count(count < 1 ? 1 : count),
+        m_queues(new Queue[m_count]),
+        m_queued(0),
+        m_stop(false)
+    {
+        for (int i = 1; i < m_count; ++i)
+        {
+            m_threads.emplace_back(&ThreadPool::Work, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    int ThreadPool::GetCurrentIndex() const
+    {
+        return t_pool == this ? t_index : 0;
+    }
+
+    void ThreadPool::Run(Group& group, std::function<void()> task)
+    {
+        group.m_pending.fetch_add(1, std::memory_order_relaxed);
+        Queue& queue = m_queues[this->GetCurrentIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back({ std::move(task), &group });
+        }
+        m_queued.fetch_add(1);
+
+        // taking the lock orders the wake-up after a sleeping thread checked m_queued
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_wake.notify_one();
+    }
+
+    void ThreadPool::Wait(Group& group)
+    {
+        int index = this->GetCurrentIndex();
+        while (group.m_pending.load(std::memory_order_acquire) > 0)
+        {
+            Task task;
+            if (this->Pop(index, task))
+            {
+                this->Execute(task);
+                continue;
+            }
+
+            // the remaining tasks of group run on other threads, sleep until
+            // they are done or a task to help with comes up
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, &group]() {
+                return group.m_pending.load(std::memory_order_acquire) == 0 || m_queued.load() > 0;
+            });
+        }
+    }
+
+    bool ThreadPool::Pop(int index, Task& task)
+    {
+        for (int i = 0; i < m_count; ++i)
+        {
+            Queue& queue = m_queues[(index + i) % m_count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+
+            // newest of the own queue, oldest of another
+            if (i == 0)
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            m_queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::Execute(Task& task)
+    {
+        task.run();
+        // group may be gone as soon as the count drops, only the pool is touched after that
+        if (task.group->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+            }
+            m_wake.notify_all();
+        }
+    }
+
+    void ThreadPool::Work(int index)
+    {
+        t_pool = this;
+        t_index = index;
+        for (;;)
+        {
+            Task task;
+            if (this->Pop(index, task))
+            {
+                this->Execute(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stop || m_queued.load() > 0; });
+            if (m_stop)
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jsonb
+{
+    // fork-join pool where every thread owns a queue. a thread takes its newest task first
+    // and steals the oldest one of another queue when its own is empty, so big subtrees
+    // are shared out early and small ones stay with the thread that split them
+    class ThreadPool
+    {
+    public:
+        // tasks run to completion before Wait() on their group returns
+        class Group
+        {
+        public:
+            Group(): m_pending(0) { }
+
+        private:
+            friend class ThreadPool;
+            std::atomic<size_t> m_pending;
+        };
+
+        // count threads take part, the one calling Wait() and count - 1 started here
+        explicit ThreadPool(int count);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        int GetThreadCount() const { return m_count; }
+        // 1 to count - 1 on the pool's own threads, 0 on any other thread
+        int GetCurrentIndex() const;
+        void Run(Group& group, std::function<void()> task);
+        // runs queued tasks, of any group, on this thread until the ones of group are done
+        void Wait(Group& group);
+
+    private:
+        struct Task
+        {
+            std::function<void()> run;
+            Group* group;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        bool Pop(int index, Task& task);
+        void Execute(Task& task);
+        void Work(int index);
+
+    private:
+        int m_count;
+        std::unique_ptr<Queue[]> m_queues;
+        std::vector<std::thread> m_threads;
+        std::atomic<size_t> m_queued;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        bool m_stop;
+    };
+}
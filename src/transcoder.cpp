@@ -0,0 +1,655 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/transcoder.h>
+#include "encoder.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace jsonb
+{
+    namespace
+    {
+        // same limit as jsoncpp's default stackLimit
+        const size_t MAX_DEPTH = 1000;
+
+        int HexDigit(char c)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f')
+            {
+                return c - 'a' + 10;
+            }
+            if (c >= 'A' && c <= 'F')
+            {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+
+        // reads the 4 hex digits of a \u escape
+        bool ReadHex4(const char*& p, const char* end, unsigned int& value)
+        {
+            if (end - p < 4)
+            {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                int digit = HexDigit(*p++);
+                if (digit < 0)
+                {
+                    return false;
+                }
+                value = (value << 4) | digit;
+            }
+            return true;
+        }
+
+        void AppendUtf8(std::string& str, unsigned int cp)
+        {
+            if (cp <= 0x7f)
+            {
+                str += (char) cp;
+            }
+            else if (cp <= 0x7ff)
+            {
+                str += (char) (0xc0 | (cp >> 6));
+                str += (char) (0x80 | (cp & 0x3f));
+            }
+            else if (cp <= 0xffff)
+            {
+                str += (char) (0xe0 | (cp >> 12));
+                str += (char) (0x80 | ((cp >> 6) & 0x3f));
+                str += (char) (0x80 | (cp & 0x3f));
+            }
+            else if (cp <= 0x10ffff)
+            {
+                str += (char) (0xf0 | (cp >> 18));
+                str += (char) (0x80 | ((cp >> 12) & 0x3f));
+                str += (char) (0x80 | ((cp >> 6) & 0x3f));
+                str += (char) (0x80 | (cp & 0x3f));
+            }
+        }
+
+        bool IsDigit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+    }
+
+    Transcoder::Transcoder():
+        m_begin(nullptr),
+        m_pos(nullptr),
+        m_end(nullptr),
+        m_moved(false),
+        m_error_offset(0)
+    {
+
+    }
+
+    bool Transcoder::Transcode(const char* json, size_t size, BufferWriter& writer)
+    {
+        m_begin = json;
+        m_pos = json;
+        m_end = json + size;
+        m_stack.clear();
+        m_offsets.clear();
+        m_error.clear();
+        m_error_offset = 0;
+
+        m_moved = false;
+
+        size_t start = writer.GetSize();
+        encoder::WriteHeader(writer);
+        if (!this->Parse(writer))
+        {
+            writer.Truncate(start);
+            return false;
+        }
+
+        // members sorted into place took their typed arrays along, out of alignment
+        if (m_moved)
+        {
+            encoder::AlignTypedArrays(writer.GetData(), start + HEADER_SIZE);
+        }
+        return true;
+    }
+
+    bool Transcoder::Parse(BufferWriter& writer)
+    {
+        for (;;)
+        {
+            // a value is expected here
+            if (!this->SkipSpace())
+            {
+                return false;
+            }
+            if (m_pos == m_end)
+            {
+                return this->Fail("unexpected end of input");
+            }
+
+            bool close = false;
+            char c = *m_pos;
+            if (c == '{' || c == '[')
+            {
+                if (m_stack.size() >= MAX_DEPTH)
+                {
+                    return this->Fail("nesting too deep");
+                }
+                ++m_pos;
+
+                Frame frame;
+                frame.object = c == '{';
+                frame.body_pos = encoder::BeginContainer(writer, frame.object ? ValueType::Object : ValueType::Array);
+                frame.first_offset = m_offsets.size();
+                m_stack.push_back(frame);
+
+                // like jsoncpp, an empty array may not hold a comment
+                if (!this->SkipSpace(frame.object))
+                {
+                    return false;
+                }
+                if (m_pos < m_end && *m_pos == (frame.object ? '}' : ']'))
+                {
+                    ++m_pos;
+                    close = true;
+                }
+                else
+                {
+                    if (!this->BeginMember(writer, frame))
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+            }
+            else if (c == '"')
+            {
+                if (!this->ParseString(writer))
+                {
+                    return false;
+                }
+            }
+            else if (c == 't')
+            {
+                if (!this->ParseLiteral("true", 4))
+                {
+                    return false;
+                }
+                encoder::WriteBool(writer, true);
+            }
+            else if (c == 'f')
+            {
+                if (!this->ParseLiteral("false", 5))
+                {
+                    return false;
+                }
+                encoder::WriteBool(writer, false);
+            }
+            else if (c == 'n')
+            {
+                if (!this->ParseLiteral("null", 4))
+                {
+                    return false;
+                }
+                encoder::WriteNull(writer);
+            }
+            else if (c == '-' || IsDigit(c))
+            {
+                if (!this->ParseNumber(writer))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                return this->Fail("value, object or array expected");
+            }
+
+            // the value is complete, close containers until one expects another child
+            for (;;)
+            {
+                if (close)
+                {
+                    Frame frame = m_stack.back();
+                    m_stack.pop_back();
+                    // checked before the offsets are used, past this they have wrapped
+                    if (writer.GetSize() - frame.body_pos > MAX_CONTAINER_SIZE)
+                    {
+                        return this->Fail("container too big for 32 bit sizes");
+                    }
+                    if (frame.object)
+                    {
+                        this->EndObject(writer, frame);
+                    }
+                    else
+                    {
+                        encoder::EndArray(writer, frame.body_pos, m_offsets, frame.first_offset, m_scratch);
+                    }
+                    close = false;
+                }
+
+                // anything after the root value is ignored, like jsoncpp does by default
+                if (m_stack.empty())
+                {
+                    return true;
+                }
+
+                const Frame& frame = m_stack.back();
+                if (!this->SkipSpace())
+                {
+                    return false;
+                }
+                if (m_pos == m_end)
+                {
+                    return this->Fail("unexpected end of input");
+                }
+
+                c = *m_pos++;
+                if (c == ',')
+                {
+                    if (!this->BeginMember(writer, frame))
+                    {
+                        return false;
+                    }
+                    break;
+                }
+                if (c == (frame.object ? '}' : ']'))
+                {
+                    close = true;
+                    continue;
+                }
+                --m_pos;
+                return this->Fail(frame.object ? "missing ',' or '}' in object" : "missing ',' or ']' in array");
+            }
+        }
+    }
+
+    bool Transcoder::BeginMember(BufferWriter& writer, const Frame& frame)
+    {
+        m_offsets.push_back((uint32_t) (writer.GetSize() - frame.body_pos));
+        if (!frame.object)
+        {
+            return true;
+        }
+
+        if (!this->SkipSpace())
+        {
+            return false;
+        }
+        if (m_pos == m_end || *m_pos != '"')
+        {
+            return this->Fail("missing '}' or object member name");
+        }
+        if (!this->ParseString(writer))
+        {
+            return false;
+        }
+
+        // jsoncpp does not allow comments in front of the colon
+        this->SkipSpace(false);
+        if (m_pos == m_end || *m_pos != ':')
+        {
+            return this->Fail("missing ':' after object member name");
+        }
+        ++m_pos;
+        return true;
+    }
+
+    void Transcoder::EndObject(BufferWriter& writer, const Frame& frame)
+    {
+        size_t count = m_offsets.size() - frame.first_offset;
+        const uint32_t* offsets = m_offsets.data() + frame.first_offset;
+        const uint8_t* body = writer.GetData() + frame.body_pos;
+
+        // members are often written in key order already
+        bool sorted = true;
+        for (size_t i = 1; i < count && sorted; ++i)
+        {
+            sorted = encoder::ReadKey(body + offsets[i - 1]) < encoder::ReadKey(body + offsets[i]);
+        }
+
+        if (!sorted)
+        {
+            // jsoncpp keeps members in a map: ordered by key bytes, the last duplicate wins
+            size_t body_size = writer.GetSize() - frame.body_pos;
+            m_order.resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                m_order[i] = (uint32_t) i;
+            }
+            std::stable_sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+                return encoder::ReadKey(body + offsets[a]) < encoder::ReadKey(body + offsets[b]);
+            });
+
+            m_scratch.Clear();
+            size_t kept = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint32_t index = m_order[i];
+                if (i + 1 < count && encoder::ReadKey(body + offsets[m_order[i + 1]]) == encoder::ReadKey(body + offsets[index]))
+                {
+                    continue;
+                }
+
+                size_t begin = offsets[index];
+                size_t end = index + 1 < count ? offsets[index + 1] : body_size;
+
+                // kept never passes i, so the slot is free to hold the new offset
+                m_order[kept++] = (uint32_t) m_scratch.GetSize();
+                m_scratch.Write(body + begin, end - begin);
+            }
+
+            memcpy(writer.GetData() + frame.body_pos, m_scratch.GetData(), m_scratch.GetSize());
+            m_moved = true;
+            writer.Truncate(frame.body_pos + m_scratch.GetSize());
+            m_offsets.resize(frame.first_offset);
+            m_offsets.insert(m_offsets.end(), m_order.begin(), m_order.begin() + kept);
+        }
+
+        encoder::EndContainer(writer, frame.body_pos, m_offsets, frame.first_offset);
+    }
+
+    bool Transcoder::ParseString(BufferWriter& writer)
+    {
+        // m_pos is on the opening quote
+        const char* begin = ++m_pos;
+        const char* p = begin;
+        bool escaped = false;
+        for (;;)
+        {
+            while (p < m_end && *p != '"' && *p != '\\')
+            {
+                ++p;
+            }
+            if (p == m_end)
+            {
+                return this->Fail("missing '\"' at the end of string");
+            }
+            if (*p == '"')
+            {
+                break;
+            }
+            escaped = true;
+            p += 2;
+            if (p > m_end)
+            {
+                return this->Fail("missing '\"' at the end of string");
+            }
+        }
+
+        if (!escaped)
+        {
+            encoder::WriteString(writer, begin, p - begin);
+            m_pos = p + 1;
+            return true;
+        }
+
+        // decode escapes the way jsoncpp does
+        const char* end = p;
+        m_string.clear();
+        p = begin;
+        while (p < end)
+        {
+            const char* run = p;
+            while (p < end && *p != '\\')
+            {
+                ++p;
+            }
+            m_string.append(run, p - run);
+            if (p == end)
+            {
+                break;
+            }
+
+            m_pos = p;
+            ++p;
+            char e = *p++;
+            switch (e)
+            {
+            case '"':
+                m_string += '"';
+                break;
+            case '/':
+                m_string += '/';
+                break;
+            case '\\':
+                m_string += '\\';
+                break;
+            case 'b':
+                m_string += '\b';
+                break;
+            case 'f':
+                m_string += '\f';
+                break;
+            case 'n':
+                m_string += '\n';
+                break;
+            case 'r':
+                m_string += '\r';
+                break;
+            case 't':
+                m_string += '\t';
+                break;
+            case 'u':
+            {
+                unsigned int cp = 0;
+                if (!ReadHex4(p, end, cp))
+                {
+                    return this->Fail("bad unicode escape sequence in string");
+                }
+                if (cp >= 0xd800 && cp <= 0xdbff)
+                {
+                    unsigned int low = 0;
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u')
+                    {
+                        return this->Fail("expecting the second half of a unicode surrogate pair");
+                    }
+                    p += 2;
+                    if (!ReadHex4(p, end, low))
+                    {
+                        return this->Fail("bad unicode escape sequence in string");
+                    }
+                    cp = 0x10000 + ((cp & 0x3ff) << 10) + (low & 0x3ff);
+                }
+                AppendUtf8(m_string, cp);
+                break;
+            }
+            default:
+                return this->Fail("bad escape sequence in string");
+            }
+        }
+
+        encoder::WriteString(writer, m_string.data(), m_string.size());
+        m_pos = end + 1;
+        return true;
+    }
+
+    bool Transcoder::ParseNumber(BufferWriter& writer)
+    {
+        // same token rules as jsoncpp: -? digits* (. digits*)? ([eE] [+-]? digits*)?
+        const char* begin = m_pos;
+        const char* p = begin;
+        bool negative = *p == '-';
+        if (negative)
+        {
+            ++p;
+        }
+        const char* digits = p;
+        while (p < m_end && IsDigit(*p))
+        {
+            ++p;
+        }
+        bool integer = true;
+        if (p < m_end && *p == '.')
+        {
+            integer = false;
+            ++p;
+            while (p < m_end && IsDigit(*p))
+            {
+                ++p;
+            }
+        }
+        if (p < m_end && (*p == 'e' || *p == 'E'))
+        {
+            integer = false;
+            ++p;
+            if (p < m_end && (*p == '+' || *p == '-'))
+            {
+                ++p;
+            }
+            while (p < m_end && IsDigit(*p))
+            {
+                ++p;
+            }
+        }
+        m_pos = p;
+
+        if (integer)
+        {
+            // integers that overflow 64 bits become reals
+            uint64_t max_value = negative ? (uint64_t) INT64_MAX + 1 : UINT64_MAX;
+            uint64_t threshold = max_value / 10;
+            uint64_t value = 0;
+            for (const char* d = digits; d < p && integer; ++d)
+            {
+                uint64_t digit = (uint64_t) (*d - '0');
+                if (value >= threshold && (value > threshold || d + 1 != p || digit > max_value % 10))
+                {
+                    integer = false;
+                    break;
+                }
+                value = value * 10 + digit;
+            }
+
+            if (integer)
+            {
+                if (negative)
+                {
+                    encoder::WriteInt64(writer, (int64_t) (0 - value));
+                }
+                else if (value <= (uint64_t) INT32_MAX)
+                {
+                    encoder::WriteInt64(writer, (int64_t) value);
+                }
+                else
+                {
+                    encoder::WriteUint64(writer, value);
+                }
+                return true;
+            }
+        }
+
+        char buffer[64];
+        std::string long_buffer;
+        size_t size = p - begin;
+        const char* str = buffer;
+        if (size < sizeof(buffer))
+        {
+            memcpy(buffer, begin, size);
+            buffer[size] = 0;
+        }
+        else
+        {
+            long_buffer.assign(begin, size);
+            str = long_buffer.c_str();
+        }
+
+        char* number_end = nullptr;
+        double d = strtod(str, &number_end);
+        if (number_end == str)
+        {
+            m_pos = begin;
+            return this->Fail("not a number");
+        }
+        encoder::WriteReal(writer, d);
+        return true;
+    }
+
+    bool Transcoder::ParseLiteral(const char* literal, size_t size)
+    {
+        if ((size_t) (m_end - m_pos) < size || memcmp(m_pos, literal, size) != 0)
+        {
+            return this->Fail("syntax error");
+        }
+        m_pos += size;
+        return true;
+    }
+
+    bool Transcoder::SkipSpace(bool comments)
+    {
+        while (m_pos < m_end)
+        {
+            char c = *m_pos;
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                ++m_pos;
+            }
+            else if (c == '/' && comments)
+            {
+                // comments are allowed anywhere between tokens
+                if (m_end - m_pos < 2)
+                {
+                    return this->Fail("syntax error");
+                }
+                if (m_pos[1] == '*')
+                {
+                    const char* p = m_pos + 2;
+                    while (p + 1 < m_end && !(p[0] == '*' && p[1] == '/'))
+                    {
+                        ++p;
+                    }
+                    if (p + 1 >= m_end)
+                    {
+                        return this->Fail("unterminated comment");
+                    }
+                    m_pos = p + 2;
+                }
+                else if (m_pos[1] == '/')
+                {
+                    m_pos += 2;
+                    while (m_pos < m_end && *m_pos != '\n' && *m_pos != '\r')
+                    {
+                        ++m_pos;
+                    }
+                }
+                else
+                {
+                    return this->Fail("syntax error");
+                }
+            }
+            else
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool Transcoder::Fail(const char* message)
+    {
+        m_error = message;
+        m_error_offset = (size_t) (m_pos - m_begin);
+        return false;
+    }
+}
@@ -0,0 +1,606 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/validator.h>
+#include "encoder.h"
+#include "format.h"
+#include "lz.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSONB_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace jsonb
+{
+    namespace
+    {
+        const char* const MESSAGES[] = {
+            "ok",
+            "truncated",
+            "bad header",
+            "bad dictionary",
+            "bad type tag",
+            "bad container layout",
+            "bad value",
+            "bad object key",
+            "bad dictionary reference",
+            "bad utf-8",
+            "bad compressed block",
+            "too deep",
+            "trailing bytes",
+            "bad json",
+            "can not open file",
+            "delta made from another buffer",
+            "bad checksum",
+        };
+
+        // UTF-8 as RFC 3629 has it, except that the surrogates a lone \u escape
+        // turns into are let through like json parsers do
+        bool IsUtf8(const uint8_t* p, size_t size)
+        {
+            const uint8_t* end = p + size;
+            while (p < end)
+            {
+                // ascii runs go 16 or 8 bytes at a time
+#if JSONB_SSE2
+                while (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) p)) == 0)
+                {
+                    p += 16;
+                }
+#else
+                while (end - p >= 8)
+                {
+                    uint64_t word;
+                    memcpy(&word, p, sizeof(word));
+                    if (word & 0x8080808080808080ull)
+                    {
+                        break;
+                    }
+                    p += 8;
+                }
+#endif
+                while (p < end && *p < 0x80)
+                {
+                    ++p;
+                }
+                if (p == end)
+                {
+                    break;
+                }
+
+                // one multibyte sequence, its second byte has the tightest range
+                uint8_t c = *p;
+                int tail;
+                uint8_t low = 0x80;
+                uint8_t high = 0xbf;
+                if (c >= 0xc2 && c <= 0xdf)
+                {
+                    tail = 1;
+                }
+                else if (c >= 0xe0 && c <= 0xef)
+                {
+                    tail = 2;
+                    low = c == 0xe0 ? 0xa0 : 0x80;
+                }
+                else if (c >= 0xf0 && c <= 0xf4)
+                {
+                    tail = 3;
+                    low = c == 0xf0 ? 0x90 : 0x80;
+                    high = c == 0xf4 ? 0x8f : 0xbf;
+                }
+                else
+                {
+                    return false;
+                }
+                if (end - p - 1 < tail || p[1] < low || p[1] > high)
+                {
+                    return false;
+                }
+                for (int i = 2; i <= tail; ++i)
+                {
+                    if ((p[i] & 0xc0) != 0x80)
+                    {
+                        return false;
+                    }
+                }
+                p += 1 + tail;
+            }
+            return true;
+        }
+
+        // reads a length written with WriteInt64, returns the position after it or nullptr
+        const uint8_t* ReadLength(const uint8_t* p, const uint8_t* end, size_t& size)
+        {
+            if (p >= end)
+            {
+                return nullptr;
+            }
+            ValueType type = (ValueType) *p;
+            int bytes = ScalarSize(type);
+            if (bytes < 0 || end - p - 1 < bytes)
+            {
+                return nullptr;
+            }
+            int64_t length = 0;
+            switch (type)
+            {
+            case ValueType::Uint8:
+                length = p[1];
+                break;
+            case ValueType::Int8:
+                length = (int8_t) p[1];
+                break;
+            case ValueType::Uint16:
+            {
+                uint16_t v;
+                memcpy(&v, p + 1, sizeof(v));
+                length = v;
+                break;
+            }
+            case ValueType::Int16:
+            {
+                int16_t v;
+                memcpy(&v, p + 1, sizeof(v));
+                length = v;
+                break;
+            }
+            case ValueType::Int32:
+            {
+                int32_t v;
+                memcpy(&v, p + 1, sizeof(v));
+                length = v;
+                break;
+            }
+            default:
+                return nullptr;
+            }
+            if (length < 0)
+            {
+                return nullptr;
+            }
+            size = (size_t) length;
+            return p + 1 + bytes;
+        }
+    }
+
+    const char* Status::GetMessage() const
+    {
+        size_t index = (size_t) m_error;
+        return index < sizeof(MESSAGES) / sizeof(MESSAGES[0]) ? MESSAGES[index] : "unknown error";
+    }
+
+    Validator::Validator():
+        m_view(nullptr),
+        m_begin(nullptr),
+        m_version(0),
+        m_blocks(false),
+        m_max_depth(DEFAULT_MAX_DEPTH),
+        m_check_utf8(true),
+        m_block(nullptr),
+        m_open_blocks(0)
+    {
+    }
+
+    Status Validator::Validate(const void* binary, size_t size)
+    {
+        if (binary == nullptr || size == 0)
+        {
+            return Status(Error::Truncated, 0);
+        }
+        const uint8_t* begin = (const uint8_t*) binary;
+        const uint8_t* end = begin + size;
+        Header header = ReadHeader(begin, size);
+        if ((header.version != 1 && header.version != FORMAT_VERSION) ||
+            (header.flags & ~(FLAG_DICTIONARY | FLAG_BLOCKS)) != 0)
+        {
+            return Status(Error::BadHeader, 0);
+        }
+
+        View view(binary, size);
+        m_view = &view;
+        m_begin = begin;
+        m_version = header.version;
+        m_blocks = header.version >= 2 && (header.flags & FLAG_BLOCKS) != 0;
+        m_block = nullptr;
+        m_open_blocks = 0;
+        m_status = Status();
+        m_starts.clear();
+
+        const uint8_t* root = header.version >= 2 ? begin + HEADER_SIZE : begin;
+        if (header.version >= 2 && (header.flags & FLAG_DICTIONARY))
+        {
+            root = this->ValidateDictionary(root, end);
+        }
+        if (root != nullptr && root >= end)
+        {
+            this->Fail(Error::Truncated, root);
+        }
+        else if (root != nullptr)
+        {
+            const uint8_t* p = this->ValidateValue(root, end, 0);
+            if (p != nullptr && p != end)
+            {
+                this->Fail(Error::TrailingBytes, p);
+            }
+        }
+        m_view = nullptr;
+        return m_status;
+    }
+
+    Status Validator::Validate(const View& view)
+    {
+        if (!view.IsValid())
+        {
+            return Status(Error::BadHeader, 0);
+        }
+        size_t size = view.GetEnd() - view.GetBegin();
+        if (view.GetVersion() < 2 || ReadHeader(view.GetBegin(), size).version >= 2)
+        {
+            return this->Validate(view.GetBegin(), size);
+        }
+
+        // a record starts at its root and reads the strings of its stream
+        m_view = &view;
+        m_begin = view.GetBegin();
+        m_version = FORMAT_VERSION;
+        m_blocks = false;
+        m_block = nullptr;
+        m_open_blocks = 0;
+        m_status = Status();
+        m_starts.clear();
+        const uint8_t* p = this->ValidateValue(view.GetBegin(), view.GetEnd(), 0);
+        if (p != nullptr && p != view.GetEnd())
+        {
+            this->Fail(Error::TrailingBytes, p);
+        }
+        m_view = nullptr;
+        return m_status;
+    }
+
+    const uint8_t* Validator::ValidateValue(const uint8_t* p, const uint8_t* end, int depth)
+    {
+        if (p >= end)
+        {
+            return this->Fail(Error::Truncated, p);
+        }
+        ValueType type = (ValueType) *p;
+        switch (type)
+        {
+        case ValueType::Object:
+        case ValueType::Array:
+            return this->ValidateContainer(p, end, depth);
+        case ValueType::String:
+        {
+            std::string_view str;
+            return this->ValidateString(p, end, str);
+        }
+        case ValueType::StringRef8:
+        case ValueType::StringRef16:
+        case ValueType::StringRef32:
+        {
+            int size = ScalarSize(type);
+            if (end - p - 1 < size)
+            {
+                return this->Fail(Error::Truncated, p);
+            }
+            if (LoadOffset(p + 1, size) >= m_view->GetStringCount())
+            {
+                return this->Fail(Error::BadStringRef, p);
+            }
+            return p + 1 + size;
+        }
+        case ValueType::TypedArray:
+        {
+            TypedArray a;
+            if (!ReadTypedArray(p, end, a))
+            {
+                return this->Fail(Error::BadLayout, p);
+            }
+            return a.end;
+        }
+        case ValueType::Block:
+            if (!m_blocks)
+            {
+                return this->Fail(Error::BadTag, p);
+            }
+            return this->ValidateBlock(p, end, depth);
+        case ValueType::Bool:
+            if (end - p < 2)
+            {
+                return this->Fail(Error::Truncated, p);
+            }
+            return p[1] <= 1 ? p + 2 : this->Fail(Error::BadValue, p);
+        case ValueType::Decimal:
+            if (end - p < 6)
+            {
+                return this->Fail(Error::Truncated, p);
+            }
+            return p[1] <= MAX_DECIMAL_SCALE ? p + 6 : this->Fail(Error::BadValue, p);
+        default:
+        {
+            int size = ScalarSize(type);
+            if (size < 0)
+            {
+                return this->Fail(Error::BadTag, p);
+            }
+            if (end - p - 1 < size)
+            {
+                return this->Fail(Error::Truncated, p);
+            }
+            return p + 1 + size;
+        }
+        }
+    }
+
+    const uint8_t* Validator::ValidateContainer(const uint8_t* p, const uint8_t* end, int depth)
+    {
+        if (depth >= m_max_depth)
+        {
+            return this->Fail(Error::TooDeep, p);
+        }
+        bool object = (ValueType) *p == ValueType::Object;
+
+        // v1 containers are a count and the children back to back
+        if (m_version < 2)
+        {
+            size_t count = 0;
+            const uint8_t* q = ReadLength(p + 1, end, count);
+            if (q == nullptr)
+            {
+                return this->Fail(end - p < 2 ? Error::Truncated : Error::BadLayout, p);
+            }
+            for (size_t i = 0; i < count && q; ++i)
+            {
+                if (object)
+                {
+                    std::string_view key;
+                    q = q < end && (ValueType) *q != ValueType::String ? this->Fail(Error::BadKey, q) : this->ValidateString(q, end, key);
+                }
+                q = q ? this->ValidateValue(q, end, depth + 1) : nullptr;
+            }
+            return q;
+        }
+
+        if ((size_t) (end - p) < 1 + CONTAINER_SIZE_BYTES)
+        {
+            return this->Fail(Error::Truncated, p);
+        }
+        uint32_t size;
+        memcpy(&size, p + 1, sizeof(size));
+        if ((size_t) (end - p - 1 - CONTAINER_SIZE_BYTES) < size)
+        {
+            return this->Fail(Error::Truncated, p);
+        }
+        Container c;
+        if (!ReadContainer(p, end, c))
+        {
+            return this->Fail(Error::BadLayout, p);
+        }
+
+        // the children fill the body up to the offset table, back to back
+        size_t first = m_starts.size();
+        const uint8_t* q = c.body;
+        for (size_t i = 0; i < c.count; ++i)
+        {
+            if (q >= c.table)
+            {
+                return this->Fail(Error::BadLayout, p);
+            }
+            m_starts.push_back((uint32_t) (q - c.body));
+            if (object)
+            {
+                ValueType key_type = (ValueType) *q;
+                if (key_type != ValueType::String && !IsStringRef(key_type))
+                {
+                    return this->Fail(Error::BadKey, q);
+                }
+                q = this->ValidateValue(q, c.table, depth + 1);
+                if (q == nullptr)
+                {
+                    return nullptr;
+                }
+            }
+            q = this->ValidateValue(q, c.table, depth + 1);
+            if (q == nullptr)
+            {
+                return nullptr;
+            }
+        }
+        if (q != c.table)
+        {
+            return this->Fail(Error::BadLayout, q);
+        }
+
+        // and the offset table lists each of them once, usually in the same order
+        size_t i = 0;
+        while (i < c.count && LoadOffset(c.table + i * c.width, c.width) == m_starts[first + i])
+        {
+            ++i;
+        }
+        if (i < c.count)
+        {
+            m_sorted.resize(c.count);
+            for (size_t j = 0; j < c.count; ++j)
+            {
+                m_sorted[j] = LoadOffset(c.table + j * c.width, c.width);
+            }
+            std::sort(m_sorted.begin(), m_sorted.end());
+            if (!std::equal(m_sorted.begin(), m_sorted.end(), m_starts.begin() + first))
+            {
+                return this->Fail(Error::BadLayout, c.table);
+            }
+        }
+        m_starts.resize(first);
+
+        // object keys come in order in the table, that is what lookups search
+        if (object)
+        {
+            std::string_view previous;
+            for (size_t j = 0; j < c.count; ++j)
+            {
+                const uint8_t* entry = c.body + LoadOffset(c.table + j * c.width, c.width);
+                std::string_view key = IsStringRef((ValueType) *entry) ?
+                    m_view->GetString(LoadOffset(entry + 1, ScalarSize((ValueType) *entry))) : encoder::ReadKey(entry);
+                if (j > 0 && key < previous)
+                {
+                    return this->Fail(Error::BadKey, entry);
+                }
+                previous = key;
+            }
+        }
+        return c.end;
+    }
+
+    const uint8_t* Validator::ValidateBlock(const uint8_t* p, const uint8_t* end, int depth)
+    {
+        Block b;
+        if (!ReadBlock(p, end, b))
+        {
+            return this->Fail((size_t) (end - p) < BLOCK_HEADER_SIZE ? Error::Truncated : Error::BadBlock, p);
+        }
+
+        // errors inside are reported at the outermost block, the raw bytes have no place in the input
+        const uint8_t* outer = m_block;
+        if (outer == nullptr)
+        {
+            m_block = p;
+        }
+        size_t level = m_open_blocks;
+        if (m_raw.size() <= level)
+        {
+            m_raw.emplace_back();
+        }
+        m_raw[level].Clear();
+        m_raw[level].Skip(b.raw_size);
+        // the buffer may move between levels, its bytes do not
+        const uint8_t* raw = m_raw[level].GetData();
+        if (!lz::Decompress(b.data, b.size, m_raw[level].GetData(), b.raw_size) || raw[0] != (uint8_t) b.type)
+        {
+            m_block = outer;
+            return this->Fail(Error::BadBlock, p);
+        }
+
+        ++m_open_blocks;
+        const uint8_t* q = this->ValidateValue(raw, raw + b.raw_size, depth);
+        --m_open_blocks;
+        if (q != nullptr)
+        {
+            // the count in the header is what readers size the container by before decompressing
+            Container c;
+            TypedArray a;
+            size_t count = b.type == ValueType::TypedArray ?
+                (ReadTypedArray(raw, raw + b.raw_size, a) ? a.count : 0) :
+                (ReadContainer(raw, raw + b.raw_size, c) ? c.count : 0);
+            if (q != raw + b.raw_size || count != b.count)
+            {
+                q = this->Fail(Error::BadBlock, p);
+            }
+        }
+        m_block = outer;
+        return q ? b.end : nullptr;
+    }
+
+    const uint8_t* Validator::ValidateString(const uint8_t* p, const uint8_t* end, std::string_view& str)
+    {
+        size_t size = 0;
+        const uint8_t* q = ReadLength(p + 1, end, size);
+        if (q == nullptr)
+        {
+            return this->Fail(end - p < 3 ? Error::Truncated : Error::BadLayout, p);
+        }
+        if ((size_t) (end - q) < size)
+        {
+            return this->Fail(Error::Truncated, p);
+        }
+        if (m_check_utf8 && !IsUtf8(q, size))
+        {
+            return this->Fail(Error::BadUtf8, p);
+        }
+        str = std::string_view((const char*) q, size);
+        return q + size;
+    }
+
+    const uint8_t* Validator::ValidateDictionary(const uint8_t* section, const uint8_t* end)
+    {
+        // size and count, then count + 1 offsets in front of the string bytes
+        if (end - section < 8)
+        {
+            return this->Fail(Error::Truncated, section);
+        }
+        uint32_t section_size;
+        uint32_t count;
+        memcpy(&section_size, section, sizeof(section_size));
+        memcpy(&count, section + 4, sizeof(count));
+        if ((size_t) (end - section - 4) < section_size)
+        {
+            return this->Fail(Error::Truncated, section);
+        }
+        if (section_size < 4 || count >= (section_size - 4) / 4)
+        {
+            return this->Fail(Error::BadDictionary, section);
+        }
+
+        // the strings tile the data and are sorted, each one once
+        const uint8_t* offsets = section + 8;
+        const uint8_t* data = offsets + ((size_t) count + 1) * 4;
+        size_t data_size = section_size - 4 - ((size_t) count + 1) * 4;
+        std::string_view previous;
+        uint32_t begin = 0;
+        memcpy(&begin, offsets, sizeof(begin));
+        if (begin != 0)
+        {
+            return this->Fail(Error::BadDictionary, offsets);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t string_end;
+            memcpy(&string_end, offsets + (i + 1) * 4, sizeof(string_end));
+            if (string_end < begin || string_end > data_size)
+            {
+                return this->Fail(Error::BadDictionary, offsets + (i + 1) * 4);
+            }
+            std::string_view str((const char*) data + begin, string_end - begin);
+            if (m_check_utf8 && !IsUtf8(data + begin, str.size()))
+            {
+                return this->Fail(Error::BadUtf8, data + begin);
+            }
+            if (i > 0 && !(previous < str))
+            {
+                return this->Fail(Error::BadDictionary, data + begin);
+            }
+            previous = str;
+            begin = string_end;
+        }
+        if (begin != data_size)
+        {
+            return this->Fail(Error::BadDictionary, section);
+        }
+        return section + 4 + section_size;
+    }
+
+    const uint8_t* Validator::Fail(Error error, const uint8_t* p)
+    {
+        if (m_status.IsOk())
+        {
+            m_status = Status(error, (size_t) ((m_block ? m_block : p) - m_begin));
+        }
+        return nullptr;
+    }
+}
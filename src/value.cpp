@@ -0,0 +1,565 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/value.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <utility>
+
+namespace jsonb
+{
+    namespace
+    {
+        const Value NULL_VALUE;
+        // what a write through operator[] lands in when there is nothing to write to, nulled on every use
+        thread_local Value t_dropped;
+    }
+
+    Value::Value(Kind kind): m_size(0), m_kind(kind)
+    {
+        m_uint = 0;
+        if (kind == Kind::Array || kind == Kind::Object)
+        {
+            m_items.data = nullptr;
+            m_items.capacity = 0;
+        }
+    }
+
+    Value::Value(std::string_view str): m_size((uint32_t) str.size()), m_kind(Kind::String)
+    {
+        // short strings live in the value itself
+        char* chars = m_inline;
+        if (str.size() > INLINE_SIZE)
+        {
+            m_chars = (char*) malloc(str.size());
+            if (m_chars == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            chars = m_chars;
+        }
+        if (!str.empty())
+        {
+            memcpy(chars, str.data(), str.size());
+        }
+    }
+
+    Value::Value(const ValueRef& ref): m_size(0), m_kind(Kind::Null)
+    {
+        m_uint = 0;
+        if (!ref.IsValid())
+        {
+            return;
+        }
+        switch (ref.GetKind())
+        {
+        case Kind::Bool:
+            Value(ref.AsBool()).Swap(*this);
+            break;
+        case Kind::Int:
+            Value((long long) ref.AsInt64()).Swap(*this);
+            break;
+        case Kind::Uint:
+            Value((unsigned long long) ref.AsUint64()).Swap(*this);
+            break;
+        case Kind::Real:
+            Value(ref.AsDouble()).Swap(*this);
+            break;
+        case Kind::String:
+            Value(ref.AsString()).Swap(*this);
+            break;
+        case Kind::Array:
+            Value(Kind::Array).Swap(*this);
+            this->Reserve(ref.Size());
+            for (auto i = ref.begin(); i != ref.end(); ++i)
+            {
+                this->Append(Value(*i));
+            }
+            break;
+        case Kind::Object:
+            Value(Kind::Object).Swap(*this);
+            this->Reserve(ref.Size());
+            for (auto i = ref.begin(); i != ref.end(); ++i)
+            {
+                (*this)[i.Key()] = Value(*i);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    Value::Value(const Value& other): m_size(0), m_kind(Kind::Null)
+    {
+        m_uint = 0;
+        switch (other.m_kind)
+        {
+        case Kind::String:
+            Value(other.AsString()).Swap(*this);
+            break;
+        case Kind::Array:
+            Value(Kind::Array).Swap(*this);
+            this->Reserve(other.m_size);
+            for (size_t i = 0; i < other.m_size; ++i)
+            {
+                new (this->GetElements() + i) Value(other.GetElements()[i]);
+            }
+            m_size = other.m_size;
+            break;
+        case Kind::Object:
+            Value(Kind::Object).Swap(*this);
+            this->Reserve(other.m_size);
+            for (size_t i = 0; i < other.m_size; ++i)
+            {
+                new (this->GetMembers() + i) Member(other.GetMembers()[i]);
+            }
+            m_size = other.m_size;
+            break;
+        default:
+            memcpy(m_inline, other.m_inline, INLINE_SIZE);
+            m_size = other.m_size;
+            m_kind = other.m_kind;
+            break;
+        }
+    }
+
+    Value::Value(Value&& other) noexcept: m_size(other.m_size), m_kind(other.m_kind)
+    {
+        memcpy(m_inline, other.m_inline, INLINE_SIZE);
+        other.m_size = 0;
+        other.m_kind = Kind::Null;
+    }
+
+    Value& Value::operator=(const Value& other)
+    {
+        Value copy(other);
+        this->Swap(copy);
+        return *this;
+    }
+
+    Value& Value::operator=(Value&& other) noexcept
+    {
+        // other may live inside this value, it is taken out before the old contents go
+        Value value(std::move(other));
+        this->Swap(value);
+        return *this;
+    }
+
+    void Value::Swap(Value& other) noexcept
+    {
+        char bytes[INLINE_SIZE];
+        memcpy(bytes, m_inline, INLINE_SIZE);
+        memcpy(m_inline, other.m_inline, INLINE_SIZE);
+        memcpy(other.m_inline, bytes, INLINE_SIZE);
+        std::swap(m_size, other.m_size);
+        std::swap(m_kind, other.m_kind);
+    }
+
+    void Value::Release()
+    {
+        switch (m_kind)
+        {
+        case Kind::String:
+            if (m_size > INLINE_SIZE)
+            {
+                free(m_chars);
+            }
+            break;
+        case Kind::Array:
+        case Kind::Object:
+            this->Clear();
+            free(m_items.data);
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool Value::AsBool() const
+    {
+        if (m_kind == Kind::Bool)
+        {
+            return m_bool;
+        }
+        return this->AsInt64() != 0;
+    }
+
+    int64_t Value::AsInt64() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return m_int;
+        case Kind::Uint:
+            return (int64_t) m_uint;
+        case Kind::Real:
+            return (int64_t) m_real;
+        default:
+            return 0;
+        }
+    }
+
+    uint64_t Value::AsUint64() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return (uint64_t) m_int;
+        case Kind::Uint:
+            return m_uint;
+        case Kind::Real:
+            return (uint64_t) m_real;
+        default:
+            return 0;
+        }
+    }
+
+    double Value::AsDouble() const
+    {
+        switch (m_kind)
+        {
+        case Kind::Int:
+            return (double) m_int;
+        case Kind::Uint:
+            return (double) m_uint;
+        case Kind::Real:
+            return m_real;
+        default:
+            return 0;
+        }
+    }
+
+    std::string_view Value::AsString() const
+    {
+        if (m_kind != Kind::String)
+        {
+            return std::string_view();
+        }
+        return std::string_view(m_size > INLINE_SIZE ? m_chars : m_inline, m_size);
+    }
+
+    const Value& Value::operator[](size_t index) const
+    {
+        if (m_kind == Kind::Array && index < m_size)
+        {
+            return this->GetElements()[index];
+        }
+        if (m_kind == Kind::Object && index < m_size)
+        {
+            return this->GetMembers()[index].value;
+        }
+        return NULL_VALUE;
+    }
+
+    Value& Value::operator[](size_t index)
+    {
+        if (m_kind == Kind::Object && index < m_size)
+        {
+            return this->GetMembers()[index].value;
+        }
+        if (m_kind == Kind::Null)
+        {
+            *this = Value(Kind::Array);
+        }
+        else if (m_kind != Kind::Array)
+        {
+            // an object or a scalar keeps its contents
+            t_dropped = Value();
+            return t_dropped;
+        }
+        if (index >= m_size)
+        {
+            this->Resize(index + 1);
+        }
+        return this->GetElements()[index];
+    }
+
+    const Value& Value::operator[](std::string_view key) const
+    {
+        const Value* value = this->Find(key);
+        return value ? *value : NULL_VALUE;
+    }
+
+    Value& Value::operator[](std::string_view key)
+    {
+        if (m_kind != Kind::Object)
+        {
+            // key may be this string
+            Value key_value(key);
+            *this = Value(Kind::Object);
+            Member* member = new (this->Open(0, sizeof(Member))) Member { std::move(key_value), Value() };
+            return member->value;
+        }
+
+        // members read from a sorted source come in order, they go straight to the end
+        size_t index = m_size;
+        if (m_size > 0 && !(this->GetMembers()[m_size - 1].key.AsString() < key))
+        {
+            index = this->LowerBound(key);
+            if (index < m_size && this->GetMembers()[index].key.AsString() == key)
+            {
+                return this->GetMembers()[index].value;
+            }
+        }
+        // key may point into a member that Open moves
+        Value key_value(key);
+        Member* member = new (this->Open(index, sizeof(Member))) Member { std::move(key_value), Value() };
+        return member->value;
+    }
+
+    std::string_view Value::GetKey(size_t index) const
+    {
+        if (m_kind != Kind::Object || index >= m_size)
+        {
+            return std::string_view();
+        }
+        return this->GetMembers()[index].key.AsString();
+    }
+
+    const Value* Value::Find(std::string_view key) const
+    {
+        if (m_kind != Kind::Object)
+        {
+            return nullptr;
+        }
+        size_t index = this->LowerBound(key);
+        if (index < m_size && this->GetMembers()[index].key.AsString() == key)
+        {
+            return &this->GetMembers()[index].value;
+        }
+        return nullptr;
+    }
+
+    Value* Value::Find(std::string_view key)
+    {
+        return const_cast<Value*>(static_cast<const Value*>(this)->Find(key));
+    }
+
+    Value& Value::Append(Value value)
+    {
+        if (m_kind != Kind::Array)
+        {
+            *this = Value(Kind::Array);
+        }
+        return *new (this->Open(m_size, sizeof(Value))) Value(std::move(value));
+    }
+
+    Value& Value::Insert(size_t index, Value value)
+    {
+        if (m_kind != Kind::Array)
+        {
+            *this = Value(Kind::Array);
+        }
+        if (index > m_size)
+        {
+            index = m_size;
+        }
+        return *new (this->Open(index, sizeof(Value))) Value(std::move(value));
+    }
+
+    void Value::Erase(size_t index)
+    {
+        if ((m_kind != Kind::Array && m_kind != Kind::Object) || index >= m_size)
+        {
+            return;
+        }
+
+        size_t item_size = m_kind == Kind::Array ? sizeof(Value) : sizeof(Member);
+        if (m_kind == Kind::Array)
+        {
+            this->GetElements()[index].~Value();
+        }
+        else
+        {
+            this->GetMembers()[index].~Member();
+        }
+        uint8_t* item = (uint8_t*) m_items.data + index * item_size;
+        memmove(item, item + item_size, (m_size - index - 1) * item_size);
+        m_size -= 1;
+    }
+
+    bool Value::Remove(std::string_view key)
+    {
+        if (m_kind != Kind::Object)
+        {
+            return false;
+        }
+        size_t index = this->LowerBound(key);
+        if (index == m_size || this->GetMembers()[index].key.AsString() != key)
+        {
+            return false;
+        }
+        this->Erase(index);
+        return true;
+    }
+
+    void Value::Resize(size_t size)
+    {
+        if (m_kind != Kind::Array)
+        {
+            *this = Value(Kind::Array);
+        }
+        this->Reserve(size);
+        for (size_t i = size; i < m_size; ++i)
+        {
+            this->GetElements()[i].~Value();
+        }
+        for (size_t i = m_size; i < size; ++i)
+        {
+            new (this->GetElements() + i) Value();
+        }
+        m_size = (uint32_t) size;
+    }
+
+    void Value::Reserve(size_t size)
+    {
+        if ((m_kind == Kind::Array || m_kind == Kind::Object) && size > m_items.capacity)
+        {
+            this->Grow(size, m_kind == Kind::Array ? sizeof(Value) : sizeof(Member));
+        }
+    }
+
+    void Value::Clear()
+    {
+        if (m_kind == Kind::Array)
+        {
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                this->GetElements()[i].~Value();
+            }
+        }
+        else if (m_kind == Kind::Object)
+        {
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                this->GetMembers()[i].~Member();
+            }
+        }
+        else
+        {
+            return;
+        }
+        m_size = 0;
+    }
+
+    bool Value::operator==(const Value& other) const
+    {
+        if (this->IsInt() && other.IsInt() && m_kind != other.m_kind)
+        {
+            // an int equals a uint if it is not negative
+            const Value& i = m_kind == Kind::Int ? *this : other;
+            const Value& u = m_kind == Kind::Int ? other : *this;
+            return i.m_int >= 0 && (uint64_t) i.m_int == u.m_uint;
+        }
+        if (m_kind != other.m_kind)
+        {
+            return false;
+        }
+
+        switch (m_kind)
+        {
+        case Kind::Null:
+            return true;
+        case Kind::Bool:
+            return m_bool == other.m_bool;
+        case Kind::Int:
+            return m_int == other.m_int;
+        case Kind::Uint:
+            return m_uint == other.m_uint;
+        case Kind::Real:
+            return m_real == other.m_real;
+        case Kind::String:
+            return this->AsString() == other.AsString();
+        case Kind::Array:
+            if (m_size != other.m_size)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                if (this->GetElements()[i] != other.GetElements()[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        case Kind::Object:
+            // both sorted, equal objects line up member by member
+            if (m_size != other.m_size)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                const Member& a = this->GetMembers()[i];
+                const Member& b = other.GetMembers()[i];
+                if (a.key.AsString() != b.key.AsString() || a.value != b.value)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    size_t Value::LowerBound(std::string_view key) const
+    {
+        // string_view compares bytes as unsigned, then length, like the offset tables
+        size_t low = 0;
+        size_t high = m_size;
+        while (low < high)
+        {
+            size_t mid = (low + high) / 2;
+            if (this->GetMembers()[mid].key.AsString() < key)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    void* Value::Open(size_t index, size_t item_size)
+    {
+        if (m_size == m_items.capacity)
+        {
+            this->Grow(m_size < 4 ? 4 : (size_t) m_size * 2, item_size);
+        }
+        uint8_t* item = (uint8_t*) m_items.data + index * item_size;
+        memmove(item + item_size, item, (m_size - index) * item_size);
+        m_size += 1;
+        return item;
+    }
+
+    void Value::Grow(size_t capacity, size_t item_size)
+    {
+        // values never point into themselves, so they move with their bytes
+        void* data = realloc(m_items.data, capacity * item_size);
+        if (data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        m_items.data = data;
+        m_items.capacity = (uint32_t) capacity;
+    }
+}
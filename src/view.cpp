@@ -0,0 +1,994 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <jsonb/view.h>
+#include "convert.h"
+#include "format.h"
+#include "lz.h"
+#include <mutex>
+#include <string.h>
+#include <unordered_map>
+
+namespace jsonb
+{
+    namespace
+    {
+        template <class T>
+        T Load(const uint8_t* p)
+        {
+            T t;
+            memcpy(&t, p, sizeof(t));
+            return t;
+        }
+
+        // a decoded numeric scalar
+        struct Number
+        {
+            Kind kind;
+            int64_t i;
+            uint64_t u;
+            double d;
+        };
+
+        // reads the payload at p of a number of the given type
+        bool ReadNumber(ValueType type, const uint8_t* p, const uint8_t* end, Number& n)
+        {
+            int size = ScalarSize(type);
+            if (size <= 0 || end - p < size)
+            {
+                return false;
+            }
+
+            n.kind = Kind::Int;
+            switch (type)
+            {
+            case ValueType::Uint8:
+                n.i = Load<uint8_t>(p);
+                break;
+            case ValueType::Int8:
+                n.i = Load<int8_t>(p);
+                break;
+            case ValueType::Uint16:
+                n.i = Load<uint16_t>(p);
+                break;
+            case ValueType::Int16:
+                n.i = Load<int16_t>(p);
+                break;
+            case ValueType::Int32:
+                n.i = Load<int32_t>(p);
+                break;
+            case ValueType::Uint32:
+                n.i = Load<uint32_t>(p);
+                break;
+            case ValueType::Int64:
+                n.i = Load<int64_t>(p);
+                break;
+            case ValueType::Uint64:
+                n.kind = Kind::Uint;
+                n.u = Load<uint64_t>(p);
+                break;
+            case ValueType::Float:
+                n.kind = Kind::Real;
+                n.d = Load<float>(p);
+                break;
+            case ValueType::Double:
+                n.kind = Kind::Real;
+                n.d = Load<double>(p);
+                break;
+            case ValueType::Decimal:
+                n.kind = Kind::Real;
+                n.d = LoadDecimal(p);
+                break;
+            default:
+                return false;
+            }
+
+            switch (n.kind)
+            {
+            case Kind::Int:
+                n.u = (uint64_t) n.i;
+                n.d = (double) n.i;
+                break;
+            case Kind::Uint:
+                n.i = (int64_t) n.u;
+                n.d = (double) n.u;
+                break;
+            default:
+                n.i = (int64_t) n.d;
+                n.u = (uint64_t) n.d;
+                break;
+            }
+            return true;
+        }
+
+        // reads a count or length written with WriteInt64, returns the position after it or nullptr
+        const uint8_t* ReadCount(const uint8_t* p, const uint8_t* end, size_t& count)
+        {
+            Number n;
+            if (p >= end || !ReadNumber((ValueType) *p, p + 1, end, n) || n.kind != Kind::Int || n.i < 0)
+            {
+                return nullptr;
+            }
+            count = (size_t) n.i;
+            return p + 1 + ScalarSize((ValueType) *p);
+        }
+
+        // reads a string value or a dictionary reference starting at its tag
+        const uint8_t* ReadString(const View* view, const uint8_t* p, std::string_view& str)
+        {
+            const uint8_t* end = view->GetEnd();
+            if (p >= end)
+            {
+                return nullptr;
+            }
+
+            ValueType type = (ValueType) *p;
+            if (IsStringRef(type))
+            {
+                int size = ScalarSize(type);
+                if (end - p - 1 < size)
+                {
+                    return nullptr;
+                }
+                size_t index = LoadOffset(p + 1, size);
+                if (index >= view->GetStringCount())
+                {
+                    return nullptr;
+                }
+                str = view->GetString(index);
+                return p + 1 + size;
+            }
+            if (type != ValueType::String)
+            {
+                return nullptr;
+            }
+
+            size_t size = 0;
+            p = ReadCount(p + 1, end, size);
+            if (p == nullptr || (size_t) (end - p) < size)
+            {
+                return nullptr;
+            }
+            str = std::string_view((const char*) p, size);
+            return p + size;
+        }
+
+        // returns the position right after the value starting at p, or nullptr if it is malformed
+        const uint8_t* SkipValue(const View* view, const uint8_t* p)
+        {
+            const uint8_t* end = view->GetEnd();
+            if (p >= end)
+            {
+                return nullptr;
+            }
+            ValueType type = (ValueType) *p;
+            switch (type)
+            {
+            case ValueType::Object:
+            case ValueType::Array:
+            {
+                if (view->GetVersion() >= 2)
+                {
+                    Container c;
+                    return ReadContainer(p, end, c) ? c.end : nullptr;
+                }
+
+                size_t count = 0;
+                p = ReadCount(p + 1, end, count);
+                size_t child_count = type == ValueType::Object ? 2 : 1;
+                for (size_t i = 0; i < count && p; ++i)
+                {
+                    for (size_t j = 0; j < child_count && p; ++j)
+                    {
+                        p = SkipValue(view, p);
+                    }
+                }
+                return p;
+            }
+            case ValueType::String:
+            {
+                std::string_view str;
+                return ReadString(view, p, str);
+            }
+            case ValueType::TypedArray:
+            {
+                TypedArray a;
+                return ReadTypedArray(p, end, a) ? a.end : nullptr;
+            }
+            case ValueType::Block:
+            {
+                Block b;
+                return ReadBlock(p, end, b) ? b.end : nullptr;
+            }
+            default:
+            {
+                int size = ScalarSize(type);
+                if (size < 0 || end - p - 1 < size)
+                {
+                    return nullptr;
+                }
+                return p + 1 + size;
+            }
+            }
+        }
+    }
+
+    ValueRef::ValueRef():
+        m_view(nullptr),
+        m_data(nullptr),
+        m_type((uint8_t) ValueType::Null),
+        m_packed(false)
+    {
+
+    }
+
+    ValueRef::ValueRef(const View* view, const uint8_t* data):
+        m_view(view),
+        m_data(data),
+        m_type(*data),
+        m_packed(false)
+    {
+        if ((ValueType) m_type == ValueType::Block)
+        {
+            // refers to the container the block decompresses to
+            const View* block = view->GetBlock(data);
+            if (block == nullptr)
+            {
+                m_data = nullptr;
+                m_type = (uint8_t) ValueType::Null;
+                return;
+            }
+            m_view = block;
+            m_data = block->m_root;
+            m_type = *m_data;
+        }
+    }
+
+    ValueRef::ValueRef(const View* view, const uint8_t* payload, uint8_t type):
+        m_view(view),
+        m_data(payload),
+        m_type(type),
+        m_packed(true)
+    {
+
+    }
+
+    Kind ValueRef::GetKind() const
+    {
+        if (m_data == nullptr)
+        {
+            return Kind::Null;
+        }
+
+        ValueType type = (ValueType) m_type;
+        switch (type)
+        {
+        case ValueType::Object:
+            return Kind::Object;
+        case ValueType::Array:
+        case ValueType::TypedArray:
+            return Kind::Array;
+        case ValueType::String:
+        case ValueType::StringRef8:
+        case ValueType::StringRef16:
+        case ValueType::StringRef32:
+            return Kind::String;
+        case ValueType::Uint64:
+            return Kind::Uint;
+        case ValueType::Float:
+        case ValueType::Double:
+        case ValueType::Decimal:
+            return Kind::Real;
+        case ValueType::Bool:
+            return Kind::Bool;
+        case ValueType::Null:
+            return Kind::Null;
+        default:
+            return Kind::Int;
+        }
+    }
+
+    bool ValueRef::IsInt() const
+    {
+        Kind kind = this->GetKind();
+        return kind == Kind::Int || kind == Kind::Uint;
+    }
+
+    bool ValueRef::IsNumber() const
+    {
+        Kind kind = this->GetKind();
+        return kind == Kind::Int || kind == Kind::Uint || kind == Kind::Real;
+    }
+
+    bool ValueRef::AsBool() const
+    {
+        if (m_data == nullptr)
+        {
+            return false;
+        }
+        if ((ValueType) m_type == ValueType::Bool)
+        {
+            return m_view->GetEnd() - m_data > 1 && m_data[1] == 1;
+        }
+        return this->AsInt64() != 0;
+    }
+
+    int64_t ValueRef::AsInt64() const
+    {
+        Number n;
+        if (m_data == nullptr || !ReadNumber((ValueType) m_type, this->GetPayload(), m_view->GetEnd(), n))
+        {
+            return 0;
+        }
+        return n.i;
+    }
+
+    uint64_t ValueRef::AsUint64() const
+    {
+        Number n;
+        if (m_data == nullptr || !ReadNumber((ValueType) m_type, this->GetPayload(), m_view->GetEnd(), n))
+        {
+            return 0;
+        }
+        return n.u;
+    }
+
+    double ValueRef::AsDouble() const
+    {
+        Number n;
+        if (m_data == nullptr || !ReadNumber((ValueType) m_type, this->GetPayload(), m_view->GetEnd(), n))
+        {
+            return 0;
+        }
+        return n.d;
+    }
+
+    std::string_view ValueRef::AsString() const
+    {
+        std::string_view str;
+        if (m_data != nullptr && !m_packed)
+        {
+            ReadString(m_view, m_data, str);
+        }
+        return str;
+    }
+
+    size_t ValueRef::Size() const
+    {
+        if (m_data == nullptr)
+        {
+            return 0;
+        }
+
+        ValueType type = (ValueType) m_type;
+        size_t count = 0;
+        if (type == ValueType::TypedArray)
+        {
+            TypedArray a;
+            if (ReadTypedArray(m_data, m_view->GetEnd(), a))
+            {
+                count = a.count;
+            }
+        }
+        else if (type == ValueType::Object || type == ValueType::Array)
+        {
+            if (m_view->GetVersion() >= 2)
+            {
+                Container c;
+                if (ReadContainer(m_data, m_view->GetEnd(), c))
+                {
+                    count = c.count;
+                }
+            }
+            else if (ReadCount(m_data + 1, m_view->GetEnd(), count) == nullptr)
+            {
+                count = 0;
+            }
+        }
+        return count;
+    }
+
+    ValueRef ValueRef::operator[](size_t index) const
+    {
+        if (!this->IsArray())
+        {
+            return ValueRef();
+        }
+
+        const uint8_t* end = m_view->GetEnd();
+        const uint8_t* p = nullptr;
+        if ((ValueType) m_type == ValueType::TypedArray)
+        {
+            TypedArray a;
+            if (ReadTypedArray(m_data, end, a) && index < a.count)
+            {
+                return ValueRef(m_view, a.data + index * a.size, (uint8_t) a.type);
+            }
+        }
+        else if (m_view->GetVersion() >= 2)
+        {
+            Container c;
+            if (ReadContainer(m_data, end, c) && index < c.count)
+            {
+                p = ReadChild(c, index);
+            }
+        }
+        else
+        {
+            // elements are stored back to back, skip the ones in front
+            size_t count = 0;
+            p = ReadCount(m_data + 1, end, count);
+            if (index >= count)
+            {
+                p = nullptr;
+            }
+            for (size_t i = 0; i < index && p; ++i)
+            {
+                p = SkipValue(m_view, p);
+            }
+        }
+        if (p == nullptr || p >= end)
+        {
+            return ValueRef();
+        }
+        return ValueRef(m_view, p);
+    }
+
+    ValueRef ValueRef::Find(std::string_view key) const
+    {
+        if (!this->IsObject())
+        {
+            return ValueRef();
+        }
+
+        // in a big object it pays to look the key up in the dictionary once,
+        // interned keys then compare by index
+        size_t key_index = m_view->GetStringCount();
+        if (m_view->GetVersion() >= 2 && key_index > 0)
+        {
+            Container c;
+            if (ReadContainer(m_data, m_view->GetEnd(), c) && c.count >= 16)
+            {
+                key_index = m_view->FindString(key);
+            }
+        }
+        return this->Find(key, key_index);
+    }
+
+    ValueRef ValueRef::Find(std::string_view key, size_t key_index) const
+    {
+        if (!this->IsObject())
+        {
+            return ValueRef();
+        }
+
+        const uint8_t* end = m_view->GetEnd();
+        if (m_view->GetVersion() >= 2)
+        {
+            Container c;
+            if (!ReadContainer(m_data, end, c))
+            {
+                return ValueRef();
+            }
+
+            bool interned = key_index < m_view->GetStringCount();
+
+            // binary search the offset table, it is sorted by key bytes
+            size_t low = 0;
+            size_t high = c.count;
+            while (low < high)
+            {
+                size_t mid = low + (high - low) / 2;
+                const uint8_t* entry = ReadChild(c, mid);
+                if (entry == nullptr)
+                {
+                    return ValueRef();
+                }
+
+                int comp = 0;
+                const uint8_t* value = nullptr;
+                ValueType type = (ValueType) *entry;
+                if (interned && IsStringRef(type) && end - entry > ScalarSize(type))
+                {
+                    size_t index = LoadOffset(entry + 1, ScalarSize(type));
+                    comp = index < key_index ? -1 : (index > key_index ? 1 : 0);
+                    value = entry + 1 + ScalarSize(type);
+                }
+                else
+                {
+                    std::string_view entry_key;
+                    value = ReadString(m_view, entry, entry_key);
+                    if (value == nullptr)
+                    {
+                        return ValueRef();
+                    }
+                    comp = entry_key.compare(key);
+                }
+                if (comp == 0)
+                {
+                    return value < end ? ValueRef(m_view, value) : ValueRef();
+                }
+                if (comp < 0)
+                {
+                    low = mid + 1;
+                }
+                else
+                {
+                    high = mid;
+                }
+            }
+            return ValueRef();
+        }
+
+        for (auto i = this->begin(); i != this->end(); ++i)
+        {
+            if (i.Key() == key)
+            {
+                return *i;
+            }
+        }
+        return ValueRef();
+    }
+
+    ValueRef::Iterator ValueRef::begin() const
+    {
+        Kind kind = this->GetKind();
+        if (kind != Kind::Object && kind != Kind::Array)
+        {
+            return Iterator();
+        }
+
+        bool object = kind == Kind::Object;
+        if ((ValueType) m_type == ValueType::TypedArray)
+        {
+            TypedArray a;
+            if (!ReadTypedArray(m_data, m_view->GetEnd(), a))
+            {
+                return Iterator();
+            }
+            Iterator i(m_view, a.data, nullptr, 0, a.count, false);
+            i.m_element_type = (uint8_t) a.type;
+            i.m_element_size = a.size;
+            return i;
+        }
+        if (m_view->GetVersion() >= 2)
+        {
+            Container c;
+            if (!ReadContainer(m_data, m_view->GetEnd(), c))
+            {
+                return Iterator();
+            }
+            return Iterator(m_view, c.body, c.table, c.width, c.count, object);
+        }
+
+        size_t count = 0;
+        const uint8_t* p = ReadCount(m_data + 1, m_view->GetEnd(), count);
+        if (p == nullptr)
+        {
+            return Iterator();
+        }
+        return Iterator(m_view, p, nullptr, 0, count, object);
+    }
+
+    ValueRef::Iterator ValueRef::end() const
+    {
+        Iterator i;
+        i.m_index = this->Size();
+        return i;
+    }
+
+    ValueRef::Iterator::Iterator():
+        m_view(nullptr),
+        m_pos(nullptr),
+        m_table(nullptr),
+        m_width(0),
+        m_index(0),
+        m_count(0),
+        m_object(false),
+        m_element_type(0),
+        m_element_size(0)
+    {
+
+    }
+
+    ValueRef::Iterator::Iterator(const View* view, const uint8_t* pos, const uint8_t* table, int width, size_t count, bool object):
+        m_view(view),
+        m_pos(pos),
+        m_table(table),
+        m_width(width),
+        m_index(0),
+        m_count(count),
+        m_object(object),
+        m_element_type(0),
+        m_element_size(0)
+    {
+
+    }
+
+    const uint8_t* ValueRef::Iterator::GetCurrent() const
+    {
+        if (m_pos == nullptr || m_index >= m_count)
+        {
+            return nullptr;
+        }
+        if (m_element_size > 0)
+        {
+            return m_pos + m_index * m_element_size;
+        }
+        if (m_table == nullptr)
+        {
+            return m_pos;
+        }
+
+        uint32_t offset = LoadOffset(m_table + m_index * m_width, m_width);
+        if (offset >= (size_t) (m_table - m_pos))
+        {
+            return nullptr;
+        }
+        return m_pos + offset;
+    }
+
+    std::string_view ValueRef::Iterator::Key() const
+    {
+        std::string_view key;
+        const uint8_t* p = this->GetCurrent();
+        if (m_object && p != nullptr)
+        {
+            ReadString(m_view, p, key);
+        }
+        return key;
+    }
+
+    ValueRef ValueRef::Iterator::operator*() const
+    {
+        const uint8_t* end = m_view ? m_view->GetEnd() : nullptr;
+        const uint8_t* p = this->GetCurrent();
+        if (p != nullptr && m_object)
+        {
+            std::string_view key;
+            p = ReadString(m_view, p, key);
+        }
+        if (p == nullptr || p >= end)
+        {
+            return ValueRef();
+        }
+        if (m_element_size > 0)
+        {
+            return ValueRef(m_view, p, m_element_type);
+        }
+        return ValueRef(m_view, p);
+    }
+
+    ValueRef::Iterator& ValueRef::Iterator::operator++()
+    {
+        if (m_index < m_count)
+        {
+            ++m_index;
+
+            if (m_table == nullptr && m_element_size == 0)
+            {
+                // v1 children are found by skipping the previous one
+                if (m_pos != nullptr && m_object)
+                {
+                    std::string_view key;
+                    m_pos = ReadString(m_view, m_pos, key);
+                }
+                if (m_pos != nullptr)
+                {
+                    m_pos = SkipValue(m_view, m_pos);
+                }
+
+                // stop iterating a truncated container
+                if (m_pos == nullptr)
+                {
+                    m_index = m_count;
+                }
+            }
+        }
+        return *this;
+    }
+
+    bool ValueRef::IsTypedArray() const
+    {
+        return m_data != nullptr && !m_packed && (ValueType) m_type == ValueType::TypedArray;
+    }
+
+    namespace
+    {
+        template <class T>
+        struct ElementType;
+
+        template <> struct ElementType<uint8_t> { static const ValueType type = ValueType::Uint8; };
+        template <> struct ElementType<int8_t> { static const ValueType type = ValueType::Int8; };
+        template <> struct ElementType<uint16_t> { static const ValueType type = ValueType::Uint16; };
+        template <> struct ElementType<int16_t> { static const ValueType type = ValueType::Int16; };
+        template <> struct ElementType<uint32_t> { static const ValueType type = ValueType::Uint32; };
+        template <> struct ElementType<int32_t> { static const ValueType type = ValueType::Int32; };
+        template <> struct ElementType<uint64_t> { static const ValueType type = ValueType::Uint64; };
+        template <> struct ElementType<int64_t> { static const ValueType type = ValueType::Int64; };
+        template <> struct ElementType<float> { static const ValueType type = ValueType::Float; };
+        template <> struct ElementType<double> { static const ValueType type = ValueType::Double; };
+
+        void ConvertElements(ValueType type, const uint8_t* src, double* dst, size_t count)
+        {
+            ConvertToDouble(type, src, dst, count);
+        }
+
+        void ConvertElements(ValueType type, const uint8_t* src, float* dst, size_t count)
+        {
+            ConvertToFloat(type, src, dst, count);
+        }
+
+        void ConvertElements(ValueType type, const uint8_t* src, int64_t* dst, size_t count)
+        {
+            ConvertToInt64(type, src, dst, count);
+        }
+
+        double NumberAs(const ValueRef& value, double*) { return value.AsDouble(); }
+        float NumberAs(const ValueRef& value, float*) { return (float) value.AsDouble(); }
+        int64_t NumberAs(const ValueRef& value, int64_t*) { return value.AsInt64(); }
+    }
+
+    template <class T>
+    Span<const T> ValueRef::AsSpan() const
+    {
+        TypedArray a;
+        if (!this->IsTypedArray() || !ReadTypedArray(m_data, m_view->GetEnd(), a) ||
+            a.type != ElementType<T>::type || (uintptr_t) a.data % alignof(T) != 0)
+        {
+            return Span<const T>();
+        }
+        return Span<const T>((const T*) a.data, a.count);
+    }
+
+    template Span<const uint8_t> ValueRef::AsSpan<uint8_t>() const;
+    template Span<const int8_t> ValueRef::AsSpan<int8_t>() const;
+    template Span<const uint16_t> ValueRef::AsSpan<uint16_t>() const;
+    template Span<const int16_t> ValueRef::AsSpan<int16_t>() const;
+    template Span<const uint32_t> ValueRef::AsSpan<uint32_t>() const;
+    template Span<const int32_t> ValueRef::AsSpan<int32_t>() const;
+    template Span<const uint64_t> ValueRef::AsSpan<uint64_t>() const;
+    template Span<const int64_t> ValueRef::AsSpan<int64_t>() const;
+    template Span<const float> ValueRef::AsSpan<float>() const;
+    template Span<const double> ValueRef::AsSpan<double>() const;
+
+    template <class T>
+    size_t ValueRef::CopyNumbers(T* out, size_t size) const
+    {
+        TypedArray a;
+        if (this->IsTypedArray() && ReadTypedArray(m_data, m_view->GetEnd(), a))
+        {
+            size_t count = a.count < size ? a.count : size;
+            ConvertElements(a.type, a.data, out, count);
+            return count;
+        }
+
+        size_t count = 0;
+        if (this->IsArray())
+        {
+            for (auto i = this->begin(); i != this->end() && count < size; ++i)
+            {
+                out[count++] = NumberAs(*i, (T*) nullptr);
+            }
+        }
+        return count;
+    }
+
+    size_t ValueRef::CopyTo(double* out, size_t size) const
+    {
+        return this->CopyNumbers(out, size);
+    }
+
+    size_t ValueRef::CopyTo(float* out, size_t size) const
+    {
+        return this->CopyNumbers(out, size);
+    }
+
+    size_t ValueRef::CopyTo(int64_t* out, size_t size) const
+    {
+        return this->CopyNumbers(out, size);
+    }
+
+    const uint8_t* ValueRef::GetEnd() const
+    {
+        return m_view ? m_view->GetEnd() : nullptr;
+    }
+
+    // blocks are decompressed 8 byte aligned, phase bytes in
+    struct View::BlockCache
+    {
+        struct Entry
+        {
+            std::unique_ptr<uint64_t[]> data;
+            View view;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<const uint8_t*, std::unique_ptr<Entry>> blocks;
+    };
+
+    View::View():
+        m_begin(nullptr),
+        m_end(nullptr),
+        m_root(nullptr),
+        m_version(0),
+        m_string_offsets(nullptr),
+        m_string_data(nullptr),
+        m_string_data_size(0),
+        m_string_count(0)
+    {
+
+    }
+
+    View::View(const void* binary, size_t size):
+        View()
+    {
+        if (binary == nullptr || size == 0)
+        {
+            return;
+        }
+
+        const uint8_t* begin = (const uint8_t*) binary;
+        const uint8_t* end = begin + size;
+        Header header = ReadHeader(begin, size);
+        if (header.version != 1 && header.version != FORMAT_VERSION)
+        {
+            return;
+        }
+
+        const uint8_t* root = header.version >= 2 ? begin + HEADER_SIZE : begin;
+        if (header.version >= 2 && (header.flags & FLAG_DICTIONARY))
+        {
+            root = this->ReadDictionary(root, end);
+            if (root == nullptr)
+            {
+                return;
+            }
+        }
+
+        m_begin = begin;
+        m_end = end;
+        m_root = root;
+        m_version = header.version;
+        if (header.version >= 2 && (header.flags & FLAG_BLOCKS))
+        {
+            m_blocks = std::make_shared<BlockCache>();
+        }
+    }
+
+    View::View(const View& strings, const uint8_t* root, size_t size):
+        View()
+    {
+        m_string_offsets = strings.m_string_offsets;
+        m_string_data = strings.m_string_data;
+        m_string_data_size = strings.m_string_data_size;
+        m_string_count = strings.m_string_count;
+        if (root != nullptr && size > 0)
+        {
+            m_begin = root;
+            m_end = root + size;
+            m_root = root;
+            m_version = FORMAT_VERSION;
+        }
+    }
+
+    const uint8_t* View::ReadDictionary(const uint8_t* section, const uint8_t* end)
+    {
+        // size and count, then count + 1 offsets in front of the string bytes
+        if (end - section < 8)
+        {
+            return nullptr;
+        }
+        size_t section_size = Load<uint32_t>(section);
+        size_t count = Load<uint32_t>(section + 4);
+        if ((size_t) (end - section - 4) < section_size || section_size < 4 ||
+            count >= (section_size - 4) / 4)
+        {
+            return nullptr;
+        }
+        m_string_offsets = section + 8;
+        m_string_data = m_string_offsets + (count + 1) * 4;
+        m_string_data_size = section_size - 4 - (count + 1) * 4;
+        m_string_count = count;
+        return section + 4 + section_size;
+    }
+
+    const View* View::GetBlock(const uint8_t* data) const
+    {
+        if (!m_blocks)
+        {
+            return nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_blocks->mutex);
+            auto i = m_blocks->blocks.find(data);
+            if (i != m_blocks->blocks.end())
+            {
+                return &i->second->view;
+            }
+        }
+
+        // decompressed without the lock, a thread that loses the race drops its copy
+        Block b;
+        if (!ReadBlock(data, m_end, b))
+        {
+            return nullptr;
+        }
+        std::unique_ptr<BlockCache::Entry> entry(new BlockCache::Entry());
+        entry->data.reset(new uint64_t[(b.phase + b.raw_size + 7) / 8]);
+        uint8_t* raw = (uint8_t*) entry->data.get() + b.phase;
+        if (!lz::Decompress(b.data, b.size, raw, b.raw_size) || raw[0] != (uint8_t) b.type)
+        {
+            return nullptr;
+        }
+        entry->view = View(*this, raw, b.raw_size);
+        // blocks inside it go to the same cache, which must not own itself
+        entry->view.m_blocks = std::shared_ptr<BlockCache>(std::shared_ptr<BlockCache>(), m_blocks.get());
+
+        std::lock_guard<std::mutex> lock(m_blocks->mutex);
+        auto result = m_blocks->blocks.emplace(data, std::move(entry));
+        return &result.first->second->view;
+    }
+
+    std::string_view View::GetString(size_t index) const
+    {
+        if (index >= m_string_count)
+        {
+            return std::string_view();
+        }
+        uint32_t begin = Load<uint32_t>(m_string_offsets + index * 4);
+        uint32_t end = Load<uint32_t>(m_string_offsets + index * 4 + 4);
+        if (begin > end || end > m_string_data_size)
+        {
+            return std::string_view();
+        }
+        return std::string_view((const char*) m_string_data + begin, end - begin);
+    }
+
+    size_t View::FindString(std::string_view str) const
+    {
+        size_t low = 0;
+        size_t high = m_string_count;
+        while (low < high)
+        {
+            size_t mid = low + (high - low) / 2;
+            int comp = this->GetString(mid).compare(str);
+            if (comp == 0)
+            {
+                return mid;
+            }
+            if (comp < 0)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        return m_string_count;
+    }
+
+    ValueRef View::Root() const &
+    {
+        if (m_root == nullptr || m_root >= m_end)
+        {
+            return ValueRef();
+        }
+        return ValueRef(this, m_root);
+    }
+}
@@ -0,0 +1,113 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsonb.h>
+#include "check.h"
+#include <filesystem>
+#include <string>
+
+using namespace jsonb;
+namespace fs = std::filesystem;
+
+static const fs::path WORK_DIR = fs::path(JSONB_TEST_BINARY_DIR) / "batch";
+
+// runs the jsonb tool with args, returns its exit code
+static int Run(const std::string& args)
+{
+    std::string command = std::string("\"") + JSONB_TOOL + "\" " + args;
+#ifdef _WIN32
+    // cmd drops the outer quotes of a command that starts with one
+    command = "\"" + command + "\"";
+#endif
+    int result = system(command.c_str());
+    return result == 0 ? 0 : 1;
+}
+
+static std::string Quote(const fs::path& path)
+{
+    return "\"" + path.string() + "\"";
+}
+
+// the output file holds the same value as the json input
+static void CheckSame(const fs::path& json, const fs::path& output, bool binary)
+{
+    MappedFile expected_file;
+    MappedFile output_file;
+    CHECK(expected_file.Open(json.string()) && output_file.Open(output.string()));
+    Document expected;
+    CHECK(expected.Load(std::string_view((const char*) expected_file.GetData(), expected_file.GetSize())));
+    Document converted;
+    if (binary)
+    {
+        CHECK(converted.Load(output_file.GetData(), output_file.GetSize()));
+    }
+    else
+    {
+        CHECK(converted.Load(std::string_view((const char*) output_file.GetData(), output_file.GetSize())));
+    }
+    CHECK(converted.GetRoot() == expected.GetRoot());
+}
+
+static void WriteText(const fs::path& path, const std::string& text)
+{
+    FILE* file = fopen(path.string().c_str(), "wb");
+    CHECK(file != nullptr);
+    CHECK(fwrite(text.data(), 1, text.size(), file) == text.size());
+    fclose(file);
+}
+
+int main()
+{
+    fs::remove_all(WORK_DIR);
+    fs::path in = WORK_DIR / "in";
+    fs::create_directories(in / "a");
+    fs::create_directories(in / "b");
+    fs::path twitter = fs::path(JSONB_TEST_DIR) / "twitter.json";
+    fs::path citm = fs::path(JSONB_TEST_DIR) / "citm_catalog.json";
+    fs::copy_file(twitter, in / "a" / "x.json");
+    fs::copy_file(citm, in / "b" / "x.json");
+    fs::copy_file(twitter, in / "b" / "y.gltf");
+    WriteText(in / "b" / "bad.json", "[1,");
+
+    // a directory keeps its tree, a bad file fails the run but not the others
+    CHECK(Run("-m2 -z1 " + Quote(WORK_DIR / "out") + " " + Quote(in)) != 0);
+    CheckSame(in / "a" / "x.json", WORK_DIR / "out" / "a" / "x.jsonb", true);
+    CheckSame(in / "b" / "x.json", WORK_DIR / "out" / "b" / "x.jsonb", true);
+    CheckSame(in / "b" / "y.gltf", WORK_DIR / "out" / "b" / "y.jsonb", true);
+    fs::remove(in / "b" / "bad.json");
+    CHECK(Run("-m2 -zd3 " + Quote(WORK_DIR / "out") + " " + Quote(in)) == 0);
+    CheckSame(in / "b" / "x.json", WORK_DIR / "out" / "b" / "x.jsonb", true);
+
+    // and back to text
+    CHECK(Run("-m -c " + Quote(WORK_DIR / "text") + " " + Quote(WORK_DIR / "out")) == 0);
+    CheckSame(in / "a" / "x.json", WORK_DIR / "text" / "a" / "x.json", false);
+
+    // a list and stdin put files by name in the output directory, two of one name are refused
+    // before anything is written
+    std::string list = (in / "a" / "x.json").string() + "\n" + (in / "b" / "y.gltf").string() + "\n";
+    WriteText(WORK_DIR / "list.txt", list);
+    CHECK(Run("-m3 -b " + Quote(WORK_DIR / "list") + " @" + Quote(WORK_DIR / "list.txt")) == 0);
+    CheckSame(in / "b" / "y.gltf", WORK_DIR / "list" / "y.jsonb", true);
+    CHECK(Run("-m -b " + Quote(WORK_DIR / "stdin") + " - < " + Quote(WORK_DIR / "list.txt")) == 0);
+    CheckSame(in / "a" / "x.json", WORK_DIR / "stdin" / "x.jsonb", true);
+
+    WriteText(WORK_DIR / "dup.txt", list + (in / "b" / "x.json").string() + "\n");
+    CHECK(Run("-m -b " + Quote(WORK_DIR / "dup") + " @" + Quote(WORK_DIR / "dup.txt")) != 0);
+    CHECK(!fs::exists(WORK_DIR / "dup"));
+    return 0;
+}
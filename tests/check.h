@@ -0,0 +1,33 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// the regression tests are plain programs run by ctest, the first failed check ends one
+#define CHECK(x) \
+    do \
+    { \
+        if (!(x)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); \
+            exit(1); \
+        } \
+    } while (0)
@@ -0,0 +1,122 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/codec.h>
+#include <jsonb/jsonb.h>
+#include "check.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace jsonb;
+
+namespace
+{
+    template <class T>
+    struct Holder
+    {
+        std::vector<T> items;
+        T single = 0;
+    };
+
+    JSONB_FIELDS(Holder<int64_t>, items, single)
+    JSONB_FIELDS(Holder<uint64_t>, items, single)
+    JSONB_FIELDS(Holder<int32_t>, items, single)
+    JSONB_FIELDS(Holder<uint32_t>, items, single)
+    JSONB_FIELDS(Holder<uint16_t>, items, single)
+}
+
+// the same struct as json text, members in the sorted order EncodeStruct writes them
+template <class T>
+static std::string ToText(const Holder<T>& holder)
+{
+    std::string json = "{\"items\":[";
+    for (size_t i = 0; i < holder.items.size(); ++i)
+    {
+        json += (i > 0 ? "," : "") + std::to_string(holder.items[i]);
+    }
+    return json + "],\"single\":" + std::to_string(holder.single) + "}";
+}
+
+template <class T>
+static void CheckSameAsEncode(const std::vector<T>& items)
+{
+    Holder<T> holder;
+    holder.items = items;
+    holder.single = items.empty() ? 0 : items.back();
+
+    BufferWriter writer;
+    EncodeStruct(holder, writer);
+    Document doc;
+    CHECK(doc.Encode(ToText(holder)));
+    CHECK(writer.GetSize() == doc.GetBinarySize());
+    CHECK(memcmp(writer.GetData(), doc.GetBinary(), writer.GetSize()) == 0);
+
+    Holder<T> decoded;
+    decoded.single = 1;
+    CHECK(DecodeStruct(View(writer.GetData(), writer.GetSize()), decoded));
+    CHECK(decoded.items == holder.items && decoded.single == holder.single);
+}
+
+static void TestNarrow()
+{
+    CheckSameAsEncode(std::vector<int64_t>{ 1, -2, 3 });
+    CheckSameAsEncode(std::vector<int64_t>{ 1, 200 });
+    CheckSameAsEncode(std::vector<int32_t>{ -40000, 40000, 7 });
+    CheckSameAsEncode(std::vector<uint32_t>{ 0, 65535 });
+    CheckSameAsEncode(std::vector<uint16_t>{ 65535, 300 });
+    CheckSameAsEncode(std::vector<uint64_t>{ 2147483647, 0 });
+}
+
+static void TestWide()
+{
+    CheckSameAsEncode(std::vector<int64_t>{ 5000000000, 6000000000 });
+    CheckSameAsEncode(std::vector<int64_t>{ -5000000000, -6000000000 });
+    CheckSameAsEncode(std::vector<uint32_t>{ 3000000000u, 3000000001u });
+    CheckSameAsEncode(std::vector<uint64_t>{ 2147483648u, UINT64_MAX });
+    CheckSameAsEncode(std::vector<int64_t>{ INT64_MIN, INT32_MIN - 1LL });
+}
+
+static void TestMixed()
+{
+    // small and wide, or wide on both sides, stay tagged one by one
+    CheckSameAsEncode(std::vector<int64_t>{ 1, 3000000000 });
+    CheckSameAsEncode(std::vector<int64_t>{ -5000000000, 6000000000 });
+    CheckSameAsEncode(std::vector<int64_t>{ -1, -5000000000 });
+    CheckSameAsEncode(std::vector<uint32_t>{ 7, 4000000000u, 8 });
+    CheckSameAsEncode(std::vector<uint64_t>{ 0, UINT64_MAX });
+}
+
+static void TestShort()
+{
+    CheckSameAsEncode(std::vector<int64_t>{});
+    CheckSameAsEncode(std::vector<int64_t>{ 3000000000 });
+    CheckSameAsEncode(std::vector<int64_t>{ -3000000000 });
+    CheckSameAsEncode(std::vector<uint32_t>{ 4000000000u });
+    CheckSameAsEncode(std::vector<uint64_t>{ 12 });
+}
+
+int main()
+{
+    TestNarrow();
+    TestWide();
+    TestMixed();
+    TestShort();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsonb.h>
+#include <jsonb/diff.h>
+#include <jsonb/patch.h>
+#include "check.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace jsonb;
+
+static std::vector<uint8_t> Encode(const std::string& json, DictionaryMode mode = DictionaryMode::None, int level = 0)
+{
+    Document doc;
+    doc.SetDictionaryMode(mode);
+    doc.SetCompressionLevel(level);
+    CHECK(doc.Encode(json));
+    const uint8_t* data = (const uint8_t*) doc.GetBinary();
+    return std::vector<uint8_t>(data, data + doc.GetBinarySize());
+}
+
+// the delta rebuilds the target byte for byte, returns its size
+static size_t RoundTrip(const std::vector<uint8_t>& base, const std::vector<uint8_t>& target)
+{
+    Differ differ;
+    BufferWriter delta;
+    differ.Diff(base.data(), base.size(), target.data(), target.size(), delta);
+    BufferWriter rebuilt;
+    CHECK(differ.Apply(base.data(), base.size(), delta.GetData(), delta.GetSize(), rebuilt));
+    CHECK(rebuilt.GetSize() == target.size());
+    CHECK(memcmp(rebuilt.GetData(), target.data(), target.size()) == 0);
+    return delta.GetSize();
+}
+
+static std::string Catalog(int items, int changed)
+{
+    std::string json = "{\"title\":\"catalog\",\"items\":[";
+    for (int i = 0; i < items; ++i)
+    {
+        json += (i ? "," : "") + std::string("{\"id\":") + std::to_string(i) + ",\"name\":\"item number " +
+            std::to_string(i) + "\",\"pos\":[" + std::to_string(i * 0.5) + ",1.25,2.5],\"price\":" +
+            std::to_string(i == changed ? 999 : i * 3) + "}";
+    }
+    return json + "]}";
+}
+
+static void TestEdits()
+{
+    std::vector<uint8_t> base = Encode(Catalog(200, -1));
+    CHECK(RoundTrip(base, base) < 64);
+
+    // one changed value costs about its own bytes, not the document's
+    std::vector<uint8_t> target = Encode(Catalog(200, 100));
+    CHECK(RoundTrip(base, target) < 256);
+
+    // edits made by the patcher: insert, remove, new member, typed array that moves
+    const char* pointers[] = { "/items/0", "/items/57", "/items/199/pos/1", "/extra" };
+    for (const char* pointer : pointers)
+    {
+        Patcher patcher;
+        CHECK(patcher.Open(base.data(), base.size()));
+        if (strcmp(pointer, "/extra") == 0)
+        {
+            CHECK(patcher.Set(pointer, Value("added")));
+        }
+        else if (strcmp(pointer, "/items/57") == 0)
+        {
+            CHECK(patcher.Remove(pointer));
+        }
+        else
+        {
+            CHECK(patcher.Insert(pointer, Value(std::string(30, 'x'))));
+        }
+        std::vector<uint8_t> patched(patcher.GetData(), patcher.GetData() + patcher.GetSize());
+        CHECK(RoundTrip(base, patched) < base.size() / 4);
+        CHECK(RoundTrip(patched, base) < base.size() / 4);
+    }
+}
+
+static void TestWholeBuffers()
+{
+    // other dictionaries, blocks and unrelated documents still round trip
+    std::string json = Catalog(100, -1);
+    std::vector<uint8_t> plain = Encode(json);
+    std::vector<uint8_t> keys = Encode(json, DictionaryMode::Keys);
+    std::vector<uint8_t> compressed = Encode(Catalog(100, 5), DictionaryMode::KeysAndStrings, 3);
+    RoundTrip(plain, keys);
+    RoundTrip(keys, plain);
+    RoundTrip(plain, compressed);
+    RoundTrip(Encode("[1,2,3]"), plain);
+    RoundTrip(plain, Encode("\"scalar\""));
+    std::vector<uint8_t> garbage = { 1, 2, 3, 4, 5 };
+    RoundTrip(garbage, plain);
+    RoundTrip(plain, garbage);
+}
+
+static void TestBadDeltas()
+{
+    std::vector<uint8_t> base = Encode(Catalog(50, -1));
+    std::vector<uint8_t> target = Encode(Catalog(50, 10));
+    Differ differ;
+    BufferWriter delta;
+    differ.Diff(base.data(), base.size(), target.data(), target.size(), delta);
+
+    // applied to another base
+    std::vector<uint8_t> other = Encode(Catalog(50, 20));
+    BufferWriter rebuilt;
+    Status status = differ.Apply(other.data(), other.size(), delta.GetData(), delta.GetSize(), rebuilt);
+    CHECK(!status && status.GetError() == Error::BaseMismatch);
+
+    // every flipped byte but the reserved ones of the header, and every cut, is refused
+    for (size_t i = 0; i < delta.GetSize(); ++i)
+    {
+        std::vector<uint8_t> broken(delta.GetData(), delta.GetData() + delta.GetSize());
+        broken[i] ^= 0x5a;
+        rebuilt.Clear();
+        CHECK(i == 6 || i == 7 || !differ.Apply(base.data(), base.size(), broken.data(), broken.size(), rebuilt));
+        rebuilt.Clear();
+        CHECK(!differ.Apply(base.data(), base.size(), delta.GetData(), i, rebuilt));
+    }
+}
+
+int main()
+{
+    TestEdits();
+    TestWholeBuffers();
+    TestBadDeltas();
+    return 0;
+}
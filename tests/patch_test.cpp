@@ -0,0 +1,164 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsonb.h>
+#include <jsonb/node.h>
+#include <jsonb/patch.h>
+#include <jsonb/stats.h>
+#include <jsonb/view.h>
+#include "check.h"
+#include <string>
+
+using namespace jsonb;
+
+// the buffer the patcher holds loads to the same value as json, and validates
+static void CheckPatched(const Patcher& patcher, const char* json)
+{
+    Document expected;
+    CHECK(expected.Load(json));
+    Document patched;
+    CHECK(patched.Load(patcher.GetData(), patcher.GetSize()));
+    CHECK(patched.GetRoot() == expected.GetRoot());
+}
+
+static Patcher Open(const char* json, DictionaryMode mode)
+{
+    Document doc;
+    doc.SetDictionaryMode(mode);
+    CHECK(doc.Encode(json));
+    Patcher patcher;
+    CHECK(patcher.Open(doc.GetBinary(), doc.GetBinarySize()));
+    return patcher;
+}
+
+static void TestTypedArrays()
+{
+    // a structural edit with an element of the same kind writes the array again as it was encoded
+    Patcher patcher = Open("{\"a\":[200,1,3,250]}", DictionaryMode::None);
+    CHECK(patcher.Remove("/a/1"));
+    CheckPatched(patcher, "{\"a\":[200,3,250]}");
+    Document fresh;
+    CHECK(fresh.Encode("{\"a\":[200,3,250]}"));
+    CHECK(patcher.GetSize() == fresh.GetBinarySize());
+    Value element;
+    CHECK(patcher.Get("/a/0", element) && element.GetKind() == Kind::Int);
+
+    struct Case
+    {
+        const char* array;
+        Value element;
+    };
+    const Case cases[] = {
+        { "[1,2,3]", Value(7) },
+        { "[1000,2000,3000]", Value(7) },
+        { "[70000,80000,90000]", Value(7) },
+        { "[-1,-2,-3]", Value(-7) },
+        { "[1.5,2.5,3.5]", Value(7.5) },
+    };
+    for (const Case& c : cases)
+    {
+        std::string json = std::string("{\"a\":") + c.array + "}";
+        Patcher p = Open(json.c_str(), DictionaryMode::None);
+        size_t size = p.GetSize();
+        CHECK(p.Insert("/a/1", c.element));
+        CHECK(p.Remove("/a/1"));
+        CheckPatched(p, json.c_str());
+        CHECK(p.GetSize() == size);
+    }
+
+    // an element that fits is overwritten in place, one that does not widens the array
+    patcher = Open("{\"a\":[1,2,3]}", DictionaryMode::None);
+    CHECK(patcher.Set("/a/2", Value(9)) && patcher.WasInPlace());
+    CHECK(patcher.Set("/a/0", Value(100000)) && !patcher.WasInPlace());
+    CHECK(patcher.Set("/a/-", Value("x")));
+    CheckPatched(patcher, "{\"a\":[100000,2,9,\"x\"]}");
+}
+
+static void TestUint32Elements()
+{
+    // ints past an Int32 but in a uint32 pack to a Uint32 typed array
+    Document doc;
+    Value& list = doc.GetRoot()["a"];
+    list.Resize(3);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        list[i] = Value(3000000000LL + (long long) i);
+    }
+    CHECK(doc.ToBinary());
+    View view(doc.GetBinary(), doc.GetBinarySize());
+    Stats stats;
+    CollectStats(view, stats);
+    CHECK(stats.typed_elements == 3);
+
+    // and every reader gives them back as Int
+    Document loaded;
+    CHECK(loaded.Load(doc.GetBinary(), doc.GetBinarySize()));
+    CHECK(loaded.GetRoot()["a"][1].GetKind() == Kind::Int && loaded.GetRoot()["a"][1].AsInt64() == 3000000001LL);
+    Document decoded;
+    CHECK(decoded.Decode(doc.GetBinary(), doc.GetBinarySize()));
+    CHECK(decoded.GetTree()["a"][1].GetKind() == Kind::Int && decoded.GetTree()["a"][1].AsInt64() == 3000000001LL);
+    CHECK(view.Root()["a"][1].GetKind() == Kind::Int && view.Root()["a"][1].AsInt64() == 3000000001LL);
+    Patcher patcher;
+    CHECK(patcher.Open(doc.GetBinary(), doc.GetBinarySize()));
+    Value element;
+    CHECK(patcher.Get("/a/1", element) && element.GetKind() == Kind::Int && element.AsInt64() == 3000000001LL);
+
+    // so an edit writes the array again with the same element type
+    size_t size = patcher.GetSize();
+    CHECK(patcher.Insert("/a/1", element));
+    CHECK(patcher.Remove("/a/1"));
+    CHECK(patcher.GetSize() == size);
+}
+
+static void TestDictionary()
+{
+    for (DictionaryMode mode : { DictionaryMode::Keys, DictionaryMode::KeysAndStrings })
+    {
+        Patcher patcher = Open("{\"name\":\"same\",\"list\":[{\"name\":\"same\"},{\"id\":1}]}", mode);
+        // keys and strings already in the dictionary and new ones
+        CHECK(patcher.Set("/list/1/name", Value("same")));
+        CHECK(patcher.Set("/list/0/other", Value("new")));
+        CHECK(patcher.Remove("/name"));
+        CHECK(patcher.Set("/extra", Value(std::string(40, 'e'))));
+        CheckPatched(patcher, "{\"list\":[{\"name\":\"same\",\"other\":\"new\"},{\"id\":1,\"name\":\"same\"}],"
+            "\"extra\":\"eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee\"}");
+        CHECK(patcher.GetView().GetStringCount() > 0);
+    }
+}
+
+static void TestJsonPatch()
+{
+    Patcher patcher = Open("{\"a\":{\"b\":[1,2]},\"c\":true}", DictionaryMode::None);
+    CHECK(patcher.ApplyJsonPatch("[{\"op\":\"add\",\"path\":\"/a/b/-\",\"value\":3},"
+        "{\"op\":\"move\",\"from\":\"/c\",\"path\":\"/d\"},{\"op\":\"test\",\"path\":\"/d\",\"value\":true}]"));
+    CheckPatched(patcher, "{\"a\":{\"b\":[1,2,3]},\"d\":true}");
+
+    // a failed test leaves every earlier operation undone
+    CHECK(!patcher.ApplyJsonPatch("[{\"op\":\"remove\",\"path\":\"/a\"},{\"op\":\"test\",\"path\":\"/d\",\"value\":false}]"));
+    CheckPatched(patcher, "{\"a\":{\"b\":[1,2,3]},\"d\":true}");
+    CHECK(!patcher.Remove("/missing"));
+}
+
+int main()
+{
+    TestTypedArrays();
+    TestUint32Elements();
+    TestDictionary();
+    TestJsonPatch();
+    return 0;
+}
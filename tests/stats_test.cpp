@@ -0,0 +1,98 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsonb.h>
+#include "check.h"
+#include <string.h>
+#include <vector>
+
+using namespace jsonb;
+
+static void Record(void* context, Phase phase, const Stats&)
+{
+    ((std::vector<Phase>*) context)->push_back(phase);
+}
+
+static void TestCounts()
+{
+    Document doc;
+    Stats stats;
+    doc.SetStats(&stats);
+    const char* json = "{\"a\":[1,2,3],\"b\":{\"c\":\"a string longer than inline\"},\"d\":null}";
+    CHECK(doc.Load(json));
+    CHECK(!stats.failed);
+    CHECK(stats.input_bytes == strlen(json));
+    CHECK(stats.max_depth == 2);
+    CHECK(stats.typed_elements == 3);
+    CHECK(stats.key_bytes == 4);
+    CHECK(stats.string_bytes == strlen("a string longer than inline"));
+    // the root, "b", the typed array and the long string
+    CHECK(stats.heap_blocks == 4);
+    CHECK(stats.nanoseconds[(size_t) Phase::Parse] > 0);
+
+    CHECK(doc.ToBinary());
+    CHECK(!stats.failed && stats.output_bytes == doc.GetBinarySize() && stats.input_bytes == 0);
+    CHECK(doc.Decode(doc.GetBinary(), doc.GetBinarySize()));
+    CHECK(!stats.failed && stats.max_depth == 2 && stats.heap_blocks > 0);
+}
+
+static void TestFailures()
+{
+    Document doc;
+    Stats stats;
+    std::vector<Phase> phases;
+    doc.SetStats(&stats);
+    doc.SetTraceHook(Record, &phases);
+
+    // every operation ends with Done, failed or not, and starts from zeroed stats
+    CHECK(doc.Load("[1,2,3]"));
+    CHECK(!phases.empty() && phases.back() == Phase::Done && !stats.failed);
+    phases.clear();
+    CHECK(!doc.Load("[1,"));
+    CHECK(phases.size() == 1 && phases.back() == Phase::Done);
+    CHECK(stats.failed && stats.tags[1] == 0 && stats.input_bytes == 3);
+
+    phases.clear();
+    const char garbage[] = "JSNB\x02\x00\x00\x00\x07";
+    CHECK(!doc.Load(garbage, sizeof(garbage) - 1));
+    CHECK(!phases.empty() && phases.back() == Phase::Done && stats.failed);
+    phases.clear();
+    CHECK(!doc.Decode(garbage, sizeof(garbage) - 1));
+    CHECK(!phases.empty() && phases.back() == Phase::Done && stats.failed);
+    phases.clear();
+    CHECK(!doc.LoadFile("no such file.jsonb"));
+    CHECK(phases.size() == 1 && stats.failed);
+
+    // the hook alone gets stats of the document's own
+    Document hooked;
+    phases.clear();
+    hooked.SetTraceHook(Record, &phases);
+    CHECK(hooked.Encode("{\"a\":1}"));
+    CHECK(phases.size() == 2 && phases[0] == Phase::Parse && phases[1] == Phase::Done);
+}
+
+int main()
+{
+    if (!STATS_ENABLED)
+    {
+        return 0;
+    }
+    TestCounts();
+    TestFailures();
+    return 0;
+}
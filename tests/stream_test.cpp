@@ -0,0 +1,142 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/jsonb.h>
+#include <jsonb/stream.h>
+#include "check.h"
+#include <string>
+
+using namespace jsonb;
+
+static std::string Record(int i)
+{
+    return "{\"id\":" + std::to_string(i) + ",\"name\":\"record " + std::to_string(i) + "\",\"tags\":[" +
+        std::to_string(i % 7) + "," + std::to_string(i % 5) + "],\"extra\":" + (i % 3 ? "null" : "{\"deep\":true}") + "}";
+}
+
+static void CheckRecord(const View& view, int i)
+{
+    CHECK(view.IsValid());
+    Document expected;
+    CHECK(expected.Load(Record(i)));
+    Document loaded;
+    CHECK(loaded.Load(view));
+    CHECK(loaded.GetRoot() == expected.GetRoot());
+}
+
+static void TestIndex(bool dictionary)
+{
+    const int count = 300;
+    StreamWriter writer;
+    if (dictionary)
+    {
+        Document doc;
+        for (int i = 0; i < count; ++i)
+        {
+            CHECK(doc.Encode(Record(i)));
+            writer.AddDictionaryKeys(View(doc.GetBinary(), doc.GetBinarySize()));
+        }
+    }
+    BufferWriter out;
+    writer.Begin(out);
+    for (int i = 0; i < count; ++i)
+    {
+        // text and binary records mix
+        if (i % 2)
+        {
+            CHECK(writer.Add(Record(i)));
+        }
+        else
+        {
+            Document doc;
+            CHECK(doc.Encode(Record(i)));
+            CHECK(writer.Add(View(doc.GetBinary(), doc.GetBinarySize())));
+        }
+    }
+    CHECK(!writer.Add(std::string_view("{")));
+    size_t records_size = out.GetSize();
+    CHECK(writer.End());
+    CHECK(writer.GetRecordCount() == (size_t) count);
+    CHECK(dictionary == (writer.GetDictionarySize() > 0));
+
+    // the index finds any record
+    StreamReader reader(out.GetData(), out.GetSize());
+    CHECK(reader.IsValid() && reader.HasIndex() && reader.GetRecordCount() == (size_t) count);
+    for (int i = count - 1; i >= 0; i -= 7)
+    {
+        View record = reader.GetRecord(i);
+        CheckRecord(record, i);
+        CHECK(record.Root()["id"].AsInt64() == i);
+    }
+    CHECK(!reader.GetRecord(count).IsValid());
+
+    // the frames are walked in order
+    int walked = 0;
+    for (auto i = reader.begin(); i != reader.end(); ++i)
+    {
+        CHECK(i.Index() == (size_t) walked);
+        CheckRecord(*i, walked);
+        ++walked;
+    }
+    CHECK(walked == count);
+
+    // cut before the index the records still read front to back, and cut inside the last
+    // record the ones before it do
+    for (size_t cut_size : { records_size, records_size - 3 })
+    {
+        StreamReader cut(out.GetData(), cut_size);
+        CHECK(cut.IsValid() && !cut.HasIndex() && !cut.GetRecord(0).IsValid());
+        walked = 0;
+        for (auto i = cut.begin(); i != cut.end(); ++i)
+        {
+            CheckRecord(*i, walked);
+            ++walked;
+        }
+        CHECK(walked == (cut_size == records_size ? count : count - 1));
+    }
+}
+
+static void TestFile()
+{
+    FILE* file = tmpfile();
+    CHECK(file != nullptr);
+    StreamWriter writer;
+    writer.Begin(file);
+    for (int i = 0; i < 1000; ++i)
+    {
+        CHECK(writer.Add(Record(i)));
+    }
+    CHECK(writer.End());
+
+    std::string bytes((size_t) ftell(file), 0);
+    rewind(file);
+    CHECK(fread(&bytes[0], 1, bytes.size(), file) == bytes.size());
+    fclose(file);
+    StreamReader reader(bytes.data(), bytes.size());
+    CHECK(reader.HasIndex() && reader.GetRecordCount() == 1000);
+    CheckRecord(reader.GetRecord(999), 999);
+    CheckRecord(reader.GetRecord(0), 0);
+}
+
+int main()
+{
+    TestIndex(false);
+    TestIndex(true);
+    TestFile();
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+* jsonb
+* Copyright 2018-2019 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <jsonb/value.h>
+#include "check.h"
+#include <string>
+
+using namespace jsonb;
+
+static void TestIndexWrite()
+{
+    // null becomes an array that grows to the index
+    Value null_value;
+    null_value[2] = 7;
+    CHECK(null_value.IsArray() && null_value.Size() == 3 && null_value[2].AsInt64() == 7);
+
+    // an object keeps its members, a write past them goes nowhere
+    Value obj(Kind::Object);
+    obj["a"] = 1;
+    obj["b"] = 2;
+    obj[5] = 3;
+    CHECK(obj.IsObject() && obj.Size() == 2);
+    CHECK(obj["a"].AsInt64() == 1 && obj["b"].AsInt64() == 2);
+    obj[1] = 4;
+    CHECK(obj["b"].AsInt64() == 4);
+
+    // and so does a scalar
+    Value number(42);
+    number[0] = 1;
+    CHECK(number.GetKind() == Kind::Int && number.AsInt64() == 42);
+    CHECK(obj[7].IsNull());
+}
+
+static void TestSelfKey()
+{
+    // keys read from the object itself, inline and on the heap, while members move
+    for (std::string name : { std::string("k"), std::string(40, 'k') })
+    {
+        Value obj(Kind::Object);
+        for (int i = 0; i < 4; ++i)
+        {
+            obj[name + std::to_string(i)] = name + "z";
+        }
+        obj["x"] = name + "zz";
+        for (int i = 0; i < 64; ++i)
+        {
+            const Value& key = obj["x"];
+            obj[key.AsString()] = i;
+            CHECK(obj.Find(name + "zz") != nullptr);
+            obj["x"] = name + "zz" + std::to_string(i);
+        }
+        CHECK(obj.Size() == 4 + 1 + 64);
+    }
+
+    // a string value used as its own first key
+    Value str(std::string(32, 's'));
+    str[str.AsString()] = 1;
+    CHECK(str.IsObject() && str.Size() == 1 && str.GetKey(0) == std::string(32, 's'));
+    Value short_str("s");
+    short_str[short_str.AsString()] = 1;
+    CHECK(short_str.IsObject() && short_str.GetKey(0) == "s");
+}
+
+int main()
+{
+    TestIndexWrite();
+    TestSelfKey();
+    return 0;
+}